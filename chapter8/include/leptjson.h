@@ -3,6 +3,11 @@
 // 利用宏加入include防范，避免重复声明  一般可以用 项目名_目录_文件名称_H__
 
 #include <stddef.h> // size_t
+#include <stdint.h> // uint64_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 // 使用枚举定义json的6种数据类型（true和false看作两种的话就是7种）
 // 由于c没有c++的namespace，所以一般使用项目简写作为标识符的前缀
@@ -38,6 +43,7 @@ struct lept_value{
         struct {    // 字符串的长度变长分配
             char* s;
             size_t len;
+            int borrowed;   // 非0时s借用外部缓冲区（见 LEPT_MSGPACK_BORROW），不以'\0'结尾，lept_free()不释放
         } s;
         double n;       //对于数字我们考虑以double来存储解析后的结果，仅当type=LEPT_NUMBER时，n才表示json数字的数值
     } u;
@@ -46,7 +52,7 @@ struct lept_value{
 };
 
 struct lept_member {
-    char* k;        // key 必须是一个JSON string
+    char* k;        // key 必须是一个JSON string；由库分配并带引用计数，可能与其它成员共享，不可修改
     size_t klen;    // length of key
     lept_value v;   // value 
 };
@@ -66,9 +72,103 @@ enum {
     LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET,// 错误的逗号或中括号
     LEPT_PARSE_MISS_KEY,                    // 错误key
     LEPT_PARSE_MISS_COLON,                  // 冒号错误
-    LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET  // 逗号或{}错误
+    LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, // 逗号或{}错误
+    LEPT_PARSE_NESTING_TOO_DEEP,            // 数组/对象嵌套超过最大深度
+    LEPT_PARSE_INVALID_UTF8,                // 字符串中有非法的UTF-8序列（LEPT_PARSE_VALIDATE_UTF8）
+    LEPT_PARSE_SCHEMA_MISMATCH,             // 值不满足解析选项中的模式
+    LEPT_PARSE_BIND_MISMATCH,               // 值的类型与绑定的结构体成员不符（lept_parse_bind）
+    LEPT_PARSE_INVALID_OPTIONS              // 解析选项相互冲突：schema 与 paths 不能同时使用
+};
+
+// JSON Patch 的错误码
+enum {
+    LEPT_PATCH_OK = 0,
+    LEPT_PATCH_INVALID_OPERATION,           // 补丁格式错误：不是数组、操作缺少字段、路径语法错误、移入自身内部等
+    LEPT_PATCH_PATH_NOT_FOUND,              // 目标位置或其上层不存在
+    LEPT_PATCH_TEST_FAILED                  // test 操作不相等
+};
+
+// CBOR 解码的错误码
+enum {
+    LEPT_CBOR_OK = 0,
+    LEPT_CBOR_TRUNCATED,                    // 数据在数据项中间结束
+    LEPT_CBOR_INVALID,                      // 格式错误：保留的附加信息、多余的break、不定长串的分段类型不符、映射的键不是文本串等
+    LEPT_CBOR_UNSUPPORTED,                  // 合法但JSON无法表示：字节串、其它简单值、无穷大和NaN
+    LEPT_CBOR_ROOT_NOT_SINGULAR,            // 一个数据项之后还有其它字节
+    LEPT_CBOR_NESTING_TOO_DEEP              // 数组/映射嵌套超过 LEPT_PARSE_MAX_DEPTH
+};
+
+// MessagePack 解码的错误码
+enum {
+    LEPT_MSGPACK_OK = 0,
+    LEPT_MSGPACK_TRUNCATED,                 // 数据在值中间结束
+    LEPT_MSGPACK_INVALID,                   // 格式错误：0xc1、映射的键不是str
+    LEPT_MSGPACK_UNSUPPORTED,               // 合法但JSON无法表示：扩展类型、无穷大和NaN
+    LEPT_MSGPACK_ROOT_NOT_SINGULAR,         // 一个值之后还有其它字节
+    LEPT_MSGPACK_NESTING_TOO_DEEP           // 数组/映射嵌套超过 LEPT_PARSE_MAX_DEPTH
+};
+
+// 快照的错误码
+enum {
+    LEPT_SNAPSHOT_OK = 0,
+    LEPT_SNAPSHOT_IO_ERROR,                 // 文件无法创建、写入、打开或映射
+    LEPT_SNAPSHOT_INVALID                   // 不是快照文件，或版本、字节序、大小不符
 };
 
+// MessagePack 解码的标志位
+#define LEPT_MSGPACK_BORROW         0x1     // str/bin 的值直接指向输入缓冲区而不复制，键仍然复制；输入须比结果活得久
+
+// 运行时统计信息，由使用方分配并清零，每次解析/生成时在其上累加
+typedef struct {
+    size_t parse_bytes;         // 解析消耗的json文本字节数
+    size_t stringify_bytes;     // 生成的json文本字节数（不含结尾'\0'）
+    size_t nodes[7];            // 解析创建的结点数，以lept_type为下标
+    size_t stack_mallocs;       // 堆栈首次分配次数
+    size_t stack_reallocs;      // 堆栈扩容次数
+    size_t stack_alloc_bytes;   // 堆栈分配/扩容累计申请的字节数
+    size_t stack_peak;          // 堆栈使用的峰值字节数，可用于调整LEPT_PARSE_STACK_INIT_SIZE
+    size_t max_depth;           // 最大嵌套深度
+    double string_seconds;      // 解析/生成字符串耗时（秒）
+    double number_seconds;      // 解析/生成数字耗时（秒）
+    double structure_seconds;   // 其余（空白、字面值、数组、对象）耗时（秒）
+} lept_stats;
+
+typedef struct lept_pointer lept_pointer;
+typedef struct lept_schema lept_schema;
+
+// 解析选项的标志位
+#define LEPT_PARSE_VALIDATE_UTF8    0x1     // 严格校验字符串中的UTF-8，拒绝单独的代理项转义
+
+// 解析选项，未用到的字段置0
+typedef struct {
+    lept_stats* stats;          // 本次解析的统计，为NULL时使用线程统计
+    size_t max_depth;           // 最大嵌套深度，0表示默认值LEPT_PARSE_MAX_DEPTH(1024)
+    const lept_pointer* const* paths;   // 投影：只建立这些路径所指的子树，其余值快速跳过
+    size_t npaths;
+    unsigned flags;             // LEPT_PARSE_* 的组合
+    const lept_schema* schema;  // 边解析边校验，第一个不满足的值处返回 LEPT_PARSE_SCHEMA_MISMATCH
+                                // 不能与 paths 同时使用（返回 LEPT_PARSE_INVALID_OPTIONS）
+} lept_parse_options;
+
+// 生成选项的标志位
+#define LEPT_STRINGIFY_CANONICAL    0x1     // 规范化输出(RFC 8785)：键按UTF-16码元排序，数字按ECMAScript格式，\u转义用小写；含NaN或无穷大时返回NULL
+#define LEPT_STRINGIFY_ASCII        0x2     // 只输出7位ASCII：非ASCII字符转义为\uXXXX（必要时为代理对），非法的UTF-8字节输出为\uFFFD
+
+// 生成选项，未用到的字段置0
+typedef struct {
+    lept_stats* stats;          // 本次生成的统计，为NULL时使用线程统计
+    unsigned flags;             // LEPT_STRINGIFY_* 的组合
+} lept_stringify_options;
+
+// 错误信息：错误码以及出错的字节偏移
+typedef struct {
+    int code;
+    size_t offset;
+} lept_error;
+
+// lept_parse_ex() 的结果：错误码，以及出错字节（成功时为文本末尾）的偏移
+typedef lept_error lept_parse_result;
+
 // 为了把表达式转为语句，模仿无返回值的函数
 #define lept_init(v) do { (v)->type = LEPT_NULL; } while(0)
 
@@ -77,11 +177,48 @@ enum {
 // 解析json 由于传入的json文本是一个c字符串，我们不希望改变它，所以使用‘const char*’
 // 传入的v一般是使用方负责分配的  返回值是错误类型
 int lept_parse(lept_value* v, const char* json);
+// 带选项的解析，opt可以为NULL
+int lept_parse_opt(lept_value* v, const char* json, const lept_parse_options* opt);
+// 同上，并返回出错位置
+lept_parse_result lept_parse_ex(lept_value* v, const char* json, const lept_parse_options* opt);
+// 投影解析，只保留paths所指的子树：路径经过的容器保留为骨架，数组中未选中的元素以null占位，
+// 未选中的成员被丢弃；跳过的值只检查括号和引号是否配对
+int lept_parse_projected(lept_value* v, const char* json, const lept_pointer* const* paths, size_t n);
+// 由字节偏移计算行号和列号（均从1开始，列以字节计），只在需要时重新扫描一遍；超出文本的偏移按文本末尾计算
+void lept_get_error_position(const char* json, size_t offset, size_t* line, size_t* column);
+// 只校验json文本是否合法，不建树、不分配内存，返回与lept_parse()相同的错误码；err可以为NULL
+// 数量级接近上限的数字逐位与溢出边界比较，以判断 LEPT_PARSE_NUMBER_TOO_BIG，不限数字长度
+int lept_validate(const char* json, size_t len, lept_error* err);
 // 生成器 字符化 length是一个可选参数 
 char* lept_stringify(const lept_value* v, size_t* length);
+char* lept_stringify_opt(const lept_value* v, size_t* length, const lept_stringify_options* opt);
+// 规范化输出，用于签名和按内容寻址；排序的是成员下标，不改变也不复制原对象
+// 含有 NaN 或无穷大时返回NULL（*length 为0），这些值没有规范的表示
+char* lept_stringify_canonical(const lept_value* v, size_t* length);
+
+// 清零统计信息
+void lept_stats_reset(lept_stats* s);
+// 为当前线程挂接统计信息（NULL为关闭），返回之前挂接的统计
+lept_stats* lept_set_thread_stats(lept_stats* s);
+
+// 键池：挂接到线程后，解析和 lept_set_object_value() 新建的键都先在池中查找，
+// 相同的键只存一份，查找时先比较指针。键带引用计数，释放键池后已建立的文档仍然有效
+typedef struct lept_key_pool lept_key_pool;
+lept_key_pool* lept_key_pool_new(void);
+void lept_key_pool_free(lept_key_pool* p);  // 若挂接在当前线程上则一并摘下；p可以为NULL
+// 为当前线程挂接键池（NULL为关闭），返回之前挂接的键池；一个键池同时只能由一个线程使用
+lept_key_pool* lept_set_thread_key_pool(lept_key_pool* p);
+// 取得（必要时收录）池中的键，在键池释放前有效，键太长或池已满时返回NULL
+// 用它查找经由键池建立的对象时只需比较指针
+const char* lept_key_pool_get(lept_key_pool* p, const char* key, size_t klen);
 
 
 void lept_copy(lept_value* dst, const lept_value* src); // 深拷贝
+// 写时复制的拷贝：dst与src共享容器的存储，O(1)完成；之后经可写的访问函数修改任何一方时，
+// 只复制从根到被修改结点这条路径上的容器。dst不能位于src之内。
+// 被复制的可能是src一方：调用之前从src取得的指向其内部的指针全部失效（之后可能指向dst的存储），
+// 调用之后要经访问函数重新取得，src与dst都是如此
+void lept_copy_shared(lept_value* dst, const lept_value* src);
 void lept_move(lept_value* dst, lept_value* src);       // 移动拷贝
 void lept_swap(lept_value* lhs, lept_value* rhs);       // 交换
 
@@ -91,7 +228,10 @@ void lept_free(lept_value* v);
 
 // 访问结果的函数，返回其类型
 lept_type lept_get_type(const lept_value* v);
-int lept_is_equal(const lept_value* lhs, const lept_value* rhs); // 相等比较
+int lept_is_equal(const lept_value* lhs, const lept_value* rhs); // 相等比较，两边都是冻结的文档且哈希不同时直接返回0
+// 结构哈希（64位），对象与成员顺序无关，相等的值哈希相同
+// 每次调用都重新计算；只有 lept_doc_freeze() 冻结的文档会缓存各容器的哈希
+uint64_t lept_hash(const lept_value* v);
 
 #define lept_set_null(v) lept_free(v)
 
@@ -115,7 +255,9 @@ void lept_reserve_array(lept_value* v, size_t capacity);
 void lept_shrink_array(lept_value* v);
 // 清空数组，不改变数组容量
 void lept_clear_array(lept_value* v);
+// 可写的访问函数会先分离共享的存储；只读时用 _const 的版本，它不写入任何东西，可用于 lept_doc_root() 返回的根值
 lept_value* lept_get_array_element(lept_value* v, size_t index);
+const lept_value* lept_get_array_element_const(const lept_value* v, size_t index);
 lept_value* lept_pushback_array_element(lept_value* v);
 void lept_popback_array_element(lept_value* v);
 lept_value* lept_insert_array_element(lept_value* v, size_t index);
@@ -131,8 +273,166 @@ void lept_clear_object(lept_value* v);
 const char* lept_get_object_key(const lept_value* v, size_t index);
 size_t lept_get_object_key_length(const lept_value* v, size_t index);
 lept_value* lept_get_object_value(lept_value* v, size_t index);
+const lept_value* lept_get_object_value_const(const lept_value* v, size_t index);
+// 成员较多（LEPT_OBJECT_INDEX_MIN，默认8个以上）的对象在可写查找（lept_find_object_value、lept_set_object_value 等）
+// 或 lept_doc_freeze 时建立键索引，之后每次查找只需一次探测；常量查找只使用已有的索引，没有时线性查找，
+// 从不写入值，多个线程可以同时对同一个值做常量查找
 size_t lept_find_object_index(const lept_value* v, const char* key, size_t klen);
 lept_value* lept_find_object_value(lept_value* v, const char* key, size_t klen);
+// 键的64位哈希（FNV-1a），leptjson.hpp 在编译期计算同样的值
+uint64_t lept_key_hash(const char* key, size_t klen);
+// 同上，使用预先算好的哈希 hash == lept_key_hash(key, klen)，查找时不再扫描键
+size_t lept_find_object_index_hashed(const lept_value* v, const char* key, size_t klen, uint64_t hash);
+// 在键的顺序相同的一串对象（如记录数组）中查找同一个键：*hint 记住上次找到的位置（初值任意），
+// 位置上的键相符时不再查找；解析时同一数组中键相同的对象共享键，核对只需比较指针
+size_t lept_find_object_index_hint(const lept_value* v, const char* key, size_t klen, size_t* hint);
+lept_value* lept_find_object_value_hashed(lept_value* v, const char* key, size_t klen, uint64_t hash);
 lept_value* lept_set_object_value(lept_value* v, const char* key, size_t klen);
 void lept_remove_object_value(lept_value* v, size_t index);
+
+// JSON Pointer (RFC 6901)，预先拆分令牌、反转义并转换数组下标，可在多个文档间重复使用
+// 编译指针，如 "/users/42/name"，语法错误时返回NULL
+lept_pointer* lept_pointer_compile(const char* s, size_t len);
+void lept_pointer_free(lept_pointer* p);
+// 查找指针所指的值，不存在时返回NULL
+lept_value* lept_pointer_get(const lept_pointer* p, lept_value* root);
+// 返回可写入的位置：对象中不存在的键会被加入，数组下标等于大小或为"-"时在末尾追加；上层不存在时返回NULL
+lept_value* lept_pointer_set(const lept_pointer* p, lept_value* root);
+
+// JSONPath 查询，编译一次后可对多个文档重复求值，如 "$..items[?(@.price < 10)].name"
+typedef struct lept_path lept_path;
+// 编译查询，语法错误时返回NULL
+lept_path* lept_path_compile(const char* query);
+void lept_path_free(lept_path* path);
+
+// 查询结果的迭代器，结果是借用文档中的结点，不分配结果数组
+typedef struct {
+    const lept_path* path;
+    lept_value* root;
+    char* stack;                // 内部工作栈，多次查询之间复用
+    size_t size, top;
+} lept_path_iter;
+
+#define lept_path_iter_init(it) do { (it)->stack = NULL; (it)->size = (it)->top = 0; } while(0)
+// 开始一次查询，查询过程中不能修改文档
+void lept_path_iter_begin(lept_path_iter* it, const lept_path* path, lept_value* root);
+// 按文档顺序返回下一个结果，没有更多结果时返回NULL
+lept_value* lept_path_iter_next(lept_path_iter* it);
+void lept_path_iter_free(lept_path_iter* it);
+
+// 原地应用 JSON Patch (RFC 6902)，patch为操作数组；出错时撤销已执行的操作，doc保持原样
+// 只记录被改动的值用于撤销，不复制整个文档
+int lept_patch_apply(lept_value* doc, const lept_value* patch);
+// 原地应用 JSON Merge Patch (RFC 7396)
+void lept_merge_patch(lept_value* target, const lept_value* patch);
+// 生成把a变为b的 JSON Patch，写入patch（原有内容被释放）
+// 用子树哈希跳过相同的分支（64位哈希和结点数都相同即视为相同），对象的键用散列表配对，数组去掉相同的首尾后逐个对应
+void lept_diff(const lept_value* a, const lept_value* b, lept_value* patch);
+
+// 编码为CBOR (RFC 8949)，不经过JSON文本；数组和映射写入元素个数，整数和浮点数取最短的无损编码
+// 返回malloc的缓冲区，长度写入length
+unsigned char* lept_to_cbor(const lept_value* v, size_t* length);
+// 从CBOR解码；定长数组/映射按头部给出的个数一次分配，也接受不定长形式，标签被忽略
+int lept_from_cbor(lept_value* v, const unsigned char* data, size_t len);
+
+// 编码为MessagePack，整数和浮点数自动取最短的无损格式；返回malloc的缓冲区，长度写入length
+unsigned char* lept_to_msgpack(const lept_value* v, size_t* length);
+// 从MessagePack解码，bin按字符串处理；flags为 LEPT_MSGPACK_* 的组合
+// 借用的字符串不以'\0'结尾，须用 lept_get_string_length() 取长度；lept_copy() 得到的副本则拥有自己的字符串
+int lept_from_msgpack(lept_value* v, const unsigned char* data, size_t len, unsigned flags);
+
+// 二进制快照：不含指针的文件格式，映射后不解析、不分配即可只读访问
+// 结点句柄直接指向映射的内存，在 lept_snapshot_close() 之前有效
+typedef struct lept_snap_node lept_snap_node;
+
+typedef struct {
+    const void* data;   // 映射的文件内容
+    size_t size;
+} lept_snapshot;
+
+int lept_snapshot_write(const lept_value* v, const char* path);
+// 映射快照文件，只检查文件头
+int lept_snapshot_open(lept_snapshot* s, const char* path);
+void lept_snapshot_close(lept_snapshot* s);
+const lept_snap_node* lept_snapshot_root(const lept_snapshot* s);
+
+// 与 lept_get_* 对应的只读访问，字符串和键以'\0'结尾
+lept_type lept_snap_get_type(const lept_snap_node* n);
+int lept_snap_get_boolean(const lept_snap_node* n);
+double lept_snap_get_number(const lept_snap_node* n);
+const char* lept_snap_get_string(const lept_snap_node* n);
+size_t lept_snap_get_string_length(const lept_snap_node* n);
+size_t lept_snap_get_array_size(const lept_snap_node* n);
+const lept_snap_node* lept_snap_get_array_element(const lept_snap_node* n, size_t index);
+size_t lept_snap_get_object_size(const lept_snap_node* n);
+const char* lept_snap_get_object_key(const lept_snap_node* n, size_t index);
+size_t lept_snap_get_object_key_length(const lept_snap_node* n, size_t index);
+const lept_snap_node* lept_snap_get_object_value(const lept_snap_node* n, size_t index);
+const lept_snap_node* lept_snap_find_object_value(const lept_snap_node* n, const char* key, size_t klen);
+
+// JSON Schema：编译为扁平的校验程序，可以校验解析好的值，也可以经 lept_parse_options 在解析时校验
+// 支持 type（含"integer"）、enum、minimum、maximum、exclusiveMinimum、exclusiveMaximum（数值形式）、
+// minLength、maxLength（按码点计）、minItems、maxItems、required、properties、additionalProperties、items（单个模式），
+// 以及 true/false 模式；$schema、$id、title、description、default、examples 被忽略
+// 模式不合法或含其它关键字时返回NULL
+lept_schema* lept_schema_compile(const lept_value* schema);
+void lept_schema_free(lept_schema* s);
+// 满足返回1，否则返回0
+int lept_schema_validate(const lept_schema* s, const lept_value* v);
+
+// 冻结的文档：只读、带原子引用计数，可由多个线程同时读取而无需拷贝或加锁
+typedef struct lept_doc lept_doc;
+
+// 接管v的内容（v变为null）并预先建好读访问会用到的缓存，引用计数为1
+lept_doc* lept_doc_freeze(lept_value* v);
+// 引用计数加1，返回d
+lept_doc* lept_doc_retain(lept_doc* d);
+// 引用计数减1，最后一个引用释放时释放整个文档；d可以为NULL
+void lept_doc_release(lept_doc* d);
+// 根值只能经由 const 的接口读取（lept_get_array_element_const、lept_get_object_value_const、lept_find_object_index、
+// lept_hash、lept_is_equal、lept_stringify 等），不能修改；可写的访问函数（如 lept_get_array_element）不能用于根值及其子结点
+const lept_value* lept_doc_root(const lept_doc* d);
+
+// 结构体绑定：按描述表在json文本和C结构体之间直接转换，不经过lept_value树
+typedef enum {
+    LEPT_BIND_BOOL,     // int，0或1
+    LEPT_BIND_INT,      // int64_t，json中须为整数，经由double转换
+    LEPT_BIND_DOUBLE,   // double
+    LEPT_BIND_STRING,   // char*，malloc的以'\0'结尾的字符串，null对应NULL
+    LEPT_BIND_STRUCT,   // 内嵌的结构体，由desc描述
+    LEPT_BIND_ARRAY     // 动态数组：成员为指向malloc的元素的指针，元素个数存放在count处的size_t中，null对应空数组
+} lept_bind_type;
+
+typedef struct lept_struct_desc lept_struct_desc;
+
+typedef struct {
+    const char* name;               // json中的键
+    size_t offset;                  // 成员的偏移
+    lept_bind_type type;
+    const lept_struct_desc* desc;   // LEPT_BIND_STRUCT，或元素为结构体的数组
+    lept_bind_type elem;            // 数组的元素类型，不能再是数组
+    size_t count;                   // 数组元素个数的偏移
+} lept_field;
+
+struct lept_struct_desc {
+    size_t size;                    // sizeof(结构体)
+    const lept_field* fields;
+    size_t nfields;
+};
+
+#define LEPT_FIELD(s, m, type)              { #m, offsetof(s, m), type, NULL, LEPT_BIND_BOOL, 0 }
+#define LEPT_FIELD_STRUCT(s, m, desc)       { #m, offsetof(s, m), LEPT_BIND_STRUCT, desc, LEPT_BIND_BOOL, 0 }
+#define LEPT_FIELD_ARRAY(s, m, n, elem, desc) { #m, offsetof(s, m), LEPT_BIND_ARRAY, desc, elem, offsetof(s, n) }
+
+// 把一个json对象解析进out所指的结构体：out先被清零，描述表中没有的键被跳过（只检查括号和引号是否配对），
+// json中没有的成员保持为0，重复的键以最后一个为准；出错时已绑定的内容被释放，返回 LEPT_PARSE_* 错误码
+int lept_parse_bind(void* out, const lept_struct_desc* d, const char* json);
+// 按描述表的顺序输出全部成员
+char* lept_stringify_bind(const void* in, const lept_struct_desc* d, size_t* length);
+// 释放绑定时分配的字符串和数组，并把它们置为NULL/0
+void lept_bind_free(void* p, const lept_struct_desc* d);
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* LEPTJSON_H__ */
\ No newline at end of file
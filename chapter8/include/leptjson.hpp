@@ -0,0 +1,332 @@
+#ifndef LEPTJSON_HPP__
+#define LEPTJSON_HPP__
+// leptjson 的 C++17 封装，只有头文件
+// lept::value 与 lept_value 布局相同，只能移动；拷贝只能显式调用 copy() 或写时复制的 share()
+// 字符串和键以 std::string_view 借用结点中的内容，结点被修改或释放后失效
+
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include "leptjson.h"
+
+namespace lept {
+
+class value;
+
+// 对象成员：键和值都借用自对象
+template <typename V>
+struct basic_member {
+    std::string_view key;
+    V& val;
+};
+
+using member = basic_member<value>;
+using const_member = basic_member<const value>;
+
+namespace detail {
+
+// 由 lept_value 得到同一位置的 lept::value，两者布局相同
+template <typename V, typename E>
+inline V& wrap(E* e) noexcept {
+    return *reinterpret_cast<V*>(e);
+}
+
+inline const char* data(std::string_view s) noexcept {
+    return s.data() ? s.data() : "";    // 空的 string_view 可能没有缓冲区，而C接口要求非NULL
+}
+
+} // namespace detail
+
+// 与 lept_key_hash() 相同的FNV-1a，可在编译期计算
+constexpr uint64_t key_hash(std::string_view s) noexcept {
+    uint64_t h = 14695981039346656037ULL;
+    for (char ch : s)
+        h = (h ^ static_cast<unsigned char>(ch)) * 1099511628211ULL;
+    return h;
+}
+
+// 预先算好哈希和长度的键，查找时不再调用 strlen 或扫描键，如 obj["user_id"_k]
+// 声明为 constexpr 变量（或直接使用字面值）时哈希在编译期算出
+class key {
+public:
+    constexpr explicit key(std::string_view s) noexcept : s_(s), hash_(key_hash(s)) {}
+    constexpr std::string_view str() const noexcept { return s_; }
+    constexpr uint64_t hash() const noexcept { return hash_; }
+
+private:
+    std::string_view s_;
+    uint64_t hash_;
+};
+
+namespace literals {
+
+constexpr key operator""_k(const char* s, std::size_t n) noexcept { return key(std::string_view(s, n)); }
+
+} // namespace literals
+
+// 遍历数组 u.a.e
+template <typename V>
+class element_iterator {
+    using node = std::conditional_t<std::is_const_v<V>, const lept_value, lept_value>;
+public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = std::remove_const_t<V>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = V*;
+    using reference = V&;
+
+    element_iterator() noexcept : p_(nullptr) {}
+    explicit element_iterator(node* p) noexcept : p_(p) {}
+
+    reference operator*() const noexcept { return detail::wrap<V>(p_); }
+    pointer operator->() const noexcept { return &detail::wrap<V>(p_); }
+    reference operator[](difference_type n) const noexcept { return detail::wrap<V>(p_ + n); }
+    element_iterator& operator++() noexcept { ++p_; return *this; }
+    element_iterator operator++(int) noexcept { element_iterator t = *this; ++p_; return t; }
+    element_iterator& operator--() noexcept { --p_; return *this; }
+    element_iterator operator--(int) noexcept { element_iterator t = *this; --p_; return t; }
+    element_iterator& operator+=(difference_type n) noexcept { p_ += n; return *this; }
+    element_iterator& operator-=(difference_type n) noexcept { p_ -= n; return *this; }
+    element_iterator operator+(difference_type n) const noexcept { return element_iterator(p_ + n); }
+    element_iterator operator-(difference_type n) const noexcept { return element_iterator(p_ - n); }
+    difference_type operator-(const element_iterator& o) const noexcept { return p_ - o.p_; }
+    bool operator==(const element_iterator& o) const noexcept { return p_ == o.p_; }
+    bool operator!=(const element_iterator& o) const noexcept { return p_ != o.p_; }
+    bool operator<(const element_iterator& o) const noexcept { return p_ < o.p_; }
+
+private:
+    node* p_;
+};
+
+// 遍历对象 u.o.m，解引用得到 basic_member
+template <typename V>
+class member_iterator {
+    using node = std::conditional_t<std::is_const_v<V>, const lept_member, lept_member>;
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = basic_member<V>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = basic_member<V>;
+
+    member_iterator() noexcept : p_(nullptr) {}
+    explicit member_iterator(node* p) noexcept : p_(p) {}
+
+    reference operator*() const noexcept { return { std::string_view(p_->k, p_->klen), detail::wrap<V>(&p_->v) }; }
+    member_iterator& operator++() noexcept { ++p_; return *this; }
+    member_iterator operator++(int) noexcept { member_iterator t = *this; ++p_; return t; }
+    bool operator==(const member_iterator& o) const noexcept { return p_ == o.p_; }
+    bool operator!=(const member_iterator& o) const noexcept { return p_ != o.p_; }
+
+private:
+    node* p_;
+};
+
+// 供 range-for 使用的迭代器对
+template <typename I>
+class range {
+public:
+    range(I b, I e) noexcept : b_(b), e_(e) {}
+    I begin() const noexcept { return b_; }
+    I end() const noexcept { return e_; }
+
+private:
+    I b_, e_;
+};
+
+class value {
+public:
+    value() noexcept { lept_init(&v_); }
+    value(std::nullptr_t) noexcept { lept_init(&v_); }
+    value(bool b) noexcept { lept_init(&v_); lept_set_boolean(&v_, b); }
+    value(int n) noexcept { lept_init(&v_); lept_set_number(&v_, n); }
+    value(double n) noexcept { lept_init(&v_); lept_set_number(&v_, n); }
+    // 没有这个重载时字符串字面值会优先转换为bool
+    value(const char* s) { lept_init(&v_); set_string(s); }
+    value(std::string_view s) { lept_init(&v_); set_string(s); }
+    ~value() { lept_free(&v_); }
+
+    // 只能移动，避免无意中的深拷贝
+    value(const value&) = delete;
+    value& operator=(const value&) = delete;
+    value(value&& o) noexcept { lept_init(&v_); lept_move(&v_, &o.v_); }
+    value& operator=(value&& o) noexcept {
+        if (this != &o)
+            lept_move(&v_, &o.v_);
+        return *this;
+    }
+
+    static value array(std::size_t capacity = 0) { value r; lept_set_array(&r.v_, capacity); return r; }
+    static value object(std::size_t capacity = 0) { value r; lept_set_object(&r.v_, capacity); return r; }
+
+    // 把C接口中的结点当作 lept::value 使用，不转移所有权
+    static value& wrap(lept_value& v) noexcept { return detail::wrap<value>(&v); }
+    static const value& wrap(const lept_value& v) noexcept { return detail::wrap<const value>(&v); }
+    lept_value* get() noexcept { return &v_; }
+    const lept_value* get() const noexcept { return &v_; }
+
+    // 深拷贝只能显式进行
+    value copy() const { value r; lept_copy(&r.v_, &v_); return r; }
+    // 写时复制的拷贝，之前从本对象取得的内部引用全部失效，见 lept_copy_shared
+    value share() const { value r; lept_copy_shared(&r.v_, &v_); return r; }
+    void swap(value& o) noexcept { lept_swap(&v_, &o.v_); }
+
+    // 返回 LEPT_PARSE_* 错误码，出错时值为null
+    int parse(const char* json) { lept_free(&v_); return lept_parse(&v_, json); }
+    int parse(const char* json, const lept_parse_options& opt) { lept_free(&v_); return lept_parse_opt(&v_, json, &opt); }
+    std::string stringify() const {
+        std::size_t length;
+        char* s = lept_stringify(&v_, &length);
+        std::string r(s, length);
+        std::free(s);
+        return r;
+    }
+
+    lept_type type() const noexcept { return v_.type; }
+    bool is_null() const noexcept { return v_.type == LEPT_NULL; }
+    bool is_bool() const noexcept { return v_.type == LEPT_TRUE || v_.type == LEPT_FALSE; }
+    bool is_number() const noexcept { return v_.type == LEPT_NUMBER; }
+    bool is_string() const noexcept { return v_.type == LEPT_STRING; }
+    bool is_array() const noexcept { return v_.type == LEPT_ARRAY; }
+    bool is_object() const noexcept { return v_.type == LEPT_OBJECT; }
+
+    bool get_bool() const noexcept { return lept_get_boolean(&v_) != 0; }
+    double get_number() const noexcept { return lept_get_number(&v_); }
+    std::string_view get_string() const noexcept { return std::string_view(lept_get_string(&v_), lept_get_string_length(&v_)); }
+
+    void set_null() noexcept { lept_set_null(&v_); }
+    void set_bool(bool b) noexcept { lept_set_boolean(&v_, b); }
+    void set_number(double n) noexcept { lept_set_number(&v_, n); }
+    void set_string(std::string_view s) { lept_set_string(&v_, detail::data(s), s.size()); }
+
+    // 数组的元素个数或对象的成员个数
+    std::size_t size() const noexcept {
+        assert(is_array() || is_object());
+        return is_array() ? v_.u.a.size : v_.u.o.size;
+    }
+
+    // 数组访问；可写的访问经由C接口，会先分离共享的存储
+    value& operator[](std::size_t i) noexcept { return wrap(*lept_get_array_element(&v_, i)); }
+    const value& operator[](std::size_t i) const noexcept {
+        assert(is_array() && i < v_.u.a.size);
+        return wrap(v_.u.a.e[i]);
+    }
+    value& push_back(value&& e) {
+        lept_value* p = lept_pushback_array_element(&v_);
+        lept_move(p, &e.v_);
+        return wrap(*p);
+    }
+    void pop_back() noexcept { lept_popback_array_element(&v_); }
+
+    // 对象访问；不存在的键：可写的 operator[] 加入一个null成员，const 的版本断言失败
+    value& operator[](std::string_view key) { return wrap(*lept_set_object_value(&v_, detail::data(key), key.size())); }
+    const value& operator[](std::string_view key) const noexcept {
+        const value* p = find(key);
+        assert(p != nullptr);
+        return *p;
+    }
+    value* find(std::string_view key) noexcept {
+        lept_value* p = lept_find_object_value(&v_, detail::data(key), key.size());
+        return p ? &wrap(*p) : nullptr;
+    }
+    const value* find(std::string_view key) const noexcept {
+        std::size_t i = lept_find_object_index(&v_, detail::data(key), key.size());
+        return i == LEPT_KEY_NOT_EXIST ? nullptr : &wrap(v_.u.o.m[i].v);
+    }
+    // 用预先算好哈希的键查找，较大的对象只需一次探测
+    value& operator[](const key& k) {
+        if (value* p = find(k))
+            return *p;
+        return wrap(*lept_set_object_value(&v_, detail::data(k.str()), k.str().size()));
+    }
+    const value& operator[](const key& k) const noexcept {
+        const value* p = find(k);
+        assert(p != nullptr);
+        return *p;
+    }
+    value* find(const key& k) noexcept {
+        lept_value* p = lept_find_object_value_hashed(&v_, detail::data(k.str()), k.str().size(), k.hash());
+        return p ? &wrap(*p) : nullptr;
+    }
+    const value* find(const key& k) const noexcept {
+        std::size_t i = lept_find_object_index_hashed(&v_, detail::data(k.str()), k.str().size(), k.hash());
+        return i == LEPT_KEY_NOT_EXIST ? nullptr : &wrap(v_.u.o.m[i].v);
+    }
+
+    // 已有的键被覆盖
+    value& insert(std::string_view key, value&& e) {
+        lept_value* p = lept_set_object_value(&v_, detail::data(key), key.size());
+        lept_move(p, &e.v_);
+        return wrap(*p);
+    }
+    bool erase(std::string_view key) noexcept {
+        std::size_t i = lept_find_object_index(&v_, detail::data(key), key.size());
+        if (i == LEPT_KEY_NOT_EXIST)
+            return false;
+        lept_remove_object_value(&v_, i);
+        return true;
+    }
+
+    // range-for：for (value& e : v.elements())，for (auto [k, e] : v.members())
+    range<element_iterator<value>> elements() noexcept {
+        assert(is_array());
+        if (v_.u.a.size > 0)
+            lept_get_array_element(&v_, 0);     // 元素可能经迭代器被修改，先分离共享的存储
+        return { element_iterator<value>(v_.u.a.e), element_iterator<value>(v_.u.a.e + v_.u.a.size) };
+    }
+    range<element_iterator<const value>> elements() const noexcept {
+        assert(is_array());
+        return { element_iterator<const value>(v_.u.a.e), element_iterator<const value>(v_.u.a.e + v_.u.a.size) };
+    }
+    range<member_iterator<value>> members() noexcept {
+        assert(is_object());
+        if (v_.u.o.size > 0)
+            lept_get_object_value(&v_, 0);
+        return { member_iterator<value>(v_.u.o.m), member_iterator<value>(v_.u.o.m + v_.u.o.size) };
+    }
+    range<member_iterator<const value>> members() const noexcept {
+        assert(is_object());
+        return { member_iterator<const value>(v_.u.o.m), member_iterator<const value>(v_.u.o.m + v_.u.o.size) };
+    }
+
+    uint64_t hash() const noexcept { return lept_hash(&v_); }
+    friend bool operator==(const value& a, const value& b) noexcept { return lept_is_equal(&a.v_, &b.v_) != 0; }
+    friend bool operator!=(const value& a, const value& b) noexcept { return !(a == b); }
+
+private:
+    lept_value v_;
+};
+
+static_assert(sizeof(value) == sizeof(lept_value) && std::is_standard_layout_v<value>,
+    "lept::value must have the same layout as lept_value");
+
+inline void swap(value& a, value& b) noexcept { a.swap(b); }
+
+// 冻结文档的句柄，拷贝只增加引用计数，可以把拷贝交给其它线程
+class doc {
+public:
+    doc() noexcept : d_(nullptr) {}
+    // 接管v的内容，v变为null
+    explicit doc(value&& v) : d_(lept_doc_freeze(v.get())) {}
+    doc(const doc& o) noexcept : d_(o.d_ ? lept_doc_retain(o.d_) : nullptr) {}
+    doc(doc&& o) noexcept : d_(o.d_) { o.d_ = nullptr; }
+    doc& operator=(doc o) noexcept { std::swap(d_, o.d_); return *this; }
+    ~doc() { lept_doc_release(d_); }
+
+    explicit operator bool() const noexcept { return d_ != nullptr; }
+    const value& root() const noexcept { assert(d_ != nullptr); return value::wrap(*lept_doc_root(d_)); }
+    const value& operator*() const noexcept { return root(); }
+    const value* operator->() const noexcept { return &root(); }
+
+private:
+    lept_doc* d_;
+};
+
+} // namespace lept
+
+#endif /* LEPTJSON_HPP__ */
@@ -7,17 +7,96 @@
 #include <assert.h>         // asser()
 #include <errno.h>          // errno, ERANGE
 #include <math.h>           // HUGE_VAL
+#include <float.h>          // FLT_MAX
 #include <string.h>         // memcpy()
 #include <stdio.h>
+#include <time.h>           // clock_gettime(), clock()
+#include <stdint.h>         // uint64_t
+#ifdef _WIN32
+#include <windows.h>        // QueryPerformanceCounter(), MapViewOfFile()
+#else
+#include <fcntl.h>          // open()
+#include <sys/mman.h>       // mmap()
+#include <sys/stat.h>       // fstat()
+#include <unistd.h>         // close()
+#endif
 
 #ifndef LEPT_PARSE_STACK_INIT_SIZE
 #define LEPT_PARSE_STACK_INIT_SIZE 256
 #endif
 
+// 默认的最大嵌套深度，可由 lept_parse_options.max_depth 覆盖
+#ifndef LEPT_PARSE_MAX_DEPTH
+#define LEPT_PARSE_MAX_DEPTH 1024
+#endif
+
+#ifndef LEPT_OBJECT_INDEX_MIN
+#define LEPT_OBJECT_INDEX_MIN 8     // 成员个数达到此值的对象在查找时建立键索引
+#endif
+
+#ifndef LEPT_KEY_POOL_MAX
+#define LEPT_KEY_POOL_MAX 4096          // 键池最多收录的键数，之后的新键照常单独分配
+#endif
+
+#ifndef LEPT_KEY_POOL_MAX_LENGTH
+#define LEPT_KEY_POOL_MAX_LENGTH 64     // 更长的键很少重复，不收录
+#endif
+
+#ifndef LEPT_KEY_MEMO_SIZE
+#define LEPT_KEY_MEMO_SIZE 64           // 生成时按指针记住的已转义键的个数
+#endif
+
 #ifndef LEPT_PARSE_STRINGIFY_INIT_SIZE
 #define LEPT_PARSE_STRINGIFY_INIT_SIZE 256
 #endif
 
+// 线程局部存储，用于按线程挂接统计信息
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_THREADS__)
+#define LEPT_THREAD_LOCAL _Thread_local
+#elif defined(_MSC_VER)
+#define LEPT_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__)
+#define LEPT_THREAD_LOCAL __thread
+#else
+#define LEPT_THREAD_LOCAL
+#endif
+
+// 原子引用计数，LEPT_REF_INC/LEPT_REF_DEC 返回修改后的值，LEPT_REF_GET 读取当前值
+// 减少时用 acquire-release，使最后一个释放者看得到其它线程之前的全部读写
+#if defined(__GNUC__)
+typedef long lept_refcount;
+#define LEPT_REF_INC(p) __atomic_add_fetch((p), 1, __ATOMIC_RELAXED)
+#define LEPT_REF_DEC(p) __atomic_sub_fetch((p), 1, __ATOMIC_ACQ_REL)
+#define LEPT_REF_GET(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#elif defined(_MSC_VER)
+typedef volatile LONG lept_refcount;
+#define LEPT_REF_INC(p) InterlockedIncrement(p)
+#define LEPT_REF_DEC(p) InterlockedDecrement(p)
+#define LEPT_REF_GET(p) (*(p))
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_ATOMICS__)
+#include <stdatomic.h>
+typedef atomic_long lept_refcount;
+#define LEPT_REF_INC(p) (atomic_fetch_add_explicit((p), 1, memory_order_relaxed) + 1)
+#define LEPT_REF_DEC(p) (atomic_fetch_sub_explicit((p), 1, memory_order_acq_rel) - 1)
+#define LEPT_REF_GET(p) atomic_load_explicit((p), memory_order_acquire)
+#else
+typedef long lept_refcount;     // 没有原子操作时只能在单线程中共享
+#define LEPT_REF_INC(p) (++*(p))
+#define LEPT_REF_DEC(p) (--*(p))
+#define LEPT_REF_GET(p) (*(p))
+#endif
+
+// x86 上用 SSSE3 查表校验 UTF-8，运行时检测CPU；定义 LEPT_NO_SIMD 可关闭
+#if !defined(LEPT_NO_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LEPT_SSSE3 1
+#include <tmmintrin.h>      // _mm_shuffle_epi8(), _mm_alignr_epi8()
+#endif
+// SSE2 是 x86-64 的基本指令集，编译器声明支持时直接使用
+#if !defined(LEPT_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64))
+#define LEPT_SSE2 1
+#include <emmintrin.h>      // _mm_cmplt_epi8(), _mm_movemask_epi8()
+#endif
+
 // 这里使用do...while(0) 是一个编写宏的技巧
 // 如果宏里面有多过一个语句，就使用do{}while(0)来包裹成单个语句
 // 这个宏的作用是判断当前首字符是否是所期望的ch
@@ -28,6 +107,12 @@
 // 输出字符串到自定义堆栈中
 #define PUTS(c, s, len)     memcpy(lept_context_push(c, len), s, len)
 
+// 生成时记住一个键转义后在输出中的位置，同一形状的对象共享键，再遇到时直接复制
+typedef struct {
+    const char* k;
+    size_t off, len;    // 在 c->stack 中的偏移和长度，含引号
+} lept_key_memo;
+
 // 首先为了减少解析函数之间传递多个参数，我们把这些数据都放进一个 `lept_context` 结构体
 typedef struct 
 {
@@ -38,8 +123,38 @@ typedef struct
     char* stack;
     size_t size;    // 当前stack容量
     size_t top;     // 栈顶位置，由于自动扩容，所以不用指针
+    lept_stats* stats;  // 统计信息，为NULL时不做任何统计
+    size_t depth;       // 当前嵌套深度
+    size_t max_depth;   // 允许的最大嵌套深度
+    const lept_pointer* const* proj;    // 投影解析时要保留的路径，nproj为0时解析全部
+    size_t nproj;
+    unsigned flags;     // 解析选项 LEPT_PARSE_* 或生成选项 LEPT_STRINGIFY_*
+    const lept_schema* schema;  // 解析时校验的模式，可以为NULL
+    lept_key_memo* memo;        // 生成时已转义的键，LEPT_KEY_MEMO_SIZE 个，按键的指针直接映射
 } lept_context;
 
+// 生成时遇到不能输出的值，置于 c->flags 的最高位，不与公开的 LEPT_STRINGIFY_* 冲突
+#define LEPT_STRINGIFY_FAILED 0x80000000u
+
+static LEPT_THREAD_LOCAL lept_stats* lept_thread_stats = NULL;
+static LEPT_THREAD_LOCAL lept_key_pool* lept_thread_key_pool = NULL;
+
+// 单调时钟，单位为秒，只在开启统计时调用
+static double lept_clock(void) {
+#if defined(_WIN32)
+    LARGE_INTEGER f, t;
+    QueryPerformanceFrequency(&f);
+    QueryPerformanceCounter(&t);
+    return (double)t.QuadPart / (double)f.QuadPart;
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#else
+    return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
 
 // 压入任意大小数据，返回数据(压入的)起始的指针
 static void* lept_context_push(lept_context* c, size_t size) {
@@ -52,12 +167,21 @@ static void* lept_context_push(lept_context* c, size_t size) {
         // 这里使用while 是因为可能需要push的字符串很长 可能不止需要扩一次 所以这里一次计算
         while (c->top + size >= c->size)
             c->size += c->size >> 1;    // 这里是1.5倍扩容
+        if (c->stats) {
+            if (c->stack == NULL)
+                c->stats->stack_mallocs++;
+            else
+                c->stats->stack_reallocs++;
+            c->stats->stack_alloc_bytes += c->size;
+        }
         // 这里如果是第一次分配 c->stack本身在init时是NULL 所以等价于malloc(size) 不需要为第一次作特别处理
         c->stack = (char*)realloc(c->stack, c->size);
     }
     // 这里记录的是开始插入的位置
     ret = c->stack + c->top;
     c->top += size;
+    if (c->stats && c->top > c->stats->stack_peak)
+        c->stats->stack_peak = c->top;
     return ret;
 }
 
@@ -68,6 +192,215 @@ static void* lept_context_pop(lept_context* c, size_t size) {
     return c->stack + (c->top -= size);
 }
 
+// FNV-1a，用于键的哈希和子树哈希
+#define LEPT_FNV_OFFSET 14695981039346656037ULL
+#define LEPT_FNV_PRIME  1099511628211ULL
+
+static uint64_t lept_fnv1a(uint64_t h, const void* p, size_t len) {
+    const unsigned char* s = (const unsigned char*)p;
+    while (len--)
+        h = (h ^ *s++) * LEPT_FNV_PRIME;
+    return h;
+}
+
+// 对象的键索引：开放寻址的散列表，槽数为2的幂，按键的哈希线性探测
+typedef struct {
+    uint64_t hash;      // 键的哈希 lept_key_hash()
+    size_t index;       // 成员下标+1，0为空槽
+} lept_index_slot;
+
+typedef struct {
+    size_t mask;        // 槽数-1
+    size_t size;        // 已索引的成员个数，与对象的成员个数不符时重建
+    lept_index_slot slot[1];
+} lept_index;
+
+// 数组/对象的缓冲区前面带一个头部，存放与内容相关的缓存，lept_value本身的大小不变
+typedef struct {
+    uint64_t hash;      // 缓存的子树哈希
+    int hashed;         // hash是否有效；只有冻结的文档写入，可变的树中修改子孙不会通知祖先，不能缓存
+    lept_index* index;  // 对象的键索引，第一次在较大的对象中查找时建立，键的集合改变时丢弃
+    lept_refcount refs; // 共享这个缓冲区的值的个数，见 lept_copy_shared()
+} lept_header;
+
+#define LEPT_HEADER(p) ((lept_header*)(p) - 1)
+
+// 分配/调整容器缓冲区，n为0时释放并返回NULL；新分配的缓冲区没有缓存
+static void* lept_buffer_realloc(void* p, size_t n, size_t size) {
+    lept_header* h;
+    if (n == 0) {
+        if (p) {
+            free(LEPT_HEADER(p)->index);
+            free(LEPT_HEADER(p));
+        }
+        return NULL;
+    }
+    h = (lept_header*)realloc(p ? LEPT_HEADER(p) : NULL, sizeof(lept_header) + n * size);
+    if (p == NULL) {
+        h->hashed = 0;
+        h->index = NULL;
+        h->refs = 1;
+    }
+    return h + 1;
+}
+
+static void lept_buffer_free(void* p) {
+    if (p) {
+        free(LEPT_HEADER(p)->index);
+        free(LEPT_HEADER(p));
+    }
+}
+
+// 放弃对缓冲区的一个引用，是最后一个引用时返回1，由调用者释放内容和缓冲区
+static int lept_buffer_release(void* p) {
+    return p == NULL || LEPT_REF_GET(&LEPT_HEADER(p)->refs) == 1 || LEPT_REF_DEC(&LEPT_HEADER(p)->refs) == 0;
+}
+
+static lept_header* lept_get_header(const lept_value* v) {
+    if (v->type == LEPT_ARRAY)
+        return v->u.a.e ? LEPT_HEADER(v->u.a.e) : NULL;
+    if (v->type == LEPT_OBJECT)
+        return v->u.o.m ? LEPT_HEADER(v->u.o.m) : NULL;
+    return NULL;
+}
+
+// 对象的键前面带一个引用计数，同一个键可以被多个成员共享（键池、拷贝），键本身不可修改
+#define LEPT_KEY_REFS(k) ((lept_refcount*)(k) - 1)
+
+// 键池：开放寻址的散列表，槽数为2的幂，池本身持有收录的每个键的一个引用
+typedef struct {
+    uint64_t hash;
+    char* k;            // NULL为空槽
+    size_t klen;
+} lept_key_slot;
+
+struct lept_key_pool {
+    lept_key_slot* slot;
+    size_t mask;        // 槽数-1
+    size_t size;        // 已收录的键数
+};
+
+static char* lept_key_alloc(const char* s, size_t len) {
+    lept_refcount* r = (lept_refcount*)malloc(sizeof(lept_refcount) + len + 1);
+    char* k = (char*)(r + 1);
+    *r = 1;
+    memcpy(k, s, len);
+    k[len] = '\0';
+    return k;
+}
+
+static char* lept_key_retain(char* k) {
+    LEPT_REF_INC(LEPT_KEY_REFS(k));
+    return k;
+}
+
+static void lept_key_free(char* k) {
+    if (k != NULL && (LEPT_REF_GET(LEPT_KEY_REFS(k)) == 1 || LEPT_REF_DEC(LEPT_KEY_REFS(k)) == 0))
+        free(LEPT_KEY_REFS(k));
+}
+
+static void lept_key_pool_grow(lept_key_pool* p) {
+    lept_key_slot* old = p->slot;
+    size_t i, j, n = p->mask + 1;
+    p->slot = (lept_key_slot*)calloc(n * 2, sizeof(lept_key_slot));
+    p->mask = n * 2 - 1;
+    for (i = 0; i < n; i++)
+        if (old[i].k != NULL) {
+            for (j = (size_t)old[i].hash & p->mask; p->slot[j].k != NULL; j = (j + 1) & p->mask)
+                ;
+            p->slot[j] = old[i];
+        }
+    free(old);
+}
+
+// 在键池中查找或收录键，返回已增加引用的键；键太长或池已满时单独分配
+static char* lept_key_pool_intern(lept_key_pool* p, const char* s, size_t len) {
+    uint64_t h;
+    size_t i;
+    if (len > LEPT_KEY_POOL_MAX_LENGTH)
+        return lept_key_alloc(s, len);
+    h = lept_fnv1a(LEPT_FNV_OFFSET, s, len);
+    for (i = (size_t)h & p->mask; p->slot[i].k != NULL; i = (i + 1) & p->mask)
+        if (p->slot[i].hash == h && p->slot[i].klen == len && memcmp(p->slot[i].k, s, len) == 0)
+            return lept_key_retain(p->slot[i].k);
+    if (p->size >= LEPT_KEY_POOL_MAX)
+        return lept_key_alloc(s, len);
+    // 装填因子不超过1/2
+    if ((p->size + 1) * 2 > p->mask + 1) {
+        lept_key_pool_grow(p);
+        for (i = (size_t)h & p->mask; p->slot[i].k != NULL; i = (i + 1) & p->mask)
+            ;
+    }
+    p->slot[i].hash = h;
+    p->slot[i].k = lept_key_alloc(s, len);
+    p->slot[i].klen = len;
+    p->size++;
+    return lept_key_retain(p->slot[i].k);
+}
+
+// 为成员分配键，当前线程挂接了键池时经由键池
+static char* lept_key_new(const char* s, size_t len) {
+    lept_key_pool* p = lept_thread_key_pool;
+    return p != NULL ? lept_key_pool_intern(p, s, len) : lept_key_alloc(s, len);
+}
+
+// 共享一个子结点：容器只增加缓冲区的引用计数，字符串没有计数，另外复制一份
+static void lept_share_child(lept_value* dst, const lept_value* src) {
+    lept_header* h = lept_get_header(src);
+    memcpy(dst, src, sizeof(lept_value));
+    if (h != NULL)
+        LEPT_REF_INC(&h->refs);
+    else if (src->type == LEPT_STRING && !src->u.s.borrowed)
+        memcpy(dst->u.s.s = (char*)malloc(src->u.s.len + 1), src->u.s.s, src->u.s.len + 1);
+}
+
+// 写时复制：缓冲区被其它值共享时，先给v复制自己的一份再修改
+// 只复制这一层，子容器继续共享，等到经过它们修改时再各自分离
+static void lept_unshare(lept_value* v) {
+    lept_header* h = lept_get_header(v);
+    lept_value old;
+    size_t i;
+    if (h == NULL || LEPT_REF_GET(&h->refs) == 1)
+        return;
+    memcpy(&old, v, sizeof(lept_value));
+    if (v->type == LEPT_ARRAY) {
+        v->u.a.e = (lept_value*)lept_buffer_realloc(NULL, v->u.a.capacity, sizeof(lept_value));
+        for (i = 0; i < v->u.a.size; i++)
+            lept_share_child(&v->u.a.e[i], &old.u.a.e[i]);
+    }
+    else {
+        v->u.o.m = (lept_member*)lept_buffer_realloc(NULL, v->u.o.capacity, sizeof(lept_member));
+        for (i = 0; i < v->u.o.size; i++) {
+            lept_member* m = &v->u.o.m[i];
+            const lept_member* o = &old.u.o.m[i];
+            m->k = lept_key_retain(o->k);
+            m->klen = o->klen;
+            lept_share_child(&m->v, &o->v);
+        }
+    }
+    // 其它值恰好同时放弃了原缓冲区时，由这里释放
+    lept_free(&old);
+}
+
+// 容器的内容可能被修改，丢弃缓存的哈希
+static void lept_touch(lept_value* v) {
+    lept_header* h;
+    lept_unshare(v);
+    if ((h = lept_get_header(v)) != NULL)
+        h->hashed = 0;
+}
+
+// 对象的键被增删或移动，丢弃键索引（只修改值时索引仍然有效）
+static void lept_touch_keys(lept_value* v) {
+    lept_header* h;
+    lept_unshare(v);
+    if ((h = lept_get_header(v)) != NULL) {
+        h->hashed = 0;
+        free(h->index);
+        h->index = NULL;
+    }
+}
+
 // 解析ws
 static void lept_parse_whitespace(lept_context* c) {
     const char* p = c->json;
@@ -119,8 +452,10 @@ static int lept_parse_literal(lept_context* c, lept_value* v, const char* litera
     // 循环判断后面几个字符 如果有一位不匹配 则返回错误码 是无效值
     // 直到‘\0’结束
     for (i = 0; literal[i + 1]; i++)
-        if (c->json[i] != literal[i + 1])
+        if (c->json[i] != literal[i + 1]) {
+            c->json += i;
             return LEPT_PARSE_INVALID_VALUE;
+        }
     // 最后一个匹配字符，指针后移
     c->json += i;
     v->type = type;
@@ -135,27 +470,29 @@ static int lept_parse_literal(lept_context* c, lept_value* v, const char* litera
  * frac = "." 1*digit
  * exp = ("e" / "E") ["-" / "+"]1*digit        ()必选
 */
+// 出错时令 c->json 指向出错的字节，成功路径上没有任何额外开销
+#define NUMBER_ERROR(ret) (c->json = p, ret)
 static int lept_parse_number(lept_context* c, lept_value* v) {
     const char* p = c->json;
     if (*p == '-') p++;      // 检验第一位负号，跳过
     if (*p == '0') p++;      // 检验开始的第一个数字是否为0，跳过，第一位数字是0，则后面直接遇到‘.’不再有其他数字
     else {
         // 开始符号位之后 不是0 也不是0-9的数字，则不是number
-        if (!ISDIGIT1TO9(*p)) return LEPT_PARSE_INVALID_VALUE;
+        if (!ISDIGIT1TO9(*p)) return NUMBER_ERROR(LEPT_PARSE_INVALID_VALUE);
         // 连续跳过数字字符
         for (p++; ISDIGIT(*p); p++);
     }
     if(*p == '.') {
         p++;
         // 小数点之后不是数字，无效
-        if (!ISDIGIT(*p)) return LEPT_PARSE_INVALID_VALUE;
+        if (!ISDIGIT(*p)) return NUMBER_ERROR(LEPT_PARSE_INVALID_VALUE);
         for (p++; ISDIGIT(*p); p++);
     }
     if (*p == 'e' || *p == 'E') {// 科学计数表示
         p++;
         if(*p == '+' || *p == '-') p++; // 指数符号
         // 含有数字以外字符 无效
-        if (!ISDIGIT(*p)) return LEPT_PARSE_INVALID_VALUE;
+        if (!ISDIGIT(*p)) return NUMBER_ERROR(LEPT_PARSE_INVALID_VALUE);
         for (p++; ISDIGIT(*p); p++);
     }
     // errno是stdlib中的一个宏，保存程序运行中的错误码，初始为0，表示正常
@@ -165,12 +502,14 @@ static int lept_parse_number(lept_context* c, lept_value* v) {
     // ERANGE 表示一个范围错误，它在输入参数超出数学函数定义的范围时发生，errno 被设置为 ERANGE。
     // HUGE_VAL 最大的双精度值 也就是inf-->无穷
     if (errno == ERANGE && (v->u.n == HUGE_VAL || v->u.n == -HUGE_VAL))
-        return LEPT_PARSE_NUMBER_TOO_BIG;
+        return NUMBER_ERROR(LEPT_PARSE_NUMBER_TOO_BIG);
     v->type = LEPT_NUMBER;
     c->json = p;
     return LEPT_PARSE_OK;
 }
 
+#undef NUMBER_ERROR
+
 // 解析 4 位 16 进制数字 Unicode码点值
 static const char* lept_parse_hex4(const char* p, unsigned* u) {
     int i;
@@ -187,6 +526,13 @@ static const char* lept_parse_hex4(const char* p, unsigned* u) {
     return p;
 }
 
+// lept_parse_hex4() 失败时，找出第一个不是16进制数字的字符
+static const char* lept_hex4_error(const char* p) {
+    while ((*p >= '0' && *p <= '9') || (*p >= 'A' && *p <= 'F') || (*p >= 'a' && *p <= 'f'))
+        p++;
+    return p;
+}
+
 // 将码点编码成utf8 按照码点范围可以拆分成1到至多4个字节
 # if 0
 码点范围        码点位数        字节1       字节2       字节3       字节4
@@ -215,8 +561,118 @@ static void lept_encode_utf8(lept_context* c, unsigned u) {
     }
 }
 
-#define STRING_ERROR(ret) do { c->top = head; return ret; } while(0)
-// 将返回错误码抽取为宏
+// 返回 s 中合法 UTF-8 前缀的长度，即第一个非法序列的起始位置（RFC 3629：拒绝过长编码、代理项和超过U+10FFFF的码点）
+static size_t lept_utf8_scalar(const unsigned char* s, size_t len) {
+    size_t i = 0, n, k;
+    uint64_t w;
+    unsigned b, lo, hi;
+    while (i < len) {
+        // 一次跳过8个ASCII字节
+        if (len - i >= 8) {
+            memcpy(&w, s + i, 8);
+            if ((w & 0x8080808080808080ULL) == 0) {
+                i += 8;
+                continue;
+            }
+        }
+        if ((b = s[i]) < 0x80) {
+            i++;
+            continue;
+        }
+        if (b < 0xC2 || b > 0xF4)
+            return i;
+        n = b < 0xE0 ? 1 : b < 0xF0 ? 2 : 3;
+        lo = b == 0xE0 ? 0xA0 : b == 0xF0 ? 0x90 : 0x80;
+        hi = b == 0xED ? 0x9F : b == 0xF4 ? 0x8F : 0xBF;
+        if (len - i <= n || s[i + 1] < lo || s[i + 1] > hi)
+            return i;
+        for (k = 2; k <= n; k++)
+            if ((s[i + k] & 0xC0) != 0x80)
+                return i;
+        i += n + 1;
+    }
+    return i;
+}
+
+#ifdef LEPT_SSSE3
+// 查表法（Keiser & Lemire, "Validating UTF-8 In Less Than One Instruction Per Byte"）：
+// 用前一字节的高低4位和当前字节的高4位各查一张表，三者相与后非0的位即为某类错误；
+// 第3、4字节是否应为后续字节另行判断。每次16字节，纯ASCII块只需检查上一块是否有未完结的序列
+__attribute__((target("ssse3")))
+static int lept_utf8_ssse3(const unsigned char* s, size_t len) {
+    // 位：1 序列过短  2 多余的后续字节  4 3字节过长编码  8 超过U+10FFFF  0x10 代理项  0x20 2字节过长编码
+    //     0x40 4字节过长编码/超过U+10FFFF  0x80 两个后续字节
+    const __m128i byte1_high = _mm_setr_epi8(
+        0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02,
+        (char)0x80, (char)0x80, (char)0x80, (char)0x80, 0x21, 0x01, 0x15, 0x49);
+    const __m128i byte1_low = _mm_setr_epi8(
+        (char)0xE7, (char)0xA3, (char)0x83, (char)0x83, (char)0x8B, (char)0xCB, (char)0xCB, (char)0xCB,
+        (char)0xCB, (char)0xCB, (char)0xCB, (char)0xCB, (char)0xCB, (char)0xDB, (char)0xCB, (char)0xCB);
+    const __m128i byte2_high = _mm_setr_epi8(
+        0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+        (char)0xE6, (char)0xAE, (char)0xBA, (char)0xBA, 0x01, 0x01, 0x01, 0x01);
+    // 最后3个字节若是多字节序列的首字节，序列延续到下一块
+    const __m128i max_value = _mm_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, (char)0xEF, (char)0xDF, (char)0xBF);
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    __m128i prev = _mm_setzero_si128(), incomplete = _mm_setzero_si128(), error = _mm_setzero_si128();
+    __m128i in, prev1, special, must23;
+    unsigned char tail[16];
+    size_t i = 0;
+    int last = 0;
+    while (!last) {
+        if (len - i >= 16)
+            in = _mm_loadu_si128((const __m128i*)(s + i));
+        else {
+            // 末尾不足16字节时补0，补的0也会暴露未完结的序列
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, s + i, len - i);
+            in = _mm_loadu_si128((const __m128i*)tail);
+            last = 1;
+        }
+        i += 16;
+        if (_mm_movemask_epi8(in) == 0) {
+            error = _mm_or_si128(error, incomplete);
+            incomplete = _mm_setzero_si128();
+        }
+        else {
+            prev1 = _mm_alignr_epi8(in, prev, 15);
+            special = _mm_and_si128(
+                _mm_and_si128(
+                    _mm_shuffle_epi8(byte1_high, _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+                    _mm_shuffle_epi8(byte1_low, _mm_and_si128(prev1, nibble))),
+                _mm_shuffle_epi8(byte2_high, _mm_and_si128(_mm_srli_epi16(in, 4), nibble)));
+            must23 = _mm_or_si128(
+                _mm_subs_epu8(_mm_alignr_epi8(in, prev, 14), _mm_set1_epi8(0x60)),
+                _mm_subs_epu8(_mm_alignr_epi8(in, prev, 13), _mm_set1_epi8(0x70)));
+            must23 = _mm_and_si128(must23, _mm_set1_epi8((char)0x80));
+            error = _mm_or_si128(error, _mm_xor_si128(must23, special));
+            incomplete = _mm_subs_epu8(in, max_value);
+        }
+        prev = in;
+    }
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) == 0xFFFF;
+}
+
+static int lept_has_ssse3(void) {
+    static int has = -1;
+    if (has < 0)
+        has = __builtin_cpu_supports("ssse3") ? 1 : 0;
+    return has;
+}
+#endif
+
+// 校验 UTF-8，返回合法前缀的长度；向量版本只回答是否合法，出错时再用标量版本定位
+static size_t lept_utf8_check(const char* s, size_t len) {
+#ifdef LEPT_SSSE3
+    if (len >= 16 && lept_has_ssse3() && lept_utf8_ssse3((const unsigned char*)s, len))
+        return len;
+#endif
+    return lept_utf8_scalar((const unsigned char*)s, len);
+}
+
+#define STRING_ERROR(ret, pos) do { c->top = head; c->json = (pos); return ret; } while(0)
+// 将返回错误码抽取为宏，pos为出错的位置
 
 #if 0
 JSON object语法
@@ -229,13 +685,19 @@ object = %x7B ws [ member *( ws %x2C ws member ) ] ws %x7D
 static int lept_parse_string_raw(lept_context* c, char** str, size_t* len) {
     size_t head = c->top;
     unsigned u, u2;
-    const char* p;
+    const char* p, *q;
     EXPECT(c, '\"');
     p = c->json;
     for (;;) {
         char ch = *p++;
         switch (ch) {
             case '\"':
+                // 转义序列都是ASCII，原文合法即结果合法
+                if (c->flags & LEPT_PARSE_VALIDATE_UTF8) {
+                    size_t n = lept_utf8_check(c->json, (size_t)(p - 1 - c->json));
+                    if (c->json + n != p - 1)
+                        STRING_ERROR(LEPT_PARSE_INVALID_UTF8, c->json + n);
+                }
                 *len = c->top - head;
                 *str = lept_context_pop(c, *len);
                 c->json = p;
@@ -251,30 +713,35 @@ static int lept_parse_string_raw(lept_context* c, char** str, size_t* len) {
                     case 'r':  PUTC(c, '\r'); break;
                     case 't':  PUTC(c, '\t'); break;
                     case 'u':
-                        if (!(p = lept_parse_hex4(p, &u)))
-                            STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_HEX);
+                        if (!(q = lept_parse_hex4(p, &u)))
+                            STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_HEX, lept_hex4_error(p));
+                        p = q;
                         if (u >= 0xD800 && u <= 0xDBFF) { /* surrogate pair */
                             if (*p++ != '\\')
-                                STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_SURROGATE);
+                                STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_SURROGATE, p - 1);
                             if (*p++ != 'u')
-                                STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_SURROGATE);
-                            if (!(p = lept_parse_hex4(p, &u2)))
-                                STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_HEX);
+                                STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_SURROGATE, p - 2);
+                            if (!(q = lept_parse_hex4(p, &u2)))
+                                STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_HEX, lept_hex4_error(p));
+                            p = q;
                             if (u2 < 0xDC00 || u2 > 0xDFFF)
-                                STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_SURROGATE);
+                                STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_SURROGATE, p - 4);
                             u = (((u - 0xD800) << 10) | (u2 - 0xDC00)) + 0x10000;
                         }
+                        // 严格模式下单独的低代理项也不能编码进字符串
+                        else if (u >= 0xDC00 && u <= 0xDFFF && (c->flags & LEPT_PARSE_VALIDATE_UTF8))
+                            STRING_ERROR(LEPT_PARSE_INVALID_UNICODE_SURROGATE, p - 6);
                         lept_encode_utf8(c, u);
                         break;
                     default:
-                        STRING_ERROR(LEPT_PARSE_INVALID_STRING_ESCAPE);
+                        STRING_ERROR(LEPT_PARSE_INVALID_STRING_ESCAPE, p - 1);
                 }
                 break;
             case '\0':
-                STRING_ERROR(LEPT_PARSE_MISS_QUOTATION_MARK);
+                STRING_ERROR(LEPT_PARSE_MISS_QUOTATION_MARK, p - 1);
             default:
                 if ((unsigned char)ch < 0x20)
-                    STRING_ERROR(LEPT_PARSE_INVALID_STRING_CHAR);
+                    STRING_ERROR(LEPT_PARSE_INVALID_STRING_CHAR, p - 1);
                 PUTC(c, ch);
         }
     }
@@ -290,6 +757,16 @@ static int lept_parse_string(lept_context* c, lept_value* v) {
     return ret;
 }
 
+// 开启统计时，对字符串和数字的解析分别计时，其余时间记为结构解析
+static int lept_parse_timed(lept_context* c, lept_value* v, int (*parse)(lept_context*, lept_value*), double* seconds) {
+    double t = lept_clock();
+    int ret = parse(c, v);
+    *seconds += lept_clock() - t;
+    return ret;
+}
+
+#if 0
+// 递归下降版本：每一层嵌套都会递归一次，恶意的深层嵌套会耗尽调用栈，已由下面的迭代版本代替
 // forward declare 因为lept_parse_value 和lept_parse_array两个有互相调用
 static int lept_parse_value(lept_context* c, lept_value* v);
 
@@ -370,8 +847,7 @@ static int lept_parse_object(lept_context* c, lept_value* v) {
         }
         if ((ret = lept_parse_string_raw(c, &str, &m.klen)) != LEPT_PARSE_OK) 
             break;
-        memcpy(m.k = (char*)malloc(m.klen + 1), str, m.klen);
-        m.k[m.klen] = '\0';
+        m.k = lept_key_new(str, m.klen);
         // 2. parse ws colon ws
         lept_parse_whitespace(c);
         if (*c->json != ':') {
@@ -406,10 +882,10 @@ static int lept_parse_object(lept_context* c, lept_value* v) {
         }
     }
     // pop and free members on the stack
-    free(m.k);
+    lept_key_free(m.k);
     for (i = 0; i < size; i++) {
         lept_member* m = (lept_member*)lept_context_pop(c, sizeof(lept_member));
-        free(m->k);
+        lept_key_free(m->k);
         lept_free(&m->v);
     }
     v->type = LEPT_NULL;
@@ -429,508 +905,4812 @@ static int lept_parse_value(lept_context* c, lept_value* v) {
         case '\0':  return LEPT_PARSE_EXPECT_VALUE;
     }
 }
+#else
 
-int lept_parse(lept_value* v, const char* json) {
-    lept_context c;
-    int ret;
-    assert(v != NULL);
-    c.json = json;
-    c.stack = NULL;
-    c.size = c.top = 0;
-    lept_init(v);
-    // 此处先将v设置为LEPT_NULL  让lept_parse_value()写入解析出来的根值
-    //v->type = LEPT_NULL; 使用了lept_init(v)
-    // 去除ws
-    lept_parse_whitespace(&c);
-    if((ret = lept_parse_value(&c, v)) == LEPT_PARSE_OK) {
-        // ws value ws 这个格式 前面ws value 已经解析完成，继续解析后面，看是否还有其他字符
-        lept_parse_whitespace(&c);
-        // 说明有其他字符-->不合法
-		if (*c.json != '\0') {
-			v->type = LEPT_NULL;
-			ret = LEPT_PARSE_ROOT_NOT_SINGULAR;
-		}          
-    }
-    assert(c.top == 0); // 加入断言确保所有数据都被弹出
-    free(c.stack);      // 释放stack空间
-    return ret;
-}
 #if 0
-// Unoptimized
-static void lept_stringify_string(lept_context* c, const char* s, size_t len) {
-    size_t i;
-    assert(s != NULL);
-    PUTC(c, '"');
-    for (i = 0; i < len; i++) {
-        unsigned char ch = (unsigned char)s[i];
-        switch (ch) {
-            case '\"': PUTS(c, "\\\"", 2); break;
-            case '\\': PUTS(c, "\\\\", 2); break;
-            case '\b': PUTS(c, "\\b",  2); break;
-            case '\f': PUTS(c, "\\f",  2); break;
-            case '\n': PUTS(c, "\\n",  2); break;
-            case '\r': PUTS(c, "\\r",  2); break;
-            case '\t': PUTS(c, "\\t",  2); break;
-            default:
-                if (ch < 0x20) {
-                    char buffer[7];
-                    sprintf(buffer, "\\u%04X", ch);
-                    PUTS(c, buffer, 6);
-                }
-                else
-                    PUTC(c, s[i]);
-        }
-    }
-    PUTC(c, '"');
+JSON Pointer (RFC 6901) 语法
+json-pointer    = *( "/" reference-token )
+reference-token = *( unescaped / escaped )
+escaped         = "~" ( "0" / "1" )     ~0 表示 '~'，~1 表示 '/'
+array-index     = %x30 / ( %x31-39 *%x30-39 )    "-" 表示数组末尾之后的位置
+#endif
+#define LEPT_POINTER_END ((size_t)-2)
+
+typedef struct {
+    const char* k;      // 反转义后的键，以'\0'结尾
+    size_t klen;
+    size_t index;       // 作为数组下标的值，不是合法下标时为 LEPT_KEY_NOT_EXIST，"-" 为 LEPT_POINTER_END
+} lept_pointer_token;
+
+// 编译好的指针，令牌数组和反转义后的键放在同一块内存中
+struct lept_pointer {
+    size_t n;
+    lept_pointer_token* t;
+};
+
+// 是否为整数，不依赖 floor()；绝对值不小于2^52的有限数都是整数
+static int lept_is_integer(double d) {
+    if (fabs(d) >= 4503599627370496.0)
+        return isfinite(d);
+    return (double)(int64_t)d == d;
 }
-#else
-static void lept_stringify_string(lept_context* c, const char* s, size_t len) {
-    // 这个函数主要是用来字符化lept_member.k或者LEPT_STRING
-    static const char hex_digits[] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F' };
-    size_t i, size;
-    char* head, *p;
-    assert(s != NULL);
-    p = head = lept_context_push(c, size = len * 6 + 2); /* "\u00xx..." */
-    *p++ = '"';
-    for (i = 0; i < len; i++) {
-        unsigned char ch = (unsigned char)s[i];
-        // 特殊字符需要转义存储
-        switch (ch) {
-            case '\"': *p++ = '\\'; *p++ = '\"'; break;
-            case '\\': *p++ = '\\'; *p++ = '\\'; break;
-            case '\b': *p++ = '\\'; *p++ = 'b';  break;
-            case '\f': *p++ = '\\'; *p++ = 'f';  break;
-            case '\n': *p++ = '\\'; *p++ = 'n';  break;
-            case '\r': *p++ = '\\'; *p++ = 'r';  break;
-            case '\t': *p++ = '\\'; *p++ = 't';  break;
-            default:
-            // 少于0x20的字符需要转义为\u00xx
-                if (ch < 0x20) {
-                    *p++ = '\\'; *p++ = 'u'; *p++ = '0'; *p++ = '0';
-                    *p++ = hex_digits[ch >> 4];
-                    *p++ = hex_digits[ch & 15];
-                }
-                else
-                    *p++ = s[i];
-        }
-    }
-    *p++ = '"';
-    c->top -= size - (p - head);
+
+#define LEPT_SCHEMA_NONE    ((size_t)-1)    // 没有约束，子树不必检查
+#define LEPT_SCHEMA_FALSE   ((size_t)-2)    // false 模式，不接受任何值
+#define LEPT_SCHEMA_INTEGER (1u << 7)       // types 中 "integer" 的位，其余为 1 << lept_type
+
+// 编译后的模式是一张扁平的结点表，子模式用下标引用
+enum {
+    LEPT_SCHEMA_MINIMUM     = 1 << 0,
+    LEPT_SCHEMA_MAXIMUM     = 1 << 1,
+    LEPT_SCHEMA_EXCL_MIN    = 1 << 2,       // minimum 为 exclusiveMinimum
+    LEPT_SCHEMA_EXCL_MAX    = 1 << 3,
+    LEPT_SCHEMA_ENUM        = 1 << 4        // 有 enum，空的 enum 不接受任何值
+};
+
+typedef struct {
+    unsigned types;         // 允许的类型，0 表示不限
+    unsigned checks;        // LEPT_SCHEMA_MINIMUM 等
+    double minimum, maximum;
+    size_t min_length, max_length;      // 字符串的码点个数
+    size_t min_items, max_items;        // 数组元素个数
+    size_t items;           // 数组元素的模式
+    size_t additional;      // 不在 properties 中的成员的模式，为 false 时多余的成员在校验该成员时被拒绝
+    size_t props, nprops;   // 属性表中的区间
+    size_t nrequired;       // 其中必需的个数
+    size_t enums, nenums;   // 枚举值表中的区间
+} lept_schema_node;
+
+typedef struct {
+    char* k;
+    size_t klen;
+    size_t node;            // 成员值的模式，只出现在 required 中的为 LEPT_SCHEMA_NONE
+    int required;
+} lept_schema_property;
+
+struct lept_schema {
+    size_t root;            // 根模式，true/false 模式没有对应的结点
+    lept_schema_node* nodes;
+    size_t nnodes, ncap;
+    lept_schema_property* props;
+    size_t nprops, pcap;
+    lept_value* enums;
+    size_t nenums, ecap;
+};
+
+static size_t lept_schema_find(const lept_schema* s, const lept_schema_node* n, const char* k, size_t klen) {
+    size_t i;
+    for (i = n->props; i < n->props + n->nprops; i++)
+        if (s->props[i].klen == klen && memcmp(s->props[i].k, k, klen) == 0)
+            return i;
+    return LEPT_KEY_NOT_EXIST;
 }
-#endif
 
-static void lept_stringify_value(lept_context* c, const lept_value* v) {
+// 数组元素（k为NULL）或对象中键为k的成员应满足的模式
+static size_t lept_schema_child(const lept_schema* s, size_t node, const char* k, size_t klen) {
+    const lept_schema_node* n;
     size_t i;
+    if (node == LEPT_SCHEMA_NONE || node == LEPT_SCHEMA_FALSE)
+        return node;
+    n = &s->nodes[node];
+    if (k == NULL)
+        return n->items;
+    if ((i = lept_schema_find(s, n, k, klen)) != LEPT_KEY_NOT_EXIST)
+        return s->props[i].node;
+    return n->additional;
+}
+
+// 只看类型，用于解析器在容器开始时尽早拒绝
+static int lept_schema_check_type(const lept_schema* s, size_t node, lept_type type) {
+    unsigned types;
+    if (node == LEPT_SCHEMA_NONE)
+        return 1;
+    if (node == LEPT_SCHEMA_FALSE)
+        return 0;
+    types = s->nodes[node].types;
+    if (types & (1u << LEPT_FALSE))
+        types |= 1u << LEPT_TRUE;
+    return types == 0 || (types & (1u << type)) != 0;
+}
+
+// 检查v本身是否满足模式，不检查子结点（子结点各自对应自己的模式）
+static int lept_schema_check(const lept_schema* s, size_t node, const lept_value* v) {
+    const lept_schema_node* n;
+    size_t i, len;
+    if (node == LEPT_SCHEMA_NONE)
+        return 1;
+    if (node == LEPT_SCHEMA_FALSE)
+        return 0;
+    n = &s->nodes[node];
+    if (n->types && !lept_schema_check_type(s, node, v->type)
+        && !(v->type == LEPT_NUMBER && (n->types & LEPT_SCHEMA_INTEGER) && lept_is_integer(v->u.n)))
+        return 0;
+    if (n->checks & LEPT_SCHEMA_ENUM) {
+        for (i = 0; i < n->nenums; i++)
+            if (lept_is_equal(&s->enums[n->enums + i], v))
+                break;
+        if (i == n->nenums)
+            return 0;
+    }
     switch (v->type) {
-        case LEPT_NULL:   PUTS(c, "null",  4); break;
-        case LEPT_FALSE:  PUTS(c, "false", 5); break;
-        case LEPT_TRUE:   PUTS(c, "true",  4); break;
-        case LEPT_NUMBER: c->top -= 32 - sprintf(lept_context_push(c, 32), "%.17g", v->u.n); break;
-        case LEPT_STRING: lept_stringify_string(c, v->u.s.s, v->u.s.len); break;
-        case LEPT_ARRAY:
-            PUTC(c, '[');
-            for (i = 0; i < v->u.a.size; i++) {
-                if (i > 0)
-                    PUTC(c, ',');
-                lept_stringify_value(c, &v->u.a.e[i]);
+        case LEPT_NUMBER:
+            if ((n->checks & LEPT_SCHEMA_MINIMUM) && (v->u.n < n->minimum || ((n->checks & LEPT_SCHEMA_EXCL_MIN) && v->u.n == n->minimum)))
+                return 0;
+            if ((n->checks & LEPT_SCHEMA_MAXIMUM) && (v->u.n > n->maximum || ((n->checks & LEPT_SCHEMA_EXCL_MAX) && v->u.n == n->maximum)))
+                return 0;
+            break;
+        case LEPT_STRING:
+            if (n->min_length > 0 || n->max_length != (size_t)-1) {
+                // 长度按码点计，即不是后续字节（10xxxxxx）的字节数
+                for (i = len = 0; i < v->u.s.len; i++)
+                    len += ((unsigned char)v->u.s.s[i] & 0xC0) != 0x80;
+                if (len < n->min_length || len > n->max_length)
+                    return 0;
             }
-            PUTC(c, ']');
+            break;
+        case LEPT_ARRAY:
+            if (v->u.a.size < n->min_items || v->u.a.size > n->max_items)
+                return 0;
             break;
         case LEPT_OBJECT:
-            PUTC(c, '{');
-            for (i = 0; i < v->u.o.size; i++) {
-                if (i > 0)
-                    PUTC(c, ',');
-                lept_stringify_string(c, v->u.o.m[i].k, v->u.o.m[i].klen);
-                PUTC(c, ':');
-                lept_stringify_value(c, &v->u.o.m[i].v);
-            }
-            PUTC(c, '}');
+            if (n->nrequired)
+                for (i = n->props; i < n->props + n->nprops; i++)
+                    if (s->props[i].required && lept_find_object_index(v, s->props[i].k, s->props[i].klen) == LEPT_KEY_NOT_EXIST)
+                        return 0;
             break;
-        default: assert(0 && "invalid type");
+        default: break;
     }
+    return 1;
 }
 
+#define LEPT_NO_FRAME ((size_t)-1)
 
-// 生成器
-char* lept_stringify(const lept_value* v, size_t* length) {
-    lept_context c;
-    assert(v != NULL);
-    c.stack = (char*)malloc(c.size = LEPT_PARSE_STRINGIFY_INIT_SIZE);
-    c.top = 0;
-    lept_stringify_value(&c, v);
-    if (length)
-        *length = c.top;
-    PUTC(&c, '\0');
-    return c.stack;
-}
+// 迭代解析时未完成的数组/对象，和它已解析的元素一起保存在 c->stack 中
+// 栈的布局为：帧 [投影下标] 元素0 元素1 ... 帧 ...，由于栈会扩容，帧之间用偏移而不用指针链接
+typedef struct {
+    size_t prev;        // 外层帧的偏移，LEPT_NO_FRAME 表示已是最外层
+    size_t size;        // 已压栈的元素（lept_value）或成员（lept_member）个数
+    char* k;            // 对象中正在等待值的键
+    size_t klen;
+    size_t nact;        // 帧后面紧跟的 c->proj 下标个数，即仍可能经过此容器的路径
+    int full;           // 投影时此容器已被某条路径完整选中，其下不再过滤
+    lept_type type;     // LEPT_ARRAY 或 LEPT_OBJECT
+    size_t schema;      // 此容器应满足的模式结点，LEPT_SCHEMA_NONE 表示不校验
+    const char* json;   // 容器的起始位置，校验失败时作为出错位置
+    const lept_member* shape;   // 对象的形状：预计与之键相同的已完成对象的成员，见 lept_frame_shape()
+    size_t nshape;
+} lept_frame;
 
+#define FRAME(c, off) ((lept_frame*)((c)->stack + (off)))
 
-void lept_copy(lept_value* dst, const lept_value* src) {
-    assert(src != NULL && dst != NULL && src != dst);
-	size_t i;
-    switch (src->type) {
-        case LEPT_STRING:
-            lept_set_string(dst, src->u.s.s, src->u.s.len);
-            break;
-        case LEPT_ARRAY:
-            // 先设置大小
-            lept_set_array(dst, src->u.a.size);
-            // 逐个拷贝
-            for (i = 0; i < src->u.a.size; i++)
-                lept_copy(&dst->u.a.e[i], &src->u.a.e[i]);
-            dst->u.a.size = src->u.a.size;
-            break;
-        case LEPT_OBJECT:
-            // 先设置大小
-            lept_set_object(dst, src->u.o.size);
-            // 逐个拷贝
-            for (i = 0; i < src->u.o.size; i++) {
-                // k
-                // 设置k字段为key的对象的值，如果在查找过程中找到了已经存在key，则返回；否则新申请一块空间并初始化，然后返回
-                lept_value* val = lept_set_object_value(dst, src->u.o.m[i].k, src->u.o.m[i].klen);
-                // v
-                lept_copy(val, &src->u.o.m[i].v);
-            } 
-            dst->u.o.size = src->u.o.size;
-            break;
+// 解析 null true false string number，容器由 lept_parse_value() 处理
+static int lept_parse_scalar(lept_context* c, lept_value* v) {
+    switch (*c->json) {
+        case 't':   return lept_parse_literal(c, v, "true", LEPT_TRUE);
+        case 'n':   return lept_parse_literal(c, v, "null", LEPT_NULL);
+        case 'f':   return lept_parse_literal(c, v, "false", LEPT_FALSE);
+        case '"':
+            if (c->stats)
+                return lept_parse_timed(c, v, lept_parse_string, &c->stats->string_seconds);
+            return lept_parse_string(c, v);
+        case '\0':  return LEPT_PARSE_EXPECT_VALUE;
         default:
-            lept_free(dst);
-            memcpy(dst, src, sizeof(lept_value));
-            break;
+            if (c->stats)
+                return lept_parse_timed(c, v, lept_parse_number, &c->stats->number_seconds);
+            return lept_parse_number(c, v);
     }
 }
 
-void lept_move(lept_value* dst, lept_value* src) {
-    assert(dst != NULL && src != NULL && src != dst);
-    lept_free(dst);
-    memcpy(dst, src, sizeof(lept_value));
-    // 其实也是把src指针置null
-    lept_init(src);
-}
-
-void lept_swap(lept_value* lhs, lept_value* rhs) {
-    assert(lhs != NULL && rhs != NULL);
-    if (lhs != rhs) {
-        lept_value temp;
-        memcpy(&temp, lhs, sizeof(lept_value));
-        memcpy(lhs,   rhs, sizeof(lept_value));
-        memcpy(rhs, &temp, sizeof(lept_value));
+// 解析对象成员的 key ws ':' ws，键拷贝后由帧暂时持有
+static int lept_parse_member_key(lept_context* c, size_t frame) {
+    lept_frame* f;
+    char* str;
+    size_t len;
+    int ret;
+    if (*c->json != '"')
+        return LEPT_PARSE_MISS_KEY;
+    if (c->stats) {
+        double t = lept_clock();
+        ret = lept_parse_string_raw(c, &str, &len);
+        c->stats->string_seconds += lept_clock() - t;
     }
+    else
+        ret = lept_parse_string_raw(c, &str, &len);
+    if (ret != LEPT_PARSE_OK)
+        return ret;
+    f = FRAME(c, frame);
+    // 键与形状中同一位置的键相同时直接共享，不再分配
+    if (f->size < f->nshape && f->shape[f->size].klen == len && memcmp(f->shape[f->size].k, str, len) == 0)
+        f->k = lept_key_retain(f->shape[f->size].k);
+    else
+        f->k = lept_key_new(str, len);
+    f->klen = len;
+    lept_parse_whitespace(c);
+    if (*c->json != ':')
+        return LEPT_PARSE_MISS_COLON;
+    c->json++;
+    lept_parse_whitespace(c);
+    return LEPT_PARSE_OK;
 }
 
-void lept_free(lept_value* v) {
-    size_t i;
-    assert(v != NULL);
-    switch (v->type) {
-        case LEPT_STRING:
-            free(v->u.s.s);
-            break;
-        case LEPT_ARRAY:
-            for (i = 0; i < v->u.a.size; i++)
-                lept_free(&v->u.a.e[i]);
-            free(v->u.a.e);
-            break;
-        case LEPT_OBJECT:
-            for (i = 0; i < v->u.o.size; i++) {
-                free(v->u.o.m[i].k);
-                lept_free(&v->u.o.m[i].v);
-            }
-            free(v->u.o.m);
-            break;
-        default: break;
-    }
-    v->type = LEPT_NULL;
-}
+enum { LEPT_PROJECT_SKIP, LEPT_PROJECT_PARTIAL, LEPT_PROJECT_FULL };
 
-lept_type lept_get_type(const lept_value* v) {
-    assert(v != NULL);
-    return v->type;
+// 投影：帧中下一个子值（对象为等待值的键，数组为下标size）是否是路径的第d个令牌
+static int lept_project_match(const lept_pointer* p, size_t d, const lept_frame* f) {
+    const lept_pointer_token* t = &p->t[d];
+    if (f->type == LEPT_OBJECT)
+        return t->klen == f->klen && memcmp(t->k, f->k, t->klen) == 0;
+    return t->index == f->size;
 }
 
-
-int lept_is_equal(const lept_value* lhs, const lept_value* rhs) {
-    size_t i;
-    assert(lhs != NULL && rhs != NULL);
-    if (lhs->type != rhs->type)
-        return 0;
-    switch (lhs->type) {
-        case LEPT_STRING:
-            return lhs->u.s.len == rhs->u.s.len && 
-                memcmp(lhs->u.s.s, rhs->u.s.s, lhs->u.s.len) == 0;
-        case LEPT_NUMBER:
-            return lhs->u.n == rhs->u.n;
-        case LEPT_ARRAY:
-            if (lhs->u.a.size != rhs->u.a.size)
-                return 0;
-            for (i = 0; i < lhs->u.a.size; i++)
-                if (!lept_is_equal(&lhs->u.a.e[i], &rhs->u.a.e[i]))
-                    return 0;
-            return 1;
-        case LEPT_OBJECT:
-            // 对于object 先比较键值个数是否一样
-            // 一样的话，对左边的键值对，依次在右边进行查找
-            if (lhs->u.o.size != rhs->u.o.size)
-                return 0;
-            // key-value comp
-            for (i = 0; i < lhs->u.o.size; i++) {
-                size_t index = lept_find_object_index(rhs, lhs->u.o.m[i].k, lhs->u.o.m[i].klen);
-                if (index == LEPT_KEY_NOT_EXIST)
-                    return 0;
-                if (!lept_is_equal(&lhs->u.o.m[i].v, &rhs->u.o.m[index].v))
-                    return 0;
-            }
-            return 1;
-        default:
-            return 1;
+// 投影：帧中下一个子值是跳过、完整解析，还是只保留其中的部分路径
+static int lept_project_mode(lept_context* c, size_t frame) {
+    const lept_frame* f;
+    const lept_pointer* p;
+    size_t i, d;
+    int mode = LEPT_PROJECT_SKIP;
+    if (c->nproj == 0)
+        return LEPT_PROJECT_FULL;
+    if (frame == LEPT_NO_FRAME) {
+        for (i = 0; i < c->nproj; i++)
+            if (c->proj[i]->n == 0)
+                return LEPT_PROJECT_FULL;
+        return LEPT_PROJECT_PARTIAL;
+    }
+    f = FRAME(c, frame);
+    if (f->full)
+        return LEPT_PROJECT_FULL;
+    d = c->depth - 1;
+    for (i = 0; i < f->nact; i++) {
+        p = c->proj[((const size_t*)(f + 1))[i]];
+        if (lept_project_match(p, d, f)) {
+            if (p->n == d + 1)
+                return LEPT_PROJECT_FULL;
+            mode = LEPT_PROJECT_PARTIAL;
+        }
     }
+    return mode;
 }
 
-int lept_get_boolean(const lept_value* v) {
-    assert(v != NULL && (v->type == LEPT_TRUE || v->type == LEPT_FALSE));
-    return v->type == LEPT_TRUE;
+// 投影：在刚压入的帧后面压入仍然匹配的路径下标
+static void lept_project_push(lept_context* c, size_t frame, size_t parent) {
+    size_t i, n = 0, nact = parent == LEPT_NO_FRAME ? c->nproj : FRAME(c, parent)->nact;
+    for (i = 0; i < nact; i++) {
+        size_t index = i;
+        if (parent != LEPT_NO_FRAME) {
+            index = ((const size_t*)(FRAME(c, parent) + 1))[i];
+            if (!lept_project_match(c->proj[index], c->depth - 1, FRAME(c, parent)))
+                continue;
+        }
+        *(size_t*)lept_context_push(c, sizeof(size_t)) = index;
+        n++;
+    }
+    FRAME(c, frame)->nact = n;
 }
 
-void lept_set_boolean(lept_value* v, int b) {
-    lept_free(v);
-    v->type = b ? LEPT_TRUE : LEPT_FALSE;
+// 投影：跳过不需要的值，只配对括号和引号，不建结点、不反转义、不转换数字
+static int lept_project_skip(lept_context* c) {
+    const char* p = c->json;
+    size_t depth = 0;
+    do {
+        if (*p == '"') {
+            for (p++; *p != '"'; p++) {
+                if (*p == '\0') {
+                    c->json = p;
+                    return LEPT_PARSE_MISS_QUOTATION_MARK;
+                }
+                if (*p == '\\' && p[1] != '\0')
+                    p++;
+            }
+            p++;
+        }
+        else if (*p == '[' || *p == '{') {
+            depth++;
+            p++;
+        }
+        else if (*p == '\0') {
+            const char* head = c->json;
+            c->json = p;
+            if (depth == 0)
+                return LEPT_PARSE_EXPECT_VALUE;
+            return *head == '[' ? LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET : LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+        }
+        else if (depth > 0) {
+            if (*p == ']' || *p == '}')
+                depth--;
+            p++;
+        }
+        else {
+            const char* q = p;
+            while (*p != '\0' && strchr(" \t\r\n,]}", *p) == NULL)
+                p++;
+            if (p == q) {
+                c->json = p;
+                return LEPT_PARSE_INVALID_VALUE;
+            }
+        }
+    } while (depth > 0);
+    c->json = p;
+    return LEPT_PARSE_OK;
 }
 
-// 只有当type为LEPT_NUMBER时才可以取获得数值
-double lept_get_number(const lept_value* v) {
-    assert(v != NULL && v->type == LEPT_NUMBER);
-    return v->u.n;
+// 形状：记录数组中相邻的对象、以及它们对应位置上的子对象，键往往完全相同
+// 新对象以数组中前一个对象（或父对象形状中同一个键的值）作为预测，解析键时逐个核对
+static void lept_frame_shape(lept_context* c, size_t frame, lept_frame* nf) {
+    const lept_frame* f;
+    const lept_value* prev = NULL;
+    nf->shape = NULL;
+    nf->nshape = 0;
+    if (nf->type != LEPT_OBJECT || frame == LEPT_NO_FRAME)
+        return;
+    f = FRAME(c, frame);
+    if (f->type == LEPT_ARRAY) {
+        // 数组帧是最内层的帧，它的最后一个元素就在栈顶
+        if (f->size > 0)
+            prev = (const lept_value*)(c->stack + c->top) - 1;
+    }
+    else if (f->size < f->nshape && f->shape[f->size].k == f->k)
+        prev = &f->shape[f->size].v;
+    if (prev != NULL && prev->type == LEPT_OBJECT) {
+        nf->shape = prev->u.o.m;
+        nf->nshape = prev->u.o.size;
+    }
 }
 
-void lept_set_number(lept_value* v, double n) {
-    lept_free(v);
-    v->u.n = n;
-    v->type = LEPT_NUMBER;
-}
+// 解析值，数组和对象不再递归，而是把未完成的容器作为帧压在 c->stack 上
+static int lept_parse_value(lept_context* c, lept_value* v) {
+    size_t frame = LEPT_NO_FRAME, i, size, node;
+    lept_frame* f;
+    lept_value e;
+    const char* start;
+    int ret, mode, skip;
+    for (;;) {
+        // 1. 解析一个完整的值至e；遇到非空容器则压入新帧，回到循环开头解析它的第一个元素
+        lept_init(&e);
+        skip = 0;
+        start = c->json;
+        if (frame == LEPT_NO_FRAME)
+            node = c->schema ? c->schema->root : LEPT_SCHEMA_NONE;
+        else {
+            f = FRAME(c, frame);
+            node = lept_schema_child(c->schema, f->schema, f->type == LEPT_OBJECT ? f->k : NULL, f->klen);
+        }
+        mode = lept_project_mode(c, frame);
+        if (mode == LEPT_PROJECT_SKIP || (mode == LEPT_PROJECT_PARTIAL && *c->json != '[' && *c->json != '{')) {
+            // 投影时不需要的值：数组中以null占位以保持下标，对象中丢弃该成员
+            if ((ret = lept_project_skip(c)) != LEPT_PARSE_OK)
+                goto error;
+            skip = 1;
+        }
+        else if (*c->json == '[' || *c->json == '{') {
+            lept_frame nf;
+            nf.type = *c->json == '[' ? LEPT_ARRAY : LEPT_OBJECT;
+            if (c->depth >= c->max_depth) {
+                ret = LEPT_PARSE_NESTING_TOO_DEEP;
+                goto error;
+            }
+            // 类型不符的容器在开始处就拒绝，不必解析其中的元素
+            if (!lept_schema_check_type(c->schema, node, nf.type)) {
+                ret = LEPT_PARSE_SCHEMA_MISMATCH;
+                goto error;
+            }
+            if (c->stats && c->depth + 1 > c->stats->max_depth)
+                c->stats->max_depth = c->depth + 1;
+            c->json++;
+            lept_parse_whitespace(c);
+            if (*c->json == (nf.type == LEPT_ARRAY ? ']' : '}')) {
+                c->json++;
+                if (nf.type == LEPT_ARRAY)
+                    lept_set_array(&e, 0);
+                else
+                    lept_set_object(&e, 0);
+            }
+            else {
+                nf.prev = frame;
+                nf.size = 0;
+                nf.k = NULL;
+                nf.nact = 0;
+                nf.full = mode == LEPT_PROJECT_FULL;
+                nf.schema = node;
+                nf.json = start;
+                lept_frame_shape(c, frame, &nf);
+                frame = c->top;
+                memcpy(lept_context_push(c, sizeof(lept_frame)), &nf, sizeof(lept_frame));
+                if (!nf.full)
+                    lept_project_push(c, frame, nf.prev);
+                c->depth++;
+                if (nf.type == LEPT_OBJECT && (ret = lept_parse_member_key(c, frame)) != LEPT_PARSE_OK)
+                    goto error;
+                continue;
+            }
+        }
+        else if ((ret = lept_parse_scalar(c, &e)) != LEPT_PARSE_OK)
+            goto error;
+        if (!skip && !lept_schema_check(c->schema, node, &e)) {
+            lept_free(&e);
+            c->json = start;
+            ret = LEPT_PARSE_SCHEMA_MISMATCH;
+            goto error;
+        }
 
-const char* lept_get_string(const lept_value* v) {
-    assert(v != NULL && v->type == LEPT_STRING);
-    return v->u.s.s;
+        // 2. 把e交给当前帧，若随后容器结束，则e成为刚完成的容器，继续交给外层帧
+        for (;;) {
+            if (c->stats && !skip)
+                c->stats->nodes[e.type]++;
+            if (frame == LEPT_NO_FRAME) {
+                memcpy(v, &e, sizeof(lept_value));
+                return LEPT_PARSE_OK;
+            }
+            if (FRAME(c, frame)->type == LEPT_ARRAY) {
+                memcpy(lept_context_push(c, sizeof(lept_value)), &e, sizeof(lept_value));
+                FRAME(c, frame)->size++;
+            }
+            else if (skip) {
+                f = FRAME(c, frame);
+                lept_key_free(f->k);
+                f->k = NULL;
+            }
+            else {
+                lept_member* m = (lept_member*)lept_context_push(c, sizeof(lept_member));
+                f = FRAME(c, frame);
+                m->k = f->k;     // 键的所有权转移至栈上的成员
+                m->klen = f->klen;
+                f->k = NULL;
+                memcpy(&m->v, &e, sizeof(lept_value));
+                f->size++;
+            }
+            f = FRAME(c, frame);
+            lept_parse_whitespace(c);
+            if (*c->json == ',') {
+                c->json++;
+                lept_parse_whitespace(c);
+                if (f->type == LEPT_OBJECT && (ret = lept_parse_member_key(c, frame)) != LEPT_PARSE_OK)
+                    goto error;
+                break;
+            }
+            if (*c->json != (f->type == LEPT_ARRAY ? ']' : '}')) {
+                ret = f->type == LEPT_ARRAY ? LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET : LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+                goto error;
+            }
+            c->json++;
+            size = f->size;
+            lept_init(&e);  // e已转移至栈中
+            if (f->type == LEPT_ARRAY) {
+                lept_set_array(&e, size);
+                memcpy(e.u.a.e, lept_context_pop(c, size * sizeof(lept_value)), size * sizeof(lept_value));
+                e.u.a.size = size;
+            }
+            else {
+                lept_set_object(&e, size);
+                if (size > 0)   // 投影时成员可能全部被丢弃
+                    memcpy(e.u.o.m, lept_context_pop(c, size * sizeof(lept_member)), size * sizeof(lept_member));
+                e.u.o.size = size;
+            }
+            lept_context_pop(c, f->nact * sizeof(size_t));
+            f = (lept_frame*)lept_context_pop(c, sizeof(lept_frame));
+            frame = f->prev;
+            c->depth--;
+            skip = 0;
+            // 元素已各自校验过，这里只检查容器本身的约束（元素个数、required 等）
+            if (!lept_schema_check(c->schema, f->schema, &e)) {
+                lept_free(&e);
+                c->json = f->json;
+                ret = LEPT_PARSE_SCHEMA_MISMATCH;
+                goto error;
+            }
+        }
+    }
+error:
+    // 由内向外弹出所有帧，释放已解析的元素、成员和未配对的键
+    while (frame != LEPT_NO_FRAME) {
+        f = FRAME(c, frame);
+        for (i = 0; i < f->size; i++) {
+            if (f->type == LEPT_ARRAY)
+                lept_free((lept_value*)lept_context_pop(c, sizeof(lept_value)));
+            else {
+                lept_member* m = (lept_member*)lept_context_pop(c, sizeof(lept_member));
+                lept_key_free(m->k);
+                lept_free(&m->v);
+            }
+        }
+        lept_key_free(f->k);
+        lept_context_pop(c, f->nact * sizeof(size_t));
+        frame = ((lept_frame*)lept_context_pop(c, sizeof(lept_frame)))->prev;
+        c->depth--;
+    }
+    return ret;
 }
+#endif
 
-size_t lept_get_string_length(const lept_value* v) {
-    assert(v != NULL && v->type == LEPT_STRING);
-    return v->u.s.len;
+void lept_stats_reset(lept_stats* s) {
+    assert(s != NULL);
+    memset(s, 0, sizeof(lept_stats));
 }
 
-void lept_set_string(lept_value* v, const char* s, size_t len) {
-    assert(v != NULL && (s != NULL || len == 0));
-    // 先释放之前的v，避免以前的v没有释放造成影响
-    lept_free(v);
-    v->u.s.s = (char*)malloc(len + 1);
-    memcpy(v->u.s.s, s, len);
-    v->u.s.s[len] = '\0';
-    v->u.s.len = len;
-    v->type = LEPT_STRING;
+lept_stats* lept_set_thread_stats(lept_stats* s) {
+    lept_stats* old = lept_thread_stats;
+    lept_thread_stats = s;
+    return old;
 }
 
-void lept_set_array(lept_value* v, size_t capacity) {
-    assert(v != NULL);
-    lept_free(v);
-    v->type = LEPT_ARRAY;
-    v->u.a.size = 0;
-    v->u.a.capacity = capacity;
-    v->u.a.e = capacity > 0 ? (lept_value*)malloc(capacity * sizeof(lept_value)) : NULL;
+lept_key_pool* lept_key_pool_new(void) {
+    lept_key_pool* p = (lept_key_pool*)malloc(sizeof(lept_key_pool));
+    p->mask = 63;
+    p->size = 0;
+    p->slot = (lept_key_slot*)calloc(p->mask + 1, sizeof(lept_key_slot));
+    return p;
 }
 
-size_t lept_get_array_size(const lept_value* v) {
-    assert(v != NULL && v->type == LEPT_ARRAY);
-    return v->u.a.size;
+void lept_key_pool_free(lept_key_pool* p) {
+    size_t i;
+    if (p == NULL)
+        return;
+    if (lept_thread_key_pool == p)
+        lept_thread_key_pool = NULL;
+    // 只放弃池持有的引用，文档中仍在使用的键由最后一个成员释放
+    for (i = 0; i <= p->mask; i++)
+        lept_key_free(p->slot[i].k);
+    free(p->slot);
+    free(p);
 }
 
-size_t lept_get_array_capacity(const lept_value* v) {
-    assert(v != NULL && v->type == LEPT_ARRAY);
-    return v->u.a.capacity;
+lept_key_pool* lept_set_thread_key_pool(lept_key_pool* p) {
+    lept_key_pool* old = lept_thread_key_pool;
+    lept_thread_key_pool = p;
+    return old;
 }
 
-void lept_reserve_array(lept_value* v, size_t capacity) {
-    assert(v != NULL && v->type == LEPT_ARRAY);
-    if (v->u.a.capacity < capacity) {
-        v->u.a.capacity = capacity;
-        v->u.a.e = (lept_value*)realloc(v->u.a.e, capacity * sizeof(lept_value));
+const char* lept_key_pool_get(lept_key_pool* p, const char* key, size_t klen) {
+    char* k;
+    assert(p != NULL && (key != NULL || klen == 0));
+    // 只有池持有引用，调用者得到的引用立即放回；键太长或池已满时没有收录，引用数为1
+    k = lept_key_pool_intern(p, key, klen);
+    if (LEPT_REF_GET(LEPT_KEY_REFS(k)) == 1) {
+        lept_key_free(k);
+        return NULL;
     }
+    lept_key_free(k);
+    return k;
 }
 
-void lept_shrink_array(lept_value* v) {
-	assert(v != NULL && v->type == LEPT_ARRAY);
-	if (v->u.a.capacity > v->u.a.size) {
-		v->u.a.capacity = v->u.a.size;
-		v->u.a.e = (lept_value*)realloc(v->u.a.e, v->u.a.capacity * sizeof(lept_value));
-	}
+int lept_parse(lept_value* v, const char* json) {
+    return lept_parse_ex(v, json, NULL).code;
 }
-void lept_clear_array(lept_value* v) {
-    assert(v != NULL && v->type == LEPT_ARRAY);
-    lept_erase_array_element(v, 0, v->u.a.size);
+
+int lept_parse_opt(lept_value* v, const char* json, const lept_parse_options* opt) {
+    return lept_parse_ex(v, json, opt).code;
 }
 
-lept_value* lept_get_array_element(lept_value* v, size_t index) {
-    assert(v != NULL && v->type == LEPT_ARRAY);
-    assert(index < v->u.a.size);
-    return &v->u.a.e[index];
+int lept_parse_projected(lept_value* v, const char* json, const lept_pointer* const* paths, size_t n) {
+    lept_parse_options opt;
+    memset(&opt, 0, sizeof(opt));
+    opt.paths = paths;
+    opt.npaths = n;
+    return lept_parse_ex(v, json, &opt).code;
 }
 
-lept_value* lept_pushback_array_element(lept_value* v) {
-    assert(v != NULL && v->type == LEPT_ARRAY);
-    if (v->u.a.size == v->u.a.capacity)
-        lept_reserve_array(v, v->u.a.capacity == 0 ? 1 : v->u.a.capacity * 2);
-    lept_init(&v->u.a.e[v->u.a.size]);
-    return &v->u.a.e[v->u.a.size++];
+lept_parse_result lept_parse_ex(lept_value* v, const char* json, const lept_parse_options* opt) {
+    lept_parse_result result;
+    lept_context c;
+    int ret;
+    double t = 0.0, ts = 0.0, tn = 0.0;
+    assert(v != NULL);
+    c.json = json;
+    c.stack = NULL;
+    c.size = c.top = 0;
+    c.depth = 0;
+    c.max_depth = opt && opt->max_depth ? opt->max_depth : LEPT_PARSE_MAX_DEPTH;
+    c.proj = opt ? opt->paths : NULL;
+    c.nproj = opt && opt->paths ? opt->npaths : 0;
+    c.flags = opt ? opt->flags : 0;
+    c.schema = opt ? opt->schema : NULL;
+    // 单次调用指定的统计优先于线程统计
+    c.stats = opt && opt->stats ? opt->stats : lept_thread_stats;
+    if (c.stats) {
+        t = lept_clock();
+        ts = c.stats->string_seconds;
+        tn = c.stats->number_seconds;
+    }
+    lept_init(v);
+    // 此处先将v设置为LEPT_NULL  让lept_parse_value()写入解析出来的根值
+    //v->type = LEPT_NULL; 使用了lept_init(v)
+    // 去除ws
+    lept_parse_whitespace(&c);
+    // 投影跳过或丢弃的值模式看不到，required 等也无从检查，两者不能同时使用
+    if (c.schema != NULL && c.nproj > 0)
+        ret = LEPT_PARSE_INVALID_OPTIONS;
+    else if((ret = lept_parse_value(&c, v)) == LEPT_PARSE_OK) {
+        // ws value ws 这个格式 前面ws value 已经解析完成，继续解析后面，看是否还有其他字符
+        lept_parse_whitespace(&c);
+        // 说明有其他字符-->不合法
+		if (*c.json != '\0') {
+			lept_free(v);
+			ret = LEPT_PARSE_ROOT_NOT_SINGULAR;
+		}          
+    }
+    if (c.stats) {
+        c.stats->parse_bytes += c.json - json;
+        c.stats->structure_seconds += (lept_clock() - t)
+            - (c.stats->string_seconds - ts) - (c.stats->number_seconds - tn);
+    }
+    assert(c.top == 0); // 加入断言确保所有数据都被弹出
+    free(c.stack);      // 释放stack空间
+    // 出错时c.json停在出错的字节，成功时停在文本末尾；行列号留给 lept_get_error_position() 按需计算
+    result.code = ret;
+    result.offset = (size_t)(c.json - json);
+    return result;
 }
 
-void lept_popback_array_element(lept_value* v) {
-    assert(v != NULL && v->type == LEPT_ARRAY && v->u.a.size > 0);
-    lept_free(&v->u.a.e[--v->u.a.size]);
+void lept_get_error_position(const char* json, size_t offset, size_t* line, size_t* column) {
+    const char* p, *head = json, *end = json + offset;
+    size_t n = 1;
+    assert(json != NULL && line != NULL && column != NULL);
+    // 超出文本的偏移按文本末尾计算，不越过结尾的'\0'
+    for (p = json; p != end && *p != '\0'; p++)
+        if (*p == '\n') {
+            n++;
+            head = p + 1;
+        }
+    *line = n;
+    *column = (size_t)(p - head) + 1;
 }
 
-// index不可以超过size，因为是插入，等于size的话就是相当于插在末尾
-lept_value* lept_insert_array_element(lept_value* v, size_t index) {
-    assert(v != NULL && v->type == LEPT_ARRAY && index <= v->u.a.size);
-    if (v->u.a.size == v->u.a.capacity)
-		lept_reserve_array(v, v->u.a.capacity == 0 ? 1 : (v->u.a.size << 1)); //扩容为原来一倍
-	memcpy(&v->u.a.e[index + 1], &v->u.a.e[index], (v->u.a.size - index) * sizeof(lept_value));
-	lept_init(&v->u.a.e[index]);
-	v->u.a.size++;
-	return &v->u.a.e[index];
+// 只校验不建树：沿用 lept_parse_value() 的语法，但不分配结点、不反转义字符串、不转换数字
+// 输入以长度界定，不要求以'\0'结尾；出错时 *pp 指向出错的字节
+static const char* lept_validate_whitespace(const char* p, const char* end) {
+    while (p != end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+        p++;
+    return p;
 }
 
-void lept_erase_array_element(lept_value* v, size_t index, size_t count) {
-    assert(v != NULL && v->type == LEPT_ARRAY && index + count <= v->u.a.size);
-    /* \todo */
-    size_t i;
-	for (i = index; i < index + count; i++) {
-		lept_free(&v->u.a.e[i]);
-	}
-	memcpy(v->u.a.e + index, v->u.a.e + index + count, (v->u.a.size - index - count) * sizeof(lept_value));
-	for (i = v->u.a.size - count; i < v->u.a.size; i++)
-		lept_init(&v->u.a.e[i]);
-	v->u.a.size -= count;
+static int lept_validate_literal(const char** pp, const char* end, const char* literal) {
+    const char* p = *pp;
+    for (; *literal; p++, literal++)
+        if (p == end || *p != *literal) {
+            *pp = p;
+            return LEPT_PARSE_INVALID_VALUE;
+        }
+    *pp = p;
+    return LEPT_PARSE_OK;
 }
 
-void lept_set_object(lept_value* v, size_t capacity) {
-    assert(v != NULL);
+static int lept_validate_hex4(const char** pp, const char* end, unsigned* u) {
+    const char* p = *pp;
+    int i;
+    *u = 0;
+    for (i = 0; i < 4; i++, p++) {
+        char ch = p != end ? *p : '\0';
+        *u <<= 4;
+        if      (ch >= '0' && ch <= '9')    *u |= ch - '0';
+        else if (ch >= 'A' && ch <= 'F')    *u |= ch - ('A' - 10);
+        else if (ch >= 'a' && ch <= 'f')    *u |= ch - ('a' - 10);
+        else {
+            *pp = p;
+            return LEPT_PARSE_INVALID_UNICODE_HEX;
+        }
+    }
+    *pp = p;
+    return LEPT_PARSE_OK;
+}
+
+static int lept_validate_string(const char** pp, const char* end) {
+    const char* p = *pp + 1;
+    unsigned u;
+    int ret;
+    for (;;) {
+        if (p == end) {
+            *pp = p;
+            return LEPT_PARSE_MISS_QUOTATION_MARK;
+        }
+        switch (*p) {
+            case '\"':
+                *pp = p + 1;
+                return LEPT_PARSE_OK;
+            case '\\':
+                if (++p == end) {
+                    *pp = p;
+                    return LEPT_PARSE_INVALID_STRING_ESCAPE;
+                }
+                switch (*p++) {
+                    case '\"': case '\\': case '/': case 'b':
+                    case 'f':  case 'n':  case 'r': case 't':
+                        break;
+                    case 'u':
+                        if ((ret = lept_validate_hex4(&p, end, &u)) != LEPT_PARSE_OK) {
+                            *pp = p;
+                            return ret;
+                        }
+                        if (u >= 0xD800 && u <= 0xDBFF) { /* surrogate pair */
+                            if (end - p < 2 || p[0] != '\\' || p[1] != 'u') {
+                                *pp = p;
+                                return LEPT_PARSE_INVALID_UNICODE_SURROGATE;
+                            }
+                            p += 2;
+                            if ((ret = lept_validate_hex4(&p, end, &u)) != LEPT_PARSE_OK) {
+                                *pp = p;
+                                return ret;
+                            }
+                            if (u < 0xDC00 || u > 0xDFFF) {
+                                *pp = p - 4;
+                                return LEPT_PARSE_INVALID_UNICODE_SURROGATE;
+                            }
+                        }
+                        break;
+                    default:
+                        *pp = p - 1;
+                        return LEPT_PARSE_INVALID_STRING_ESCAPE;
+                }
+                break;
+            default:
+                if ((unsigned char)*p < 0x20) {
+                    *pp = p;
+                    return LEPT_PARSE_INVALID_STRING_CHAR;
+                }
+                p++;
+        }
+    }
+}
+
+// DBL_MAX 与下一个可表示值（2^1024）的中点 2^1024 - 2^970 的全部有效数字；
+// strtod 按就近舍入（平局取偶），不小于它的数都舍入为无穷大
+static const char lept_dbl_overflow_digits[] =
+    "179769313486231580793728971405303415079934132710037826936173778980444968"
+    "292764750946649017977587207096330286416692887910946555547851940402630657"
+    "488671505820681908902000708383676273854845817711531764475730270069855571"
+    "366959622842914819860834936475292719074168444365510704342711559699508093"
+    "042880177904174497792";
+
+// 数量级为 10^308 的数字：逐位与溢出边界比较有效数字，结果与 strtod 一致，不受数字长度限制
+static int lept_validate_number_huge(const char* p, const char* end) {
+    const char* d = lept_dbl_overflow_digits;
+    if (*p == '-')
+        p++;
+    for (; p != end && *p != 'e' && *p != 'E'; p++) {
+        if (*p == '.' || (*p == '0' && d == lept_dbl_overflow_digits))
+            continue;
+        if (*p != *d)
+            return *p > *d ? LEPT_PARSE_NUMBER_TOO_BIG : LEPT_PARSE_OK;
+        if (*++d == '\0')
+            return LEPT_PARSE_NUMBER_TOO_BIG;
+    }
+    return LEPT_PARSE_OK;
+}
+
+// 数字只检查语法，并由位数和指数估计数量级；数量级为 10^308 时逐位比较有效数字
+static int lept_validate_number(const char** pp, const char* end) {
+    const char* p = *pp, *head = *pp;
+    long e10 = 0, exp = 0;
+    int nonzero = 0, neg = 0;
+#define CH (p != end ? *p : '\0')
+    if (CH == '-') p++;
+    if (CH == '0') p++;
+    else {
+        if (!ISDIGIT1TO9(CH)) {
+            *pp = p;
+            return LEPT_PARSE_INVALID_VALUE;
+        }
+        nonzero = 1;
+        for (p++; ISDIGIT(CH); p++)
+            e10++;
+    }
+    if (CH == '.') {
+        p++;
+        if (!ISDIGIT(CH)) {
+            *pp = p;
+            return LEPT_PARSE_INVALID_VALUE;
+        }
+        for (; ISDIGIT(CH); p++)
+            if (!nonzero) {
+                if (*p != '0')
+                    nonzero = 1;
+                e10--;
+            }
+    }
+    if (CH == 'e' || CH == 'E') {
+        p++;
+        if (CH == '+' || CH == '-')
+            neg = *p++ == '-';
+        if (!ISDIGIT(CH)) {
+            *pp = p;
+            return LEPT_PARSE_INVALID_VALUE;
+        }
+        for (; ISDIGIT(CH); p++)
+            if (exp < 100000)
+                exp = exp * 10 + (*p - '0');
+        e10 += neg ? -exp : exp;
+    }
+#undef CH
+    *pp = p;
+    if (nonzero && e10 >= 308) {
+        if (e10 > 308)
+            return LEPT_PARSE_NUMBER_TOO_BIG;
+        return lept_validate_number_huge(head, p);
+    }
+    return LEPT_PARSE_OK;
+}
+
+// 解析对象成员的 key ws ':' ws
+static int lept_validate_member_key(const char** pp, const char* end) {
+    int ret;
+    if (*pp == end || **pp != '"')
+        return LEPT_PARSE_MISS_KEY;
+    if ((ret = lept_validate_string(pp, end)) != LEPT_PARSE_OK)
+        return ret;
+    *pp = lept_validate_whitespace(*pp, end);
+    if (*pp == end || **pp != ':')
+        return LEPT_PARSE_MISS_COLON;
+    *pp = lept_validate_whitespace(*pp + 1, end);
+    return LEPT_PARSE_OK;
+}
+
+int lept_validate(const char* json, size_t len, lept_error* err) {
+    // 每层嵌套用一个位记录是对象(1)还是数组(0)，不需要 lept_context 的堆栈
+    unsigned char nest[(LEPT_PARSE_MAX_DEPTH + 7) / 8];
+    const char* p, *end;
+    size_t depth = 0;
+    int ret, object;
+    assert(json != NULL || len == 0);
+    p = lept_validate_whitespace(json, end = json + len);
+    for (;;) {
+        // 1. 校验一个值，遇到非空容器则记录它的类型并继续校验第一个元素
+        if (p == end) {
+            ret = LEPT_PARSE_EXPECT_VALUE;
+            goto done;
+        }
+        switch (*p) {
+            case '[':
+            case '{':
+                if (depth >= LEPT_PARSE_MAX_DEPTH) {
+                    ret = LEPT_PARSE_NESTING_TOO_DEEP;
+                    goto done;
+                }
+                object = *p == '{';
+                p = lept_validate_whitespace(p + 1, end);
+                if (p != end && *p == (object ? '}' : ']')) {
+                    p++;
+                    ret = LEPT_PARSE_OK;
+                    break;
+                }
+                if (object)
+                    nest[depth >> 3] |= (unsigned char)(1u << (depth & 7));
+                else
+                    nest[depth >> 3] &= (unsigned char)~(1u << (depth & 7));
+                depth++;
+                if (object && (ret = lept_validate_member_key(&p, end)) != LEPT_PARSE_OK)
+                    goto done;
+                continue;
+            case '"': ret = lept_validate_string(&p, end); break;
+            case 't': ret = lept_validate_literal(&p, end, "true"); break;
+            case 'f': ret = lept_validate_literal(&p, end, "false"); break;
+            case 'n': ret = lept_validate_literal(&p, end, "null"); break;
+            default:  ret = lept_validate_number(&p, end); break;
+        }
+        if (ret != LEPT_PARSE_OK)
+            goto done;
+        // 2. 一个值结束后，处理外层容器的逗号或结束符
+        for (;;) {
+            p = lept_validate_whitespace(p, end);
+            if (depth == 0) {
+                ret = p == end ? LEPT_PARSE_OK : LEPT_PARSE_ROOT_NOT_SINGULAR;
+                goto done;
+            }
+            object = (nest[(depth - 1) >> 3] >> ((depth - 1) & 7)) & 1;
+            if (p != end && *p == ',') {
+                p = lept_validate_whitespace(p + 1, end);
+                if (object && (ret = lept_validate_member_key(&p, end)) != LEPT_PARSE_OK)
+                    goto done;
+                break;
+            }
+            if (p == end || *p != (object ? '}' : ']')) {
+                ret = object ? LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET : LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+                goto done;
+            }
+            p++;
+            depth--;
+        }
+    }
+done:
+    if (err) {
+        err->code = ret;
+        err->offset = (size_t)(p - json);
+    }
+    return ret;
+}
+
+#if 0
+// Unoptimized
+static void lept_stringify_string(lept_context* c, const char* s, size_t len) {
+    size_t i;
+    assert(s != NULL);
+    PUTC(c, '"');
+    for (i = 0; i < len; i++) {
+        unsigned char ch = (unsigned char)s[i];
+        switch (ch) {
+            case '\"': PUTS(c, "\\\"", 2); break;
+            case '\\': PUTS(c, "\\\\", 2); break;
+            case '\b': PUTS(c, "\\b",  2); break;
+            case '\f': PUTS(c, "\\f",  2); break;
+            case '\n': PUTS(c, "\\n",  2); break;
+            case '\r': PUTS(c, "\\r",  2); break;
+            case '\t': PUTS(c, "\\t",  2); break;
+            default:
+                if (ch < 0x20) {
+                    char buffer[7];
+                    sprintf(buffer, "\\u%04X", ch);
+                    PUTS(c, buffer, 6);
+                }
+                else
+                    PUTC(c, s[i]);
+        }
+    }
+    PUTC(c, '"');
+}
+#else
+// 从s开始不需要转义、可以原样复制的字节数：控制字符、引号、反斜杠需要转义，ascii为真时0x80以上的字节也需要
+static size_t lept_stringify_plain(const char* s, size_t len, int ascii) {
+    size_t i = 0;
+#ifdef LEPT_SSE2
+    const __m128i quote = _mm_set1_epi8('"'), backslash = _mm_set1_epi8('\\'), space = _mm_set1_epi8(0x20);
+    const __m128i ctrl = _mm_set1_epi8(0x1F);
+    for (; len - i >= 16; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(s + i)), special;
+        // 有符号比较时0x80以上的字节是负数，一次比较就能同时找出控制字符和非ASCII字节
+        if (ascii)
+            special = _mm_cmplt_epi8(x, space);
+        else
+            special = _mm_cmpeq_epi8(_mm_max_epu8(x, ctrl), ctrl);
+        special = _mm_or_si128(special, _mm_or_si128(_mm_cmpeq_epi8(x, quote), _mm_cmpeq_epi8(x, backslash)));
+        if (_mm_movemask_epi8(special)) {
+            unsigned mask = (unsigned)_mm_movemask_epi8(special);
+            while (!(mask & 1)) {
+                mask >>= 1;
+                i++;
+            }
+            return i;
+        }
+    }
+#endif
+    for (; i < len; i++) {
+        unsigned char ch = (unsigned char)s[i];
+        if (ch < 0x20 || ch == '"' || ch == '\\' || (ascii && ch >= 0x80))
+            break;
+    }
+    return i;
+}
+
+static char* lept_stringify_hex4(char* p, unsigned u, const char* hex_digits) {
+    *p++ = '\\';
+    *p++ = 'u';
+    *p++ = hex_digits[(u >> 12) & 15];
+    *p++ = hex_digits[(u >> 8) & 15];
+    *p++ = hex_digits[(u >> 4) & 15];
+    *p++ = hex_digits[u & 15];
+    return p;
+}
+
+// 解码s开头的一个UTF-8序列（lept_encode_utf8() 的逆过程），返回消耗的字节数；非法序列消耗1个字节并得到U+FFFD
+static size_t lept_decode_utf8(const char* s, size_t len, unsigned* u) {
+    unsigned char b = (unsigned char)s[0];
+    size_t n = b < 0xE0 ? 2 : b < 0xF0 ? 3 : 4;
+    if (n > len || lept_utf8_scalar((const unsigned char*)s, n) != n) {
+        *u = 0xFFFD;
+        return 1;
+    }
+    switch (n) {
+        case 2:  *u = (b & 0x1Fu) << 6 | (s[1] & 0x3Fu); break;
+        case 3:  *u = (b & 0x0Fu) << 12 | (s[1] & 0x3Fu) << 6 | (s[2] & 0x3Fu); break;
+        default: *u = (b & 0x07u) << 18 | (s[1] & 0x3Fu) << 12 | (s[2] & 0x3Fu) << 6 | (s[3] & 0x3Fu); break;
+    }
+    return n;
+}
+
+static void lept_stringify_string(lept_context* c, const char* s, size_t len) {
+    // 这个函数主要是用来字符化lept_member.k或者LEPT_STRING
+    static const char upper_digits[] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F' };
+    static const char lower_digits[] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f' };
+    // 规范化输出要求小写的十六进制
+    const char* hex_digits = c->flags & LEPT_STRINGIFY_CANONICAL ? lower_digits : upper_digits;
+    int ascii = (c->flags & LEPT_STRINGIFY_ASCII) != 0;
+    size_t i, n, size;
+    unsigned u;
+    unsigned char ch;
+    char* head, *p;
+    assert(s != NULL);
+    // 每个输入字节最多输出6个字节：4字节的UTF-8序列输出代理对共12个字节
+    p = head = lept_context_push(c, size = len * 6 + 2); /* "\u00xx..." */
+    *p++ = '"';
+    for (i = 0; i < len; ) {
+        // 不需要转义的一段整块复制
+        n = lept_stringify_plain(s + i, len - i, ascii);
+        memcpy(p, s + i, n);
+        p += n;
+        if ((i += n) == len)
+            break;
+        ch = (unsigned char)s[i];
+        // 特殊字符需要转义存储
+        switch (ch) {
+            case '\"': *p++ = '\\'; *p++ = '\"'; break;
+            case '\\': *p++ = '\\'; *p++ = '\\'; break;
+            case '\b': *p++ = '\\'; *p++ = 'b';  break;
+            case '\f': *p++ = '\\'; *p++ = 'f';  break;
+            case '\n': *p++ = '\\'; *p++ = 'n';  break;
+            case '\r': *p++ = '\\'; *p++ = 'r';  break;
+            case '\t': *p++ = '\\'; *p++ = 't';  break;
+            default:
+                // 非ASCII字符按码点输出\uXXXX，超出BMP的输出代理对
+                if (ch >= 0x80) {
+                    i += lept_decode_utf8(s + i, len - i, &u);
+                    if (u >= 0x10000) {
+                        u -= 0x10000;
+                        p = lept_stringify_hex4(p, 0xD800 | (u >> 10), hex_digits);
+                        u = 0xDC00 | (u & 0x3FF);
+                    }
+                    p = lept_stringify_hex4(p, u, hex_digits);
+                    continue;
+                }
+                // 少于0x20的字符需要转义为\u00xx
+                p = lept_stringify_hex4(p, ch, hex_digits);
+        }
+        i++;
+    }
+    *p++ = '"';
+    c->top -= size - (p - head);
+}
+#endif
+
+// 按 ECMAScript Number.prototype.toString() 的格式输出数字（RFC 8785）：取能还原该值的最短有效数字，
+// 小数点位置n在 (-6, 21] 内时用定点表示，否则用指数表示
+static void lept_stringify_number_canonical(lept_context* c, double d) {
+    char buffer[32], digits[20], *p;
+    int k = 0, n, prec;
+    if (d != d || d - d != 0.0) {   // NaN 和无穷大不是合法的JSON数字，RFC 8785 要求拒绝
+        c->flags |= LEPT_STRINGIFY_FAILED;
+        return;
+    }
+    if (d == 0.0) {                 // 包括 -0
+        PUTC(c, '0');
+        return;
+    }
+    if (d < 0.0) {
+        PUTC(c, '-');
+        d = -d;
+    }
+    for (prec = 1; prec < 17; prec++) {
+        sprintf(buffer, "%.*e", prec - 1, d);
+        if (strtod(buffer, NULL) == d)
+            break;
+    }
+    if (prec == 17)
+        sprintf(buffer, "%.16e", d);
+    for (p = buffer; *p != 'e'; p++)
+        if (ISDIGIT(*p))
+            digits[k++] = *p;
+    while (k > 1 && digits[k - 1] == '0')
+        k--;
+    n = atoi(p + 1) + 1;    // 数值为 0.d1d2...dk * 10^n
+    if (k <= n && n <= 21) {
+        PUTS(c, digits, k);
+        for (; n > k; n--)
+            PUTC(c, '0');
+    }
+    else if (0 < n && n <= 21) {
+        PUTS(c, digits, n);
+        PUTC(c, '.');
+        PUTS(c, digits + n, k - n);
+    }
+    else if (-6 < n && n <= 0) {
+        PUTS(c, "0.", 2);
+        for (; n < 0; n++)
+            PUTC(c, '0');
+        PUTS(c, digits, k);
+    }
+    else {
+        PUTC(c, digits[0]);
+        if (k > 1) {
+            PUTC(c, '.');
+            PUTS(c, digits + 1, k - 1);
+        }
+        PUTC(c, 'e');
+        PUTC(c, n - 1 >= 0 ? '+' : '-');
+        k = sprintf(buffer, "%d", n - 1 >= 0 ? n - 1 : 1 - n);
+        PUTS(c, buffer, k);
+    }
+}
+
+// RFC 8785 按UTF-16码元比较键。UTF-8的字节序就是码点序，只有 U+E000~U+FFFF（首字节EE、EF）
+// 与用代理对表示的 U+10000 以上（首字节F0~F4）先后相反，把这几个首字节重新排位后即可逐字节比较
+static unsigned lept_utf16_rank(unsigned char b) {
+    return b < 0xEE || b > 0xF4 ? b : b >= 0xF0 ? b - 2u : b + 5u;
+}
+
+// 键在位置d的排序值，键已结束为0
+static unsigned lept_key_byte(const lept_member* m, size_t d) {
+    return d < m->klen ? lept_utf16_rank((unsigned char)m->k[d]) + 1 : 0;
+}
+
+static int lept_key_less(const lept_member* a, const lept_member* b, size_t d) {
+    size_t n = a->klen < b->klen ? a->klen : b->klen;
+    for (; d < n; d++)
+        if (a->k[d] != b->k[d])
+            return lept_utf16_rank((unsigned char)a->k[d]) < lept_utf16_rank((unsigned char)b->k[d]);
+    return a->klen < b->klen;
+}
+
+#ifndef LEPT_SORT_INSERTION
+#define LEPT_SORT_INSERTION 32
+#endif
+
+typedef struct {
+    size_t off, n;      // 待排序的区间 idx[off, off+n)
+    size_t d;           // 区间内的键前d个字节已知相同
+} lept_sort_task;
+
+// 排序成员下标（不移动 lept_member）。键较多时按字节做MSD基数排序，少时用插入排序
+// 共同前缀可以任意长，各个桶作为任务压在显式的工作栈上，不递归
+static void lept_sort_keys(const lept_member* m, size_t* idx, size_t* tmp, size_t n) {
+    lept_context c;
+    lept_sort_task t, *nt;
+    size_t count[257], start[257], i, j, k;
+    size_t* a;
+    c.stack = NULL;
+    c.size = c.top = 0;
+    c.stats = NULL;
+    t.off = 0;
+    t.n = n;
+    t.d = 0;
+    for (;;) {
+        a = idx + t.off;
+        if (t.n <= LEPT_SORT_INSERTION) {
+            for (i = 1; i < t.n; i++) {
+                k = a[i];
+                for (j = i; j > 0 && lept_key_less(&m[k], &m[a[j - 1]], t.d); j--)
+                    a[j] = a[j - 1];
+                a[j] = k;
+            }
+        }
+        else {
+            memset(count, 0, sizeof(count));
+            for (i = 0; i < t.n; i++)
+                count[lept_key_byte(&m[a[i]], t.d)]++;
+            k = lept_key_byte(&m[a[0]], t.d);
+            if (count[k] == t.n) {
+                if (k != 0) {
+                    t.d++;      // 共同前缀，不必分桶
+                    continue;
+                }
+                // 全部键都相同
+            }
+            else {
+                for (i = 0, k = 0; i < 257; i++) {
+                    start[i] = k;
+                    k += count[i];
+                }
+                for (i = 0; i < t.n; i++)
+                    tmp[start[lept_key_byte(&m[a[i]], t.d)]++] = a[i];
+                memcpy(a, tmp, t.n * sizeof(size_t));
+                // 桶0是已经结束的键，只有一个（键不重复时）
+                for (i = 1, k = count[0]; i < 257; k += count[i++])
+                    if (count[i] > 1) {
+                        nt = (lept_sort_task*)lept_context_push(&c, sizeof(lept_sort_task));
+                        nt->off = t.off + k;
+                        nt->n = count[i];
+                        nt->d = t.d + 1;
+                    }
+            }
+        }
+        if (c.top == 0)
+            break;
+        memcpy(&t, lept_context_pop(&c, sizeof(lept_sort_task)), sizeof(lept_sort_task));
+    }
+    free(c.stack);
+}
+
+// 输出对象的键；同一个键（按指针）已经输出过时复制当时的转义结果
+static void lept_stringify_key(lept_context* c, const char* k, size_t klen) {
+    lept_key_memo* m = &c->memo[((uintptr_t)k >> 3) % LEPT_KEY_MEMO_SIZE];
+    size_t off = c->top;
+    if (m->k == k) {
+        // 先压栈再复制：压栈可能使 c->stack 移动
+        char* p = lept_context_push(c, m->len);
+        memcpy(p, c->stack + m->off, m->len);
+        return;
+    }
+    lept_stringify_string(c, k, klen);
+    m->k = k;
+    m->off = off;
+    m->len = c->top - off;
+}
+
+static void lept_stringify_value(lept_context* c, const lept_value* v);
+
+static void lept_stringify_object_canonical(lept_context* c, const lept_value* v) {
+    size_t small[LEPT_SORT_INSERTION * 2], *idx = small, i, n = v->u.o.size;
+    if (n > LEPT_SORT_INSERTION)
+        idx = (size_t*)malloc(n * 2 * sizeof(size_t));
+    for (i = 0; i < n; i++)
+        idx[i] = i;
+    lept_sort_keys(v->u.o.m, idx, idx + n, n);
+    PUTC(c, '{');
+    for (i = 0; i < n; i++) {
+        const lept_member* m = &v->u.o.m[idx[i]];
+        if (i > 0)
+            PUTC(c, ',');
+        lept_stringify_key(c, m->k, m->klen);
+        PUTC(c, ':');
+        lept_stringify_value(c, &m->v);
+    }
+    PUTC(c, '}');
+    if (idx != small)
+        free(idx);
+}
+
+static void lept_stringify_value(lept_context* c, const lept_value* v) {
+    size_t i;
+    switch (v->type) {
+        case LEPT_NULL:   PUTS(c, "null",  4); break;
+        case LEPT_FALSE:  PUTS(c, "false", 5); break;
+        case LEPT_TRUE:   PUTS(c, "true",  4); break;
+        case LEPT_NUMBER:
+            if (c->flags & LEPT_STRINGIFY_CANONICAL)
+                lept_stringify_number_canonical(c, v->u.n);
+            else if (c->stats) {
+                double t = lept_clock();
+                c->top -= 32 - sprintf(lept_context_push(c, 32), "%.17g", v->u.n);
+                c->stats->number_seconds += lept_clock() - t;
+            }
+            else
+                c->top -= 32 - sprintf(lept_context_push(c, 32), "%.17g", v->u.n);
+            break;
+        case LEPT_STRING:
+            if (c->stats) {
+                double t = lept_clock();
+                lept_stringify_string(c, v->u.s.s, v->u.s.len);
+                c->stats->string_seconds += lept_clock() - t;
+            }
+            else
+                lept_stringify_string(c, v->u.s.s, v->u.s.len);
+            break;
+        case LEPT_ARRAY:
+            PUTC(c, '[');
+            for (i = 0; i < v->u.a.size; i++) {
+                if (i > 0)
+                    PUTC(c, ',');
+                lept_stringify_value(c, &v->u.a.e[i]);
+            }
+            PUTC(c, ']');
+            break;
+        case LEPT_OBJECT:
+            if (c->flags & LEPT_STRINGIFY_CANONICAL) {
+                lept_stringify_object_canonical(c, v);
+                break;
+            }
+            PUTC(c, '{');
+            for (i = 0; i < v->u.o.size; i++) {
+                if (i > 0)
+                    PUTC(c, ',');
+                lept_stringify_key(c, v->u.o.m[i].k, v->u.o.m[i].klen);
+                PUTC(c, ':');
+                lept_stringify_value(c, &v->u.o.m[i].v);
+            }
+            PUTC(c, '}');
+            break;
+        default: assert(0 && "invalid type");
+    }
+}
+
+
+// 生成器
+char* lept_stringify(const lept_value* v, size_t* length) {
+    return lept_stringify_opt(v, length, NULL);
+}
+
+char* lept_stringify_canonical(const lept_value* v, size_t* length) {
+    lept_stringify_options opt;
+    memset(&opt, 0, sizeof(opt));
+    opt.flags = LEPT_STRINGIFY_CANONICAL;
+    return lept_stringify_opt(v, length, &opt);
+}
+
+char* lept_stringify_opt(const lept_value* v, size_t* length, const lept_stringify_options* opt) {
+    lept_context c;
+    lept_key_memo memo[LEPT_KEY_MEMO_SIZE];
+    double t = 0.0, ts = 0.0, tn = 0.0;
+    assert(v != NULL);
+    memset(memo, 0, sizeof(memo));
+    c.memo = memo;
+    c.stack = (char*)malloc(c.size = LEPT_PARSE_STRINGIFY_INIT_SIZE);
+    c.top = 0;
+    c.depth = 0;
+    c.flags = opt ? opt->flags : 0;
+    c.stats = opt && opt->stats ? opt->stats : lept_thread_stats;
+    if (c.stats) {
+        c.stats->stack_mallocs++;
+        c.stats->stack_alloc_bytes += c.size;
+        t = lept_clock();
+        ts = c.stats->string_seconds;
+        tn = c.stats->number_seconds;
+    }
+    lept_stringify_value(&c, v);
+    if (c.flags & LEPT_STRINGIFY_FAILED) {
+        free(c.stack);
+        if (length)
+            *length = 0;
+        return NULL;
+    }
+    if (length)
+        *length = c.top;
+    if (c.stats) {
+        c.stats->stringify_bytes += c.top;
+        c.stats->structure_seconds += (lept_clock() - t)
+            - (c.stats->string_seconds - ts) - (c.stats->number_seconds - tn);
+    }
+    PUTC(&c, '\0');
+    return c.stack;
+}
+
+
+// 深拷贝、释放、相等比较都用 lept_context 作为显式的工作栈，嵌套再深也不会递归
+typedef struct {
+    lept_value* dst;
+    const lept_value* src;
+} lept_copy_task;
+
+// 拷贝一个新初始化的子结点，容器留到之后处理
+static void lept_copy_child(lept_context* c, lept_value* dst, const lept_value* src) {
+    if (src->type == LEPT_ARRAY || src->type == LEPT_OBJECT) {
+        lept_copy_task* t = (lept_copy_task*)lept_context_push(c, sizeof(lept_copy_task));
+        lept_init(dst);
+        t->dst = dst;
+        t->src = src;
+    }
+    else if (src->type == LEPT_STRING) {
+        lept_init(dst);
+        lept_set_string(dst, src->u.s.s, src->u.s.len);
+    }
+    else
+        memcpy(dst, src, sizeof(lept_value));
+}
+
+void lept_copy(lept_value* dst, const lept_value* src) {
+    lept_context c;
+    lept_copy_task t;
+    size_t i, n;
+    assert(src != NULL && dst != NULL && src != dst);
+    c.stack = NULL;
+    c.size = c.top = 0;
+    c.stats = NULL;
+    t.dst = dst;
+    t.src = src;
+    for (;;) {
+        switch (t.src->type) {
+            case LEPT_STRING:
+                lept_set_string(t.dst, t.src->u.s.s, t.src->u.s.len);
+                break;
+            case LEPT_ARRAY:
+                // 一次分配好空间，逐个拷贝
+                lept_set_array(t.dst, n = t.src->u.a.size);
+                for (i = 0; i < n; i++)
+                    lept_copy_child(&c, &t.dst->u.a.e[i], &t.src->u.a.e[i]);
+                t.dst->u.a.size = n;
+                break;
+            case LEPT_OBJECT:
+                // 源对象的键本来就不重复，直接批量复制成员，不再经过 lept_set_object_value() 逐个查找
+                lept_set_object(t.dst, n = t.src->u.o.size);
+                for (i = 0; i < n; i++) {
+                    lept_member* dm = &t.dst->u.o.m[i];
+                    const lept_member* sm = &t.src->u.o.m[i];
+                    dm->k = lept_key_retain(sm->k);     // 键不可修改，直接共享
+                    dm->klen = sm->klen;
+                    lept_copy_child(&c, &dm->v, &sm->v);
+                }
+                t.dst->u.o.size = n;
+                break;
+            default:
+                lept_free(t.dst);
+                memcpy(t.dst, t.src, sizeof(lept_value));
+                break;
+        }
+        if (c.top == 0)
+            break;
+        memcpy(&t, lept_context_pop(&c, sizeof(lept_copy_task)), sizeof(lept_copy_task));
+    }
+    free(c.stack);
+}
+
+void lept_copy_shared(lept_value* dst, const lept_value* src) {
+    lept_value t;
+    assert(src != NULL && dst != NULL && src != dst);
+    // 先取得共享再释放dst，src在dst之内时也成立
+    lept_share_child(&t, src);
+    lept_free(dst);
+    memcpy(dst, &t, sizeof(lept_value));
+}
+
+void lept_move(lept_value* dst, lept_value* src) {
+    assert(dst != NULL && src != NULL && src != dst);
+    lept_free(dst);
+    memcpy(dst, src, sizeof(lept_value));
+    // 其实也是把src指针置null
+    lept_init(src);
+}
+
+void lept_swap(lept_value* lhs, lept_value* rhs) {
+    assert(lhs != NULL && rhs != NULL);
+    if (lhs != rhs) {
+        lept_value temp;
+        memcpy(&temp, lhs, sizeof(lept_value));
+        memcpy(lhs,   rhs, sizeof(lept_value));
+        memcpy(rhs, &temp, sizeof(lept_value));
+    }
+}
+
+// 释放一个子结点，容器按值压栈，使父容器的缓冲区可以立即释放
+static void lept_free_child(lept_context* c, lept_value* v) {
+    if (v->type == LEPT_STRING) {
+        if (!v->u.s.borrowed)
+            free(v->u.s.s);
+    }
+    else if (v->type == LEPT_ARRAY || v->type == LEPT_OBJECT)
+        memcpy(lept_context_push(c, sizeof(lept_value)), v, sizeof(lept_value));
+}
+
+void lept_free(lept_value* v) {
+    lept_context c;
+    lept_value x;
+    size_t i;
+    assert(v != NULL);
+    switch (v->type) {
+        case LEPT_STRING:
+            if (!v->u.s.borrowed)
+                free(v->u.s.s);
+            break;
+        case LEPT_ARRAY:
+        case LEPT_OBJECT:
+            c.stack = NULL;
+            c.size = c.top = 0;
+            c.stats = NULL;
+            memcpy(&x, v, sizeof(lept_value));
+            for (;;) {
+                if (!lept_buffer_release(x.type == LEPT_ARRAY ? (void*)x.u.a.e : (void*)x.u.o.m))
+                    ;   // 还有其它值共享这个缓冲区
+                else if (x.type == LEPT_ARRAY) {
+                    for (i = 0; i < x.u.a.size; i++)
+                        lept_free_child(&c, &x.u.a.e[i]);
+                    lept_buffer_free(x.u.a.e);
+                }
+                else {
+                    for (i = 0; i < x.u.o.size; i++) {
+                        lept_key_free(x.u.o.m[i].k);
+                        lept_free_child(&c, &x.u.o.m[i].v);
+                    }
+                    lept_buffer_free(x.u.o.m);
+                }
+                if (c.top == 0)
+                    break;
+                memcpy(&x, lept_context_pop(&c, sizeof(lept_value)), sizeof(lept_value));
+            }
+            free(c.stack);
+            break;
+        default: break;
+    }
+    v->type = LEPT_NULL;
+}
+
+lept_type lept_get_type(const lept_value* v) {
+    assert(v != NULL);
+    return v->type;
+}
+
+
+static lept_index* lept_index_build(const lept_value* v);
+static size_t lept_index_find(const lept_index* x, const lept_value* v, const char* key, size_t klen, uint64_t hash);
+static const lept_index* lept_object_index_get(const lept_value* v);
+
+typedef struct {
+    const lept_value* lhs;
+    const lept_value* rhs;
+} lept_equal_task;
+
+// 比较两个子结点，容器留到之后比较
+static int lept_is_equal_child(lept_context* c, const lept_value* lhs, const lept_value* rhs) {
+    if (lhs->type != rhs->type)
+        return 0;
+    switch (lhs->type) {
+        case LEPT_STRING:
+            return lhs->u.s.len == rhs->u.s.len &&
+                memcmp(lhs->u.s.s, rhs->u.s.s, lhs->u.s.len) == 0;
+        case LEPT_NUMBER:
+            return lhs->u.n == rhs->u.n;
+        case LEPT_ARRAY:
+        case LEPT_OBJECT: {
+            // 两边都有缓存的哈希时，哈希不同即可判定不相等，不必展开
+            const lept_header* lh = lept_get_header(lhs), *rh = lept_get_header(rhs);
+            lept_equal_task* t;
+            if (lh && rh && lh->hashed && rh->hashed && lh->hash != rh->hash)
+                return 0;
+            // 共享同一个缓冲区的容器内容必然相同
+            if (lh != NULL && lh == rh)
+                return 1;
+            t = (lept_equal_task*)lept_context_push(c, sizeof(lept_equal_task));
+            t->lhs = lhs;
+            t->rhs = rhs;
+            return 1;
+        }
+        default:
+            return 1;
+    }
+}
+
+int lept_is_equal(const lept_value* lhs, const lept_value* rhs) {
+    lept_context c;
+    lept_equal_task t;
+    size_t i, index;
+    int equal = 1;
+    assert(lhs != NULL && rhs != NULL);
+    c.stack = NULL;
+    c.size = c.top = 0;
+    c.stats = NULL;
+    if (!lept_is_equal_child(&c, lhs, rhs))
+        return 0;
+    while (equal && c.top > 0) {
+        memcpy(&t, lept_context_pop(&c, sizeof(lept_equal_task)), sizeof(lept_equal_task));
+        if (t.lhs->type == LEPT_ARRAY) {
+            if (t.lhs->u.a.size != t.rhs->u.a.size)
+                equal = 0;
+            for (i = 0; equal && i < t.lhs->u.a.size; i++)
+                equal = lept_is_equal_child(&c, &t.lhs->u.a.e[i], &t.rhs->u.a.e[i]);
+        }
+        else {
+            // 对于object 先比较键值个数是否一样
+            // 一样的话，对左边的键值对在右边查找，键的顺序相同时不必查找
+            // 右边是常量，不能把索引存进它的头部；没有现成索引的大对象临时建一个，比较完即释放
+            const lept_index* x = NULL;
+            lept_index* tmp = NULL;
+            if (t.lhs->u.o.size != t.rhs->u.o.size)
+                equal = 0;
+            for (i = 0; equal && i < t.lhs->u.o.size; i++) {
+                const lept_member* m = &t.lhs->u.o.m[i];
+                if (t.rhs->u.o.m[i].klen == m->klen && (t.rhs->u.o.m[i].k == m->k || memcmp(t.rhs->u.o.m[i].k, m->k, m->klen) == 0))
+                    index = i;
+                else {
+                    if (x == NULL && t.rhs->u.o.size >= LEPT_OBJECT_INDEX_MIN
+                        && (x = lept_object_index_get(t.rhs)) == NULL)
+                        x = tmp = lept_index_build(t.rhs);
+                    index = x != NULL ? lept_index_find(x, t.rhs, m->k, m->klen, lept_key_hash(m->k, m->klen))
+                                      : lept_find_object_index(t.rhs, m->k, m->klen);
+                    if (index == LEPT_KEY_NOT_EXIST) {
+                        equal = 0;
+                        break;
+                    }
+                }
+                equal = lept_is_equal_child(&c, &m->v, &t.rhs->u.o.m[index].v);
+            }
+            free(tmp);
+        }
+    }
+    free(c.stack);
+    return equal;
+}
+
+int lept_get_boolean(const lept_value* v) {
+    assert(v != NULL && (v->type == LEPT_TRUE || v->type == LEPT_FALSE));
+    return v->type == LEPT_TRUE;
+}
+
+void lept_set_boolean(lept_value* v, int b) {
+    lept_free(v);
+    v->type = b ? LEPT_TRUE : LEPT_FALSE;
+}
+
+// 只有当type为LEPT_NUMBER时才可以取获得数值
+double lept_get_number(const lept_value* v) {
+    assert(v != NULL && v->type == LEPT_NUMBER);
+    return v->u.n;
+}
+
+void lept_set_number(lept_value* v, double n) {
+    lept_free(v);
+    v->u.n = n;
+    v->type = LEPT_NUMBER;
+}
+
+const char* lept_get_string(const lept_value* v) {
+    assert(v != NULL && v->type == LEPT_STRING);
+    return v->u.s.s;
+}
+
+size_t lept_get_string_length(const lept_value* v) {
+    assert(v != NULL && v->type == LEPT_STRING);
+    return v->u.s.len;
+}
+
+void lept_set_string(lept_value* v, const char* s, size_t len) {
+    assert(v != NULL && (s != NULL || len == 0));
+    // 先释放之前的v，避免以前的v没有释放造成影响
+    lept_free(v);
+    v->u.s.s = (char*)malloc(len + 1);
+    memcpy(v->u.s.s, s, len);
+    v->u.s.s[len] = '\0';
+    v->u.s.len = len;
+    v->u.s.borrowed = 0;
+    v->type = LEPT_STRING;
+}
+
+void lept_set_array(lept_value* v, size_t capacity) {
+    assert(v != NULL);
+    lept_free(v);
+    v->type = LEPT_ARRAY;
+    v->u.a.size = 0;
+    v->u.a.capacity = capacity;
+    v->u.a.e = (lept_value*)lept_buffer_realloc(NULL, capacity, sizeof(lept_value));
+}
+
+size_t lept_get_array_size(const lept_value* v) {
+    assert(v != NULL && v->type == LEPT_ARRAY);
+    return v->u.a.size;
+}
+
+size_t lept_get_array_capacity(const lept_value* v) {
+    assert(v != NULL && v->type == LEPT_ARRAY);
+    return v->u.a.capacity;
+}
+
+void lept_reserve_array(lept_value* v, size_t capacity) {
+    assert(v != NULL && v->type == LEPT_ARRAY);
+    lept_unshare(v);
+    if (v->u.a.capacity < capacity) {
+        v->u.a.capacity = capacity;
+        v->u.a.e = (lept_value*)lept_buffer_realloc(v->u.a.e, capacity, sizeof(lept_value));
+    }
+}
+
+void lept_shrink_array(lept_value* v) {
+	assert(v != NULL && v->type == LEPT_ARRAY);
+	lept_unshare(v);
+	if (v->u.a.capacity > v->u.a.size) {
+		v->u.a.capacity = v->u.a.size;
+		v->u.a.e = (lept_value*)lept_buffer_realloc(v->u.a.e, v->u.a.capacity, sizeof(lept_value));
+	}
+}
+void lept_clear_array(lept_value* v) {
+    assert(v != NULL && v->type == LEPT_ARRAY);
+    lept_erase_array_element(v, 0, v->u.a.size);
+}
+
+lept_value* lept_get_array_element(lept_value* v, size_t index) {
+    assert(v != NULL && v->type == LEPT_ARRAY);
+    assert(index < v->u.a.size);
+    lept_touch(v);
+    return &v->u.a.e[index];
+}
+
+// 只读访问不经 lept_touch，不写入缓冲区头部
+const lept_value* lept_get_array_element_const(const lept_value* v, size_t index) {
+    assert(v != NULL && v->type == LEPT_ARRAY);
+    assert(index < v->u.a.size);
+    return &v->u.a.e[index];
+}
+
+lept_value* lept_pushback_array_element(lept_value* v) {
+    assert(v != NULL && v->type == LEPT_ARRAY);
+    lept_touch(v);
+    if (v->u.a.size == v->u.a.capacity)
+        lept_reserve_array(v, v->u.a.capacity == 0 ? 1 : v->u.a.capacity * 2);
+    lept_init(&v->u.a.e[v->u.a.size]);
+    return &v->u.a.e[v->u.a.size++];
+}
+
+void lept_popback_array_element(lept_value* v) {
+    assert(v != NULL && v->type == LEPT_ARRAY && v->u.a.size > 0);
+    lept_touch(v);
+    lept_free(&v->u.a.e[--v->u.a.size]);
+}
+
+// index不可以超过size，因为是插入，等于size的话就是相当于插在末尾
+lept_value* lept_insert_array_element(lept_value* v, size_t index) {
+    assert(v != NULL && v->type == LEPT_ARRAY && index <= v->u.a.size);
+    lept_touch(v);
+    if (v->u.a.size == v->u.a.capacity)
+		lept_reserve_array(v, v->u.a.capacity == 0 ? 1 : (v->u.a.size << 1)); //扩容为原来一倍
+	memmove(&v->u.a.e[index + 1], &v->u.a.e[index], (v->u.a.size - index) * sizeof(lept_value));
+	lept_init(&v->u.a.e[index]);
+	v->u.a.size++;
+	return &v->u.a.e[index];
+}
+
+void lept_erase_array_element(lept_value* v, size_t index, size_t count) {
+    assert(v != NULL && v->type == LEPT_ARRAY && index + count <= v->u.a.size);
+    lept_touch(v);
+    /* \todo */
+    size_t i;
+	for (i = index; i < index + count; i++) {
+		lept_free(&v->u.a.e[i]);
+	}
+	memmove(v->u.a.e + index, v->u.a.e + index + count, (v->u.a.size - index - count) * sizeof(lept_value));
+	for (i = v->u.a.size - count; i < v->u.a.size; i++)
+		lept_init(&v->u.a.e[i]);
+	v->u.a.size -= count;
+}
+
+void lept_set_object(lept_value* v, size_t capacity) {
+    assert(v != NULL);
     lept_free(v);
     v->type = LEPT_OBJECT;
     v->u.o.size = 0;
     v->u.o.capacity = capacity;
-    v->u.o.m = capacity > 0 ? (lept_member*)malloc(capacity * sizeof(lept_member)) : NULL;
+    v->u.o.m = (lept_member*)lept_buffer_realloc(NULL, capacity, sizeof(lept_member));
+}
+
+size_t lept_get_object_size(const lept_value* v) {
+    assert(v != NULL && v->type == LEPT_OBJECT);
+    return v->u.o.size;
+}
+
+size_t lept_get_object_capacity(const lept_value* v) {
+    assert(v != NULL && v->type == LEPT_OBJECT);
+    // 返回对象容量大小
+	return v->u.o.capacity;
+}
+
+void lept_reserve_object(lept_value* v, size_t capacity) {
+    assert(v != NULL && v->type == LEPT_OBJECT);
+    /* \todo */
+    // 重置容量, 比原来大。
+	lept_unshare(v);
+	if (v->u.o.capacity < capacity) {
+		v->u.o.capacity = capacity;
+		v->u.o.m = (lept_member*)lept_buffer_realloc(v->u.o.m, capacity, sizeof(lept_member));
+	}
+}
+
+void lept_shrink_object(lept_value* v) {
+    assert(v != NULL && v->type == LEPT_OBJECT);
+    /* \todo */
+    // 收缩容量到刚好符合大小
+	lept_unshare(v);
+	if (v->u.o.capacity > v->u.o.size) {
+		v->u.o.capacity = v->u.o.size;
+		v->u.o.m = (lept_member*)lept_buffer_realloc(v->u.o.m, v->u.o.capacity, sizeof(lept_member));
+	}
+}
+
+void lept_clear_object(lept_value* v) {
+    assert(v != NULL && v->type == LEPT_OBJECT);
+    lept_touch_keys(v);
+    /* \todo */
+    // 清空对象
+	size_t i;
+	for (i = 0; i < v->u.o.size; i++) {
+		//回收k和v空间
+		lept_key_free(v->u.o.m[i].k);
+		v->u.o.m[i].k = NULL;
+		v->u.o.m[i].klen = 0;
+		lept_free(&v->u.o.m[i].v);
+	}
+	v->u.o.size = 0;
+}
+
+const char* lept_get_object_key(const lept_value* v, size_t index) {
+    assert(v != NULL && v->type == LEPT_OBJECT);
+    assert(index < v->u.o.size);
+    return v->u.o.m[index].k;
+}
+
+size_t lept_get_object_key_length(const lept_value* v, size_t index) {
+    assert(v != NULL && v->type == LEPT_OBJECT);
+    assert(index < v->u.o.size);
+    return v->u.o.m[index].klen;
+}
+
+lept_value* lept_get_object_value(lept_value* v, size_t index) {
+    assert(v != NULL && v->type == LEPT_OBJECT);
+    assert(index < v->u.o.size);
+    lept_touch(v);
+    return &v->u.o.m[index].v;
+}
+
+// 只读访问不经 lept_touch，不写入缓冲区头部
+const lept_value* lept_get_object_value_const(const lept_value* v, size_t index) {
+    assert(v != NULL && v->type == LEPT_OBJECT);
+    assert(index < v->u.o.size);
+    return &v->u.o.m[index].v;
+}
+
+uint64_t lept_key_hash(const char* key, size_t klen) {
+    assert(key != NULL || klen == 0);
+    return lept_fnv1a(LEPT_FNV_OFFSET, key, klen);
+}
+
+// 在索引中加入第i个成员；同一个键只索引第一次出现的，与线性查找的结果一致
+static void lept_index_add(lept_index* x, const lept_value* v, size_t i, uint64_t hash) {
+    size_t j = (size_t)hash & x->mask;
+    const lept_member* m = &v->u.o.m[i];
+    for (; x->slot[j].index != 0; j = (j + 1) & x->mask)
+        if (x->slot[j].hash == hash) {
+            const lept_member* o = &v->u.o.m[x->slot[j].index - 1];
+            if (o->klen == m->klen && (o->k == m->k || memcmp(o->k, m->k, m->klen) == 0))
+                return;
+        }
+    x->slot[j].hash = hash;
+    x->slot[j].index = i + 1;
+}
+
+// 为对象建立一个新的键索引；装填因子不超过1/2
+static lept_index* lept_index_build(const lept_value* v) {
+    lept_index* x;
+    size_t i, n = 4;
+    while (n < v->u.o.size * 2)
+        n <<= 1;
+    x = (lept_index*)calloc(1, sizeof(lept_index) + (n - 1) * sizeof(lept_index_slot));
+    x->mask = n - 1;
+    x->size = v->u.o.size;
+    for (i = 0; i < v->u.o.size; i++)
+        lept_index_add(x, v, i, lept_key_hash(v->u.o.m[i].k, v->u.o.m[i].klen));
+    return x;
+}
+
+static size_t lept_index_find(const lept_index* x, const lept_value* v, const char* key, size_t klen, uint64_t hash) {
+    size_t i;
+    for (i = (size_t)hash & x->mask; x->slot[i].index != 0; i = (i + 1) & x->mask)
+        if (x->slot[i].hash == hash) {
+            const lept_member* m = &v->u.o.m[x->slot[i].index - 1];
+            if (m->klen == klen && (m->k == key || memcmp(m->k, key, klen) == 0))
+                return x->slot[i].index - 1;
+        }
+    return LEPT_KEY_NOT_EXIST;
+}
+
+static size_t lept_find_member(const lept_value* v, const char* key, size_t klen) {
+    size_t i;
+    for (i = 0; i < v->u.o.size; i++)
+        if (v->u.o.m[i].klen == klen && (v->u.o.m[i].k == key || memcmp(v->u.o.m[i].k, key, klen) == 0))
+            return i;
+    return LEPT_KEY_NOT_EXIST;
+}
+
+// 对象已建好且未过期的键索引，没有时为NULL
+static const lept_index* lept_object_index_get(const lept_value* v) {
+    const lept_index* x;
+    if (v->u.o.size < LEPT_OBJECT_INDEX_MIN)
+        return NULL;
+    x = LEPT_HEADER(v->u.o.m)->index;
+    return x != NULL && x->size == v->u.o.size ? x : NULL;
+}
+
+// 取得对象的键索引，没有或已过期时（重新）建立并存入缓冲区头部
+// 只在可写的路径上调用：常量查找可能在多个线程中同时进行，不能写入共享的头部
+static const lept_index* lept_object_index(lept_value* v) {
+    lept_header* h = LEPT_HEADER(v->u.o.m);
+    if (h->index == NULL || h->index->size != v->u.o.size) {
+        free(h->index);
+        h->index = lept_index_build(v);
+    }
+    return h->index;
+}
+
+// 可写路径上的查找：先分离共享的存储，较大的对象按需建立键索引
+static size_t lept_object_lookup_hashed(lept_value* v, const char* key, size_t klen, uint64_t hash) {
+    lept_touch(v);
+    if (v->u.o.size < LEPT_OBJECT_INDEX_MIN)
+        return lept_find_member(v, key, klen);
+    return lept_index_find(lept_object_index(v), v, key, klen, hash);
+}
+
+static size_t lept_object_lookup(lept_value* v, const char* key, size_t klen) {
+    lept_touch(v);
+    if (v->u.o.size < LEPT_OBJECT_INDEX_MIN)
+        return lept_find_member(v, key, klen);
+    return lept_index_find(lept_object_index(v), v, key, klen, lept_key_hash(key, klen));
+}
+
+// 常量查找只读：使用已有的键索引，没有时线性查找
+size_t lept_find_object_index_hashed(const lept_value* v, const char* key, size_t klen, uint64_t hash) {
+    const lept_index* x;
+    assert(v != NULL && v->type == LEPT_OBJECT && key != NULL);
+    assert(hash == lept_key_hash(key, klen));
+    if ((x = lept_object_index_get(v)) != NULL)
+        return lept_index_find(x, v, key, klen, hash);
+    return lept_find_member(v, key, klen);
+}
+
+size_t lept_find_object_index(const lept_value* v, const char* key, size_t klen) {
+    const lept_index* x;
+    assert(v != NULL && v->type == LEPT_OBJECT && key != NULL);
+    if ((x = lept_object_index_get(v)) != NULL)
+        return lept_index_find(x, v, key, klen, lept_key_hash(key, klen));
+    return lept_find_member(v, key, klen);
+}
+
+size_t lept_find_object_index_hint(const lept_value* v, const char* key, size_t klen, size_t* hint) {
+    size_t i;
+    assert(v != NULL && v->type == LEPT_OBJECT && key != NULL && hint != NULL);
+    // 同一形状的对象中键的位置相同，先核对上次的位置
+    i = *hint;
+    if (i < v->u.o.size && v->u.o.m[i].klen == klen && (v->u.o.m[i].k == key || memcmp(v->u.o.m[i].k, key, klen) == 0))
+        return i;
+    if ((i = lept_find_object_index(v, key, klen)) != LEPT_KEY_NOT_EXIST)
+        *hint = i;
+    return i;
+}
+
+lept_value* lept_find_object_value(lept_value* v, const char* key, size_t klen) {
+    size_t index;
+    assert(v != NULL && v->type == LEPT_OBJECT && key != NULL);
+    index = lept_object_lookup(v, key, klen);
+    return index != LEPT_KEY_NOT_EXIST ? &v->u.o.m[index].v : NULL;
+}
+
+lept_value* lept_find_object_value_hashed(lept_value* v, const char* key, size_t klen, uint64_t hash) {
+    size_t index;
+    assert(v != NULL && v->type == LEPT_OBJECT && key != NULL);
+    assert(hash == lept_key_hash(key, klen));
+    index = lept_object_lookup_hashed(v, key, klen, hash);
+    return index != LEPT_KEY_NOT_EXIST ? &v->u.o.m[index].v : NULL;
+}
+
+// 设置k字段为key的对象的值，如果在查找过程中找到了已经存在key，则返回；否则新申请一块空间并初始化，然后返回
+lept_value* lept_set_object_value(lept_value* v, const char* key, size_t klen) {
+    assert(v != NULL && v->type == LEPT_OBJECT && key != NULL);
+    lept_touch(v);
+    /* \todo */
+    size_t i, index;
+    lept_index* x;
+	index = lept_object_lookup(v, key, klen);
+	if (index != LEPT_KEY_NOT_EXIST)
+		return &v->u.o.m[index].v;
+	//key not exist, then we make room and init
+	if (v->u.o.size == v->u.o.capacity) {
+		lept_reserve_object(v, v->u.o.capacity == 0 ? 1 : (v->u.o.capacity << 1));
+	}
+	i = v->u.o.size;
+	v->u.o.m[i].k = lept_key_new(key, klen);
+	v->u.o.m[i].klen = klen;
+	lept_init(&v->u.o.m[i].v);
+	v->u.o.size++;
+	// 追加在末尾，已有的索引仍然有效，有空间时直接加入新键
+	x = LEPT_HEADER(v->u.o.m)->index;
+	if (x != NULL && x->size == i && v->u.o.size * 2 <= x->mask + 1) {
+		lept_index_add(x, v, i, lept_key_hash(key, klen));
+		x->size++;
+	}
+	return &v->u.o.m[i].v;
+}
+
+void lept_remove_object_value(lept_value* v, size_t index) {
+    assert(v != NULL && v->type == LEPT_OBJECT && index < v->u.o.size);
+    lept_touch_keys(v);
+    /* \todo */
+    lept_key_free(v->u.o.m[index].k);
+	lept_free(&v->u.o.m[index].v);
+	//think like a list
+	memmove(v->u.o.m + index, v->u.o.m + index + 1, (v->u.o.size - index - 1) * sizeof(lept_member));   // 这里原来有错误，区间重叠要用memmove
+	// 原来的size比如是10，最多其实只能访问下标为9
+	// 删除一个元素，再进行挪移，原来为9的地方要清空
+	// 现在先将size--，则size就是9
+	v->u.o.m[--v->u.o.size].k = NULL;  
+	v->u.o.m[v->u.o.size].klen = 0;
+	lept_init(&v->u.o.m[v->u.o.size].v);
+}
+
+lept_pointer* lept_pointer_compile(const char* s, size_t len) {
+    lept_pointer* p;
+    lept_pointer_token* t;
+    char* k;
+    size_t i, n = 0;
+    assert(s != NULL || len == 0);
+    if (len > 0 && s[0] != '/')
+        return NULL;
+    for (i = 0; i < len; i++)
+        if (s[i] == '/')
+            n++;
+        else if (s[i] == '~' && (i + 1 == len || (s[i + 1] != '0' && s[i + 1] != '1')))
+            return NULL;
+    p = (lept_pointer*)malloc(sizeof(lept_pointer) + n * sizeof(lept_pointer_token) + len + 1);
+    p->n = n;
+    p->t = t = (lept_pointer_token*)(p + 1);
+    k = (char*)(t + n);
+    for (i = 0; i < len; t++) {
+        const char* head = k;
+        for (i++; i < len && s[i] != '/'; i++)
+            if (s[i] == '~')
+                *k++ = s[++i] == '0' ? '~' : '/';
+            else
+                *k++ = s[i];
+        t->k = head;
+        t->klen = (size_t)(k - head);
+        *k++ = '\0';
+        // 预先转换数组下标，不允许前导零
+        if (t->klen == 1 && head[0] == '-')
+            t->index = LEPT_POINTER_END;
+        else if (t->klen == 0 || (head[0] == '0' && t->klen > 1))
+            t->index = LEPT_KEY_NOT_EXIST;
+        else {
+            size_t j, index = 0;
+            for (j = 0; j < t->klen && ISDIGIT(head[j]) && index <= (LEPT_POINTER_END - 10) / 10; j++)
+                index = index * 10 + (head[j] - '0');
+            t->index = j == t->klen ? index : LEPT_KEY_NOT_EXIST;
+        }
+    }
+    return p;
+}
+
+void lept_pointer_free(lept_pointer* p) {
+    free(p);
+}
+
+// 在容器v中查找一个令牌对应的子结点
+static lept_value* lept_pointer_step(lept_value* v, const lept_pointer_token* t) {
+    size_t i;
+    lept_touch(v);
+    if (v->type == LEPT_OBJECT) {
+        for (i = 0; i < v->u.o.size; i++)
+            if (v->u.o.m[i].klen == t->klen && memcmp(v->u.o.m[i].k, t->k, t->klen) == 0)
+                return &v->u.o.m[i].v;
+    }
+    else if (v->type == LEPT_ARRAY && t->index < v->u.a.size)
+        return &v->u.a.e[t->index];
+    return NULL;
+}
+
+lept_value* lept_pointer_get(const lept_pointer* p, lept_value* root) {
+    size_t i;
+    assert(p != NULL && root != NULL);
+    for (i = 0; root && i < p->n; i++)
+        root = lept_pointer_step(root, &p->t[i]);
+    return root;
+}
+
+lept_value* lept_pointer_set(const lept_pointer* p, lept_value* root) {
+    const lept_pointer_token* t;
+    size_t i;
+    assert(p != NULL && root != NULL);
+    if (p->n == 0)
+        return root;
+    for (i = 0; root && i + 1 < p->n; i++)
+        root = lept_pointer_step(root, &p->t[i]);
+    if (!root)
+        return NULL;
+    t = &p->t[p->n - 1];
+    if (root->type == LEPT_OBJECT)
+        return lept_set_object_value(root, t->k, t->klen);
+    if (root->type == LEPT_ARRAY) {
+        if (t->index < root->u.a.size)
+            return &root->u.a.e[t->index];
+        if (t->index == root->u.a.size || t->index == LEPT_POINTER_END)
+            return lept_pushback_array_element(root);
+    }
+    return NULL;
+}
+
+#if 0
+JSONPath 子集
+path      = "$" *segment
+segment   = "." name / ".*" / "[" selector "]"         前面再加一个"."表示作用于结点自身及其所有后代，如 "..name" "..[0]"
+selector  = 'name' / "name" / index / "*" / [start] ":" [end] [":" step] / "?" filter
+filter    = 由 || && ! () 组合的比较 == != < <= > >=，或单独的路径（存在性测试）
+operand   = "@"或"$"起始、只含名字和下标的单值路径 / 字符串 / 数字 / true / false / null
+#endif
+
+enum { LEPT_PATH_NAME, LEPT_PATH_INDEX, LEPT_PATH_WILDCARD, LEPT_PATH_SLICE, LEPT_PATH_FILTER };
+enum { LEPT_PATH_OR, LEPT_PATH_AND, LEPT_PATH_NOT, LEPT_PATH_EXISTS, LEPT_PATH_EQ, LEPT_PATH_NE, LEPT_PATH_LT, LEPT_PATH_LE, LEPT_PATH_GT, LEPT_PATH_GE };
+
+typedef struct {
+    int type;
+    int descend;                // ".."：作用于结点自身及其所有后代
+    char* k;                    // NAME
+    size_t klen;
+    long start, end, step;      // INDEX 只用start，SLICE
+    int has_start, has_end;
+    size_t filter;              // FILTER 表达式的根
+} lept_path_step;
+
+typedef struct {
+    int root;                   // 0:"@" 1:"$" -1:字面值
+    size_t seg, nseg;           // 路径在 g[] 中的区间
+    lept_value lit;
+} lept_path_operand;
+
+typedef struct {
+    int op;
+    size_t a, b;                // 逻辑运算为子表达式下标，比较和存在性测试为操作数下标
+} lept_path_expr;
+
+struct lept_path {
+    lept_path_step* s;          // 主路径
+    size_t n, scap;
+    lept_path_step* g;          // 过滤器中的单值路径
+    size_t ng, gcap;
+    lept_path_expr* x;
+    size_t nx, xcap;
+    lept_path_operand* o;
+    size_t no, ocap;
+};
+
+typedef struct {
+    const char* p;
+    lept_path* path;
+} lept_path_context;
+
+typedef struct {
+    size_t step;                // 下一个要应用的步骤，等于步骤数时v即为结果
+    lept_value* v;
+    size_t cursor;              // 在v上的进度：先是选择器的各个候选，然后是".."要下降的子结点
+} lept_path_record;
+
+#define LEPT_PATH_GROW(a, n, cap) \
+    do {\
+        if ((n) == (cap)) {\
+            (cap) = (cap) ? (cap) + ((cap) >> 1) : 4;\
+            (a) = realloc((a), (cap) * sizeof(*(a)));\
+        }\
+    } while(0)
+
+static void lept_path_whitespace(lept_path_context* c) {
+    const char* p = c->p;
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
+        p++;
+    c->p = p;
+}
+
+// 带引号的名字或字符串字面值，转义只支持单字符形式
+static int lept_path_parse_string(lept_path_context* c, char** k, size_t* klen) {
+    const char* p;
+    char q = *c->p, *d;
+    size_t n = 0;
+    for (p = c->p + 1; *p != q; p++, n++)
+        if (*p == '\0' || (*p == '\\' && *++p == '\0'))
+            return LEPT_PARSE_MISS_QUOTATION_MARK;
+    *k = d = (char*)malloc(n + 1);
+    *klen = n;
+    for (p = c->p + 1; *p != q; p++) {
+        if (*p != '\\') {
+            *d++ = *p;
+            continue;
+        }
+        switch (*++p) {
+            case 'b': *d++ = '\b'; break;
+            case 'f': *d++ = '\f'; break;
+            case 'n': *d++ = '\n'; break;
+            case 'r': *d++ = '\r'; break;
+            case 't': *d++ = '\t'; break;
+            default:  *d++ = *p;
+        }
+    }
+    *d = '\0';
+    c->p = p + 1;
+    return LEPT_PARSE_OK;
+}
+
+static int lept_path_parse_name(lept_path_context* c, char** k, size_t* klen) {
+    const char* p = c->p;
+    while (*p != '\0' && strchr(".[]()<>=!&|'\", \t\n\r", *p) == NULL)
+        p++;
+    if (p == c->p)
+        return LEPT_PARSE_INVALID_VALUE;
+    *klen = (size_t)(p - c->p);
+    *k = (char*)malloc(*klen + 1);
+    memcpy(*k, c->p, *klen);
+    (*k)[*klen] = '\0';
+    c->p = p;
+    return LEPT_PARSE_OK;
+}
+
+static int lept_path_parse_int(lept_path_context* c, long* n) {
+    char* end;
+    if (!ISDIGIT(*c->p) && !(*c->p == '-' && ISDIGIT(c->p[1])))
+        return LEPT_PARSE_INVALID_VALUE;
+    errno = 0;
+    *n = strtol(c->p, &end, 10);
+    if (errno == ERANGE)
+        return LEPT_PARSE_NUMBER_TOO_BIG;
+    c->p = end;
+    return LEPT_PARSE_OK;
+}
+
+static int lept_path_parse_or(lept_path_context* c, size_t* x);
+
+// 解析一个步骤，filter为0时不允许过滤器（用于单值路径）
+static int lept_path_parse_step(lept_path_context* c, lept_path_step* s, int filter) {
+    int ret;
+    memset(s, 0, sizeof(*s));
+    s->step = 1;
+    if (c->p[0] == '.' && c->p[1] == '.') {
+        s->descend = 1;
+        c->p++;
+    }
+    if (*c->p == '.') {
+        c->p++;
+        if (*c->p == '[' && s->descend)
+            ;
+        else if (*c->p == '*') {
+            c->p++;
+            s->type = LEPT_PATH_WILDCARD;
+            return LEPT_PARSE_OK;
+        }
+        else {
+            s->type = LEPT_PATH_NAME;
+            return lept_path_parse_name(c, &s->k, &s->klen);
+        }
+    }
+    if (*c->p++ != '[')
+        return LEPT_PARSE_INVALID_VALUE;
+    lept_path_whitespace(c);
+    if (*c->p == '\'' || *c->p == '"') {
+        s->type = LEPT_PATH_NAME;
+        if ((ret = lept_path_parse_string(c, &s->k, &s->klen)) != LEPT_PARSE_OK)
+            return ret;
+    }
+    else if (*c->p == '*') {
+        c->p++;
+        s->type = LEPT_PATH_WILDCARD;
+    }
+    else if (*c->p == '?' && filter) {
+        c->p++;
+        s->type = LEPT_PATH_FILTER;
+        if ((ret = lept_path_parse_or(c, &s->filter)) != LEPT_PARSE_OK)
+            return ret;
+    }
+    else {
+        s->type = LEPT_PATH_INDEX;
+        if ((s->has_start = (*c->p != ':')) && (ret = lept_path_parse_int(c, &s->start)) != LEPT_PARSE_OK)
+            return ret;
+        lept_path_whitespace(c);
+        if (*c->p == ':') {
+            c->p++;
+            s->type = LEPT_PATH_SLICE;
+            lept_path_whitespace(c);
+            if ((s->has_end = (*c->p != ':' && *c->p != ']')) && (ret = lept_path_parse_int(c, &s->end)) != LEPT_PARSE_OK)
+                return ret;
+            lept_path_whitespace(c);
+            if (*c->p == ':') {
+                c->p++;
+                lept_path_whitespace(c);
+                // 只支持正的步长
+                if (*c->p != ']' && ((ret = lept_path_parse_int(c, &s->step)) != LEPT_PARSE_OK || s->step <= 0))
+                    return LEPT_PARSE_INVALID_VALUE;
+            }
+        }
+    }
+    lept_path_whitespace(c);
+    return *c->p++ == ']' ? LEPT_PARSE_OK : LEPT_PARSE_INVALID_VALUE;
+}
+
+static int lept_path_parse_operand(lept_path_context* c, size_t* o) {
+    lept_path* path = c->path;
+    lept_path_operand* po;
+    int ret = LEPT_PARSE_OK;
+    lept_path_whitespace(c);
+    LEPT_PATH_GROW(path->o, path->no, path->ocap);
+    po = &path->o[*o = path->no++];
+    lept_init(&po->lit);
+    po->root = -1;
+    po->seg = path->ng;
+    po->nseg = 0;
+    if (*c->p == '@' || *c->p == '$') {
+        po->root = *c->p++ == '$';
+        while (ret == LEPT_PARSE_OK && (*c->p == '.' || *c->p == '[')) {
+            lept_path_step s;
+            ret = lept_path_parse_step(c, &s, 0);
+            LEPT_PATH_GROW(path->g, path->ng, path->gcap);
+            path->g[path->ng++] = s;
+            // 过滤器中只允许单值路径
+            if (ret == LEPT_PARSE_OK && (s.descend || (s.type != LEPT_PATH_NAME && s.type != LEPT_PATH_INDEX)))
+                ret = LEPT_PARSE_INVALID_VALUE;
+        }
+        po = &path->o[*o];
+        po->nseg = path->ng - po->seg;
+    }
+    else if (*c->p == '\'' || *c->p == '"') {
+        if ((ret = lept_path_parse_string(c, &po->lit.u.s.s, &po->lit.u.s.len)) == LEPT_PARSE_OK) {
+            po->lit.u.s.borrowed = 0;
+            po->lit.type = LEPT_STRING;
+        }
+    }
+    else if (strncmp(c->p, "true", 4) == 0 || strncmp(c->p, "null", 4) == 0) {
+        po->lit.type = *c->p == 't' ? LEPT_TRUE : LEPT_NULL;
+        c->p += 4;
+    }
+    else if (strncmp(c->p, "false", 5) == 0) {
+        po->lit.type = LEPT_FALSE;
+        c->p += 5;
+    }
+    else if (ISDIGIT(*c->p) || (*c->p == '-' && ISDIGIT(c->p[1]))) {
+        char* end;
+        po->lit.u.n = strtod(c->p, &end);
+        po->lit.type = LEPT_NUMBER;
+        c->p = end;
+    }
+    else
+        ret = LEPT_PARSE_INVALID_VALUE;
+    return ret;
+}
+
+static size_t lept_path_expr_new(lept_path* path, int op, size_t a, size_t b) {
+    LEPT_PATH_GROW(path->x, path->nx, path->xcap);
+    path->x[path->nx].op = op;
+    path->x[path->nx].a = a;
+    path->x[path->nx].b = b;
+    return path->nx++;
+}
+
+static int lept_path_parse_unary(lept_path_context* c, size_t* x) {
+    static const char* ops[] = { "==", "!=", "<=", ">=", "<", ">" };
+    static const int codes[] = { LEPT_PATH_EQ, LEPT_PATH_NE, LEPT_PATH_LE, LEPT_PATH_GE, LEPT_PATH_LT, LEPT_PATH_GT };
+    size_t a, b, i;
+    int ret;
+    lept_path_whitespace(c);
+    if (*c->p == '!') {
+        c->p++;
+        if ((ret = lept_path_parse_unary(c, &a)) != LEPT_PARSE_OK)
+            return ret;
+        *x = lept_path_expr_new(c->path, LEPT_PATH_NOT, a, 0);
+        return LEPT_PARSE_OK;
+    }
+    if (*c->p == '(') {
+        c->p++;
+        if ((ret = lept_path_parse_or(c, x)) != LEPT_PARSE_OK)
+            return ret;
+        lept_path_whitespace(c);
+        return *c->p++ == ')' ? LEPT_PARSE_OK : LEPT_PARSE_INVALID_VALUE;
+    }
+    if ((ret = lept_path_parse_operand(c, &a)) != LEPT_PARSE_OK)
+        return ret;
+    lept_path_whitespace(c);
+    for (i = 0; i < sizeof(ops) / sizeof(ops[0]); i++)
+        if (strncmp(c->p, ops[i], strlen(ops[i])) == 0) {
+            c->p += strlen(ops[i]);
+            if ((ret = lept_path_parse_operand(c, &b)) != LEPT_PARSE_OK)
+                return ret;
+            *x = lept_path_expr_new(c->path, codes[i], a, b);
+            return LEPT_PARSE_OK;
+        }
+    // 单独的字面值没有意义
+    if (c->path->o[a].root < 0)
+        return LEPT_PARSE_INVALID_VALUE;
+    *x = lept_path_expr_new(c->path, LEPT_PATH_EXISTS, a, 0);
+    return LEPT_PARSE_OK;
+}
+
+static int lept_path_parse_and(lept_path_context* c, size_t* x) {
+    size_t b;
+    int ret;
+    if ((ret = lept_path_parse_unary(c, x)) != LEPT_PARSE_OK)
+        return ret;
+    for (lept_path_whitespace(c); c->p[0] == '&' && c->p[1] == '&'; lept_path_whitespace(c)) {
+        c->p += 2;
+        if ((ret = lept_path_parse_unary(c, &b)) != LEPT_PARSE_OK)
+            return ret;
+        *x = lept_path_expr_new(c->path, LEPT_PATH_AND, *x, b);
+    }
+    return LEPT_PARSE_OK;
+}
+
+static int lept_path_parse_or(lept_path_context* c, size_t* x) {
+    size_t b;
+    int ret;
+    if ((ret = lept_path_parse_and(c, x)) != LEPT_PARSE_OK)
+        return ret;
+    for (lept_path_whitespace(c); c->p[0] == '|' && c->p[1] == '|'; lept_path_whitespace(c)) {
+        c->p += 2;
+        if ((ret = lept_path_parse_and(c, &b)) != LEPT_PARSE_OK)
+            return ret;
+        *x = lept_path_expr_new(c->path, LEPT_PATH_OR, *x, b);
+    }
+    return LEPT_PARSE_OK;
+}
+
+lept_path* lept_path_compile(const char* query) {
+    lept_path_context c;
+    int ret = LEPT_PARSE_OK;
+    assert(query != NULL);
+    c.p = query;
+    c.path = (lept_path*)calloc(1, sizeof(lept_path));
+    lept_path_whitespace(&c);
+    if (*c.p == '$')
+        c.p++;
+    else
+        ret = LEPT_PARSE_INVALID_VALUE;
+    while (ret == LEPT_PARSE_OK && *c.p != '\0' && *c.p != ' ' && *c.p != '\t' && *c.p != '\n' && *c.p != '\r') {
+        lept_path_step s;
+        ret = lept_path_parse_step(&c, &s, 1);
+        LEPT_PATH_GROW(c.path->s, c.path->n, c.path->scap);
+        c.path->s[c.path->n++] = s;
+    }
+    if (ret == LEPT_PARSE_OK)
+        lept_path_whitespace(&c);
+    if (ret != LEPT_PARSE_OK || *c.p != '\0') {
+        lept_path_free(c.path);
+        return NULL;
+    }
+    return c.path;
+}
+
+void lept_path_free(lept_path* path) {
+    size_t i;
+    if (path == NULL)
+        return;
+    for (i = 0; i < path->n; i++)
+        free(path->s[i].k);
+    for (i = 0; i < path->ng; i++)
+        free(path->g[i].k);
+    for (i = 0; i < path->no; i++)
+        lept_free(&path->o[i].lit);
+    free(path->s);
+    free(path->g);
+    free(path->x);
+    free(path->o);
+    free(path);
+}
+
+static size_t lept_path_size(const lept_value* v) {
+    return v->type == LEPT_ARRAY ? v->u.a.size : v->type == LEPT_OBJECT ? v->u.o.size : 0;
+}
+
+// 查询结果是可写的：名字、下标、通配、切片、过滤每一步都先经 lept_touch 分离共享的存储
+static lept_value* lept_path_child(lept_value* v, size_t i) {
+    lept_touch(v);
+    return v->type == LEPT_ARRAY ? &v->u.a.e[i] : &v->u.o.m[i].v;
+}
+
+static lept_value* lept_path_step_name(lept_value* v, const lept_path_step* s) {
+    size_t i;
+    if (v->type != LEPT_OBJECT)
+        return NULL;
+    i = lept_object_lookup(v, s->k, s->klen);
+    return i != LEPT_KEY_NOT_EXIST ? &v->u.o.m[i].v : NULL;
+}
+
+static lept_value* lept_path_step_index(lept_value* v, long i) {
+    if (v->type != LEPT_ARRAY)
+        return NULL;
+    lept_touch(v);
+    if (i < 0)
+        i += (long)v->u.a.size;
+    return i >= 0 && (size_t)i < v->u.a.size ? &v->u.a.e[i] : NULL;
+}
+
+// 切片的起点和元素个数，起止位置规范化到[0, size]
+static size_t lept_path_slice(const lept_path_step* s, const lept_value* v, size_t* start) {
+    long size, b, e;
+    if (v->type != LEPT_ARRAY)
+        return 0;
+    size = (long)v->u.a.size;
+    b = s->has_start ? (s->start < 0 ? s->start + size : s->start) : 0;
+    e = s->has_end ? (s->end < 0 ? s->end + size : s->end) : size;
+    b = b < 0 ? 0 : b > size ? size : b;
+    e = e < 0 ? 0 : e > size ? size : e;
+    *start = (size_t)b;
+    return e > b ? (size_t)((e - b + s->step - 1) / s->step) : 0;
+}
+
+static const lept_value* lept_path_operand_value(const lept_path* path, size_t o, lept_value* cur, lept_value* root) {
+    const lept_path_operand* po = &path->o[o];
+    lept_value* v;
+    size_t i;
+    if (po->root < 0)
+        return &po->lit;
+    v = po->root ? root : cur;
+    for (i = 0; v && i < po->nseg; i++) {
+        const lept_path_step* s = &path->g[po->seg + i];
+        v = s->type == LEPT_PATH_NAME ? lept_path_step_name(v, s) : lept_path_step_index(v, s->start);
+    }
+    return v;
+}
+
+// 比较，不存在的值只与不存在相等；大小只在数字之间或字符串之间（按字节序）比较
+static int lept_path_compare(int op, const lept_value* a, const lept_value* b) {
+    const lept_value* t;
+    int r;
+    size_t n;
+    if (op == LEPT_PATH_NE)
+        return !lept_path_compare(LEPT_PATH_EQ, a, b);
+    if (op == LEPT_PATH_GT || op == LEPT_PATH_GE) {
+        t = a, a = b, b = t;
+        op = op == LEPT_PATH_GT ? LEPT_PATH_LT : LEPT_PATH_LE;
+    }
+    if (a == NULL || b == NULL)
+        return op != LEPT_PATH_LT && a == b;
+    if (op != LEPT_PATH_LT && lept_is_equal(a, b))
+        return 1;
+    if (op == LEPT_PATH_EQ)
+        return 0;
+    if (a->type == LEPT_NUMBER && b->type == LEPT_NUMBER)
+        return a->u.n < b->u.n;
+    if (a->type == LEPT_STRING && b->type == LEPT_STRING) {
+        n = a->u.s.len < b->u.s.len ? a->u.s.len : b->u.s.len;
+        r = memcmp(a->u.s.s, b->u.s.s, n);
+        return r < 0 || (r == 0 && a->u.s.len < b->u.s.len);
+    }
+    return 0;
+}
+
+static int lept_path_test(const lept_path* path, size_t x, lept_value* cur, lept_value* root) {
+    const lept_path_expr* e = &path->x[x];
+    switch (e->op) {
+        case LEPT_PATH_OR:     return lept_path_test(path, e->a, cur, root) || lept_path_test(path, e->b, cur, root);
+        case LEPT_PATH_AND:    return lept_path_test(path, e->a, cur, root) && lept_path_test(path, e->b, cur, root);
+        case LEPT_PATH_NOT:    return !lept_path_test(path, e->a, cur, root);
+        case LEPT_PATH_EXISTS: return lept_path_operand_value(path, e->a, cur, root) != NULL;
+        default:
+            return lept_path_compare(e->op, lept_path_operand_value(path, e->a, cur, root), lept_path_operand_value(path, e->b, cur, root));
+    }
+}
+
+static void lept_path_push(lept_path_iter* it, size_t step, lept_value* v) {
+    lept_path_record* r;
+    if (it->top + sizeof(lept_path_record) > it->size) {
+        it->size = it->size ? it->size + (it->size >> 1) : LEPT_PARSE_STACK_INIT_SIZE;
+        it->stack = (char*)realloc(it->stack, it->size);
+    }
+    r = (lept_path_record*)(it->stack + it->top);
+    r->step = step;
+    r->v = v;
+    r->cursor = 0;
+    it->top += sizeof(lept_path_record);
+}
+
+void lept_path_iter_begin(lept_path_iter* it, const lept_path* path, lept_value* root) {
+    assert(it != NULL && path != NULL && root != NULL);
+    it->path = path;
+    it->root = root;
+    it->top = 0;
+    lept_path_push(it, 0, root);
+}
+
+lept_value* lept_path_iter_next(lept_path_iter* it) {
+    const lept_path* path = it->path;
+    while (it->top > 0) {
+        lept_path_record* r = (lept_path_record*)(it->stack + it->top) - 1;
+        lept_value* v = r->v, *child = NULL;
+        const lept_path_step* s;
+        size_t n, i, start = 0;
+        if (r->step == path->n) {
+            it->top -= sizeof(lept_path_record);
+            return v;
+        }
+        s = &path->s[r->step];
+        switch (s->type) {
+            case LEPT_PATH_NAME:
+            case LEPT_PATH_INDEX: n = 1; break;
+            case LEPT_PATH_SLICE: n = lept_path_slice(s, v, &start); break;
+            default:              n = lept_path_size(v);
+        }
+        if (r->cursor < n) {
+            i = r->cursor++;
+            switch (s->type) {
+                case LEPT_PATH_NAME:  child = lept_path_step_name(v, s); break;
+                case LEPT_PATH_INDEX: child = lept_path_step_index(v, s->start); break;
+                case LEPT_PATH_SLICE: child = lept_path_child(v, start + i * (size_t)s->step); break;
+                case LEPT_PATH_WILDCARD: child = lept_path_child(v, i); break;
+                default:
+                    child = lept_path_child(v, i);
+                    if (!lept_path_test(path, s->filter, child, it->root))
+                        child = NULL;
+            }
+            if (child)
+                lept_path_push(it, r->step + 1, child);
+        }
+        else if (s->descend && r->cursor - n < lept_path_size(v)) {
+            // 同一步骤继续作用于每个子结点
+            child = lept_path_child(v, r->cursor++ - n);
+            lept_path_push(it, r->step, child);
+        }
+        else
+            it->top -= sizeof(lept_path_record);
+    }
+    return NULL;
+}
+
+void lept_path_iter_free(lept_path_iter* it) {
+    assert(it != NULL);
+    free(it->stack);
+    it->stack = NULL;
+    it->size = it->top = 0;
+}
+
+// JSON Patch 的撤销记录，出错时逆序回放。容器的地址可能因之后的扩容而改变，所以记录路径，回放时重新定位
+enum { LEPT_UNDO_ADDED, LEPT_UNDO_REMOVED, LEPT_UNDO_REPLACED };
+
+typedef struct {
+    const lept_pointer* p;  // ADDED/REMOVED 的容器是p的上层，REPLACED 的位置就是p
+    int kind;
+    int moved;              // REMOVED 的值被 move 操作带走，回放时使用上一步摘下的值
+    size_t index;           // ADDED/REMOVED 在容器中的下标
+    char* k;                // REMOVED 的对象成员的键
+    size_t klen;
+    lept_value v;           // REMOVED/REPLACED 的原值
+} lept_patch_undo;
+
+static lept_value* lept_pointer_parent(const lept_pointer* p, lept_value* root) {
+    size_t i;
+    assert(p->n > 0);
+    for (i = 0; root && i + 1 < p->n; i++)
+        root = lept_pointer_step(root, &p->t[i]);
+    return root;
+}
+
+static lept_patch_undo* lept_patch_log(lept_context* c, const lept_pointer* p, int kind, size_t index) {
+    lept_patch_undo* u = (lept_patch_undo*)lept_context_push(c, sizeof(lept_patch_undo));
+    u->p = p;
+    u->kind = kind;
+    u->moved = 0;
+    u->index = index;
+    u->k = NULL;
+    u->klen = 0;
+    lept_init(&u->v);
+    return u;
+}
+
+// 在容器的index处插入值（对象需要键，键的所有权转移给容器）
+static void lept_patch_insert(lept_value* parent, size_t index, char* k, size_t klen, lept_value* v) {
+    lept_touch_keys(parent);
+    if (parent->type == LEPT_ARRAY) {
+        lept_move(lept_insert_array_element(parent, index), v);
+        return;
+    }
+    if (parent->u.o.size == parent->u.o.capacity)
+        lept_reserve_object(parent, parent->u.o.capacity == 0 ? 1 : parent->u.o.capacity << 1);
+    memmove(parent->u.o.m + index + 1, parent->u.o.m + index, (parent->u.o.size - index) * sizeof(lept_member));
+    parent->u.o.m[index].k = k;
+    parent->u.o.m[index].klen = klen;
+    memcpy(&parent->u.o.m[index].v, v, sizeof(lept_value));
+    lept_init(v);
+    parent->u.o.size++;
+}
+
+// 从容器中摘下index处的值（和键），不释放
+static void lept_patch_detach(lept_value* parent, size_t index, char** k, size_t* klen, lept_value* v) {
+    lept_touch_keys(parent);
+    if (parent->type == LEPT_ARRAY) {
+        memcpy(v, &parent->u.a.e[index], sizeof(lept_value));
+        memmove(parent->u.a.e + index, parent->u.a.e + index + 1, (parent->u.a.size - index - 1) * sizeof(lept_value));
+        parent->u.a.size--;
+        return;
+    }
+    *k = parent->u.o.m[index].k;
+    *klen = parent->u.o.m[index].klen;
+    memcpy(v, &parent->u.o.m[index].v, sizeof(lept_value));
+    memmove(parent->u.o.m + index, parent->u.o.m + index + 1, (parent->u.o.size - index - 1) * sizeof(lept_member));
+    parent->u.o.size--;
+}
+
+// replace：p所指的值已确认存在，与v交换
+static void lept_patch_replace(lept_context* c, lept_value* doc, const lept_pointer* p, lept_value* v) {
+    lept_swap(lept_pointer_get(p, doc), v);
+    lept_move(&lept_patch_log(c, p, LEPT_UNDO_REPLACED, 0)->v, v);
+}
+
+// add：把v移入p所指的位置
+static int lept_patch_add(lept_context* c, lept_value* doc, const lept_pointer* p, lept_value* v) {
+    const lept_pointer_token* t;
+    lept_value* parent;
+    size_t index;
+    if (p->n == 0) {
+        lept_patch_replace(c, doc, p, v);
+        return LEPT_PATCH_OK;
+    }
+    if ((parent = lept_pointer_parent(p, doc)) == NULL)
+        return LEPT_PATCH_PATH_NOT_FOUND;
+    t = &p->t[p->n - 1];
+    if (parent->type == LEPT_OBJECT) {
+        if (lept_object_lookup(parent, t->k, t->klen) != LEPT_KEY_NOT_EXIST)
+            lept_patch_replace(c, doc, p, v);
+        else {
+            lept_move(lept_set_object_value(parent, t->k, t->klen), v);
+            lept_patch_log(c, p, LEPT_UNDO_ADDED, parent->u.o.size - 1);
+        }
+        return LEPT_PATCH_OK;
+    }
+    if (parent->type != LEPT_ARRAY)
+        return LEPT_PATCH_PATH_NOT_FOUND;
+    index = t->index == LEPT_POINTER_END ? parent->u.a.size : t->index;
+    if (index > parent->u.a.size)
+        return LEPT_PATCH_PATH_NOT_FOUND;
+    lept_patch_insert(parent, index, NULL, 0, v);
+    lept_patch_log(c, p, LEPT_UNDO_ADDED, index);
+    return LEPT_PATCH_OK;
+}
+
+// remove：摘下p所指的值，保存在撤销记录中
+static int lept_patch_remove(lept_context* c, lept_value* doc, const lept_pointer* p, int moved) {
+    const lept_pointer_token* t;
+    lept_value* parent;
+    lept_patch_undo* u;
+    size_t index;
+    if (p->n == 0)
+        return LEPT_PATCH_INVALID_OPERATION;
+    if ((parent = lept_pointer_parent(p, doc)) == NULL)
+        return LEPT_PATCH_PATH_NOT_FOUND;
+    t = &p->t[p->n - 1];
+    if (parent->type == LEPT_OBJECT)
+        index = lept_object_lookup(parent, t->k, t->klen);
+    else if (parent->type == LEPT_ARRAY)
+        index = t->index < parent->u.a.size ? t->index : LEPT_KEY_NOT_EXIST;
+    else
+        index = LEPT_KEY_NOT_EXIST;
+    if (index == LEPT_KEY_NOT_EXIST)
+        return LEPT_PATCH_PATH_NOT_FOUND;
+    u = lept_patch_log(c, p, LEPT_UNDO_REMOVED, index);
+    u->moved = moved;
+    lept_patch_detach(parent, index, &u->k, &u->klen, &u->v);
+    return LEPT_PATCH_OK;
+}
+
+// 逆序回放全部撤销记录，每一步摘下的当前值放在carry中，供 move 的 REMOVED 记录取回
+static void lept_patch_rollback(lept_context* c, lept_value* doc) {
+    lept_value carry, *slot;
+    lept_init(&carry);
+    while (c->top > 0) {
+        lept_patch_undo* u = (lept_patch_undo*)lept_context_pop(c, sizeof(lept_patch_undo));
+        switch (u->kind) {
+            case LEPT_UNDO_ADDED: {
+                char* k = NULL;
+                size_t klen;
+                lept_free(&carry);
+                lept_patch_detach(lept_pointer_parent(u->p, doc), u->index, &k, &klen, &carry);
+                lept_key_free(k);
+                break;
+            }
+            case LEPT_UNDO_REMOVED:
+                lept_patch_insert(lept_pointer_parent(u->p, doc), u->index, u->k, u->klen, u->moved ? &carry : &u->v);
+                break;
+            default:
+                slot = lept_pointer_get(u->p, doc);
+                lept_swap(slot, &u->v);
+                lept_move(&carry, &u->v);
+        }
+    }
+    lept_free(&carry);
+}
+
+static const lept_value* lept_patch_member(const lept_value* op, const char* key, size_t klen) {
+    size_t index = lept_find_object_index(op, key, klen);
+    return index != LEPT_KEY_NOT_EXIST ? &op->u.o.m[index].v : NULL;
+}
+
+// 取出操作中作为指针的字段并编译，编译结果保存在ptrs栈中，到补丁结束时才释放
+static int lept_patch_pointer(lept_context* ptrs, const lept_value* op, const char* key, const lept_pointer** p) {
+    const lept_value* s = lept_patch_member(op, key, strlen(key));
+    if (s == NULL || s->type != LEPT_STRING || (*p = lept_pointer_compile(s->u.s.s, s->u.s.len)) == NULL)
+        return LEPT_PATCH_INVALID_OPERATION;
+    *(const lept_pointer**)lept_context_push(ptrs, sizeof(lept_pointer*)) = *p;
+    return LEPT_PATCH_OK;
+}
+
+// from是否是path的真前缀，即把值移入它自己的内部
+static int lept_pointer_is_prefix(const lept_pointer* from, const lept_pointer* path) {
+    size_t i;
+    if (from->n >= path->n)
+        return 0;
+    for (i = 0; i < from->n; i++)
+        if (from->t[i].klen != path->t[i].klen || memcmp(from->t[i].k, path->t[i].k, from->t[i].klen) != 0)
+            return 0;
+    return 1;
+}
+
+static int lept_patch_operation(lept_context* c, lept_context* ptrs, lept_value* doc, const lept_value* op) {
+    const lept_pointer* path, *from;
+    const lept_value* name, *value;
+    lept_value* target, temp;
+    lept_patch_undo* u;
+    int ret;
+    if (op->type != LEPT_OBJECT)
+        return LEPT_PATCH_INVALID_OPERATION;
+    name = lept_patch_member(op, "op", 2);
+    value = lept_patch_member(op, "value", 5);
+    if (name == NULL || name->type != LEPT_STRING || (ret = lept_patch_pointer(ptrs, op, "path", &path)) != LEPT_PATCH_OK)
+        return LEPT_PATCH_INVALID_OPERATION;
+    target = lept_pointer_get(path, doc);
+#define OP_IS(str) (name->u.s.len == sizeof(str) - 1 && memcmp(name->u.s.s, str, sizeof(str) - 1) == 0)
+    if (OP_IS("add") || OP_IS("replace")) {
+        if (value == NULL)
+            return LEPT_PATCH_INVALID_OPERATION;
+        if (target == NULL && OP_IS("replace"))
+            return LEPT_PATCH_PATH_NOT_FOUND;
+        lept_init(&temp);
+        lept_copy(&temp, value);
+        if (target != NULL && OP_IS("replace")) {
+            lept_patch_replace(c, doc, path, &temp);
+            ret = LEPT_PATCH_OK;
+        }
+        else
+            ret = lept_patch_add(c, doc, path, &temp);
+        lept_free(&temp);
+        return ret;
+    }
+    if (OP_IS("remove"))
+        return lept_patch_remove(c, doc, path, 0);
+    if (OP_IS("test")) {
+        if (value == NULL)
+            return LEPT_PATCH_INVALID_OPERATION;
+        if (target == NULL)
+            return LEPT_PATCH_PATH_NOT_FOUND;
+        return lept_is_equal(target, value) ? LEPT_PATCH_OK : LEPT_PATCH_TEST_FAILED;
+    }
+    if (OP_IS("move") || OP_IS("copy")) {
+        if ((ret = lept_patch_pointer(ptrs, op, "from", &from)) != LEPT_PATCH_OK)
+            return ret;
+        if ((target = lept_pointer_get(from, doc)) == NULL)
+            return LEPT_PATCH_PATH_NOT_FOUND;
+        lept_init(&temp);
+        if (OP_IS("copy"))
+            lept_copy(&temp, target);
+        else if (lept_pointer_is_prefix(from, path))
+            return LEPT_PATCH_INVALID_OPERATION;
+        else if (lept_pointer_get(path, doc) == target)
+            return LEPT_PATCH_OK;   // 移到原处
+        else {
+            // 值先移入撤销记录，再从那里移到新位置
+            if ((ret = lept_patch_remove(c, doc, from, 1)) != LEPT_PATCH_OK)
+                return ret;
+            u = (lept_patch_undo*)(c->stack + c->top) - 1;
+            lept_move(&temp, &u->v);
+            if ((ret = lept_patch_add(c, doc, path, &temp)) != LEPT_PATCH_OK) {
+                u = (lept_patch_undo*)(c->stack + c->top) - 1;
+                lept_move(&u->v, &temp);
+                u->moved = 0;
+            }
+            return ret;
+        }
+        ret = lept_patch_add(c, doc, path, &temp);
+        lept_free(&temp);
+        return ret;
+    }
+#undef OP_IS
+    return LEPT_PATCH_INVALID_OPERATION;
+}
+
+int lept_patch_apply(lept_value* doc, const lept_value* patch) {
+    lept_context c, ptrs;
+    size_t i;
+    int ret = LEPT_PATCH_OK;
+    assert(doc != NULL && patch != NULL);
+    if (patch->type != LEPT_ARRAY)
+        return LEPT_PATCH_INVALID_OPERATION;
+    memset(&c, 0, sizeof(c));
+    memset(&ptrs, 0, sizeof(ptrs));
+    for (i = 0; i < patch->u.a.size && ret == LEPT_PATCH_OK; i++)
+        ret = lept_patch_operation(&c, &ptrs, doc, &patch->u.a.e[i]);
+    // 整个补丁要么全部生效，要么全部撤销
+    if (ret != LEPT_PATCH_OK)
+        lept_patch_rollback(&c, doc);
+    while (c.top > 0) {
+        lept_patch_undo* u = (lept_patch_undo*)lept_context_pop(&c, sizeof(lept_patch_undo));
+        lept_key_free(u->k);
+        lept_free(&u->v);
+    }
+    while (ptrs.top > 0)
+        lept_pointer_free(*(lept_pointer**)lept_context_pop(&ptrs, sizeof(lept_pointer*)));
+    free(c.stack);
+    free(ptrs.stack);
+    return ret;
+}
+
+// RFC 7396：补丁中的null删除成员，对象逐层合并，其余值整体替换
+// 先处理完同一对象的所有成员（期间容器可能扩容），再把要继续合并的子对象压栈，保证栈中指针有效
+void lept_merge_patch(lept_value* target, const lept_value* patch) {
+    lept_context c;
+    lept_value* t, **task;
+    const lept_value* p;
+    size_t i, index;
+    assert(target != NULL && patch != NULL);
+    memset(&c, 0, sizeof(c));
+    t = target;
+    p = patch;
+    for (;;) {
+        if (p->type != LEPT_OBJECT)
+            lept_copy(t, p);
+        else {
+            if (t->type != LEPT_OBJECT)
+                lept_set_object(t, p->u.o.size);
+            for (i = 0; i < p->u.o.size; i++) {
+                const lept_member* m = &p->u.o.m[i];
+                if (m->v.type == LEPT_NULL) {
+                    if ((index = lept_object_lookup(t, m->k, m->klen)) != LEPT_KEY_NOT_EXIST)
+                        lept_remove_object_value(t, index);
+                }
+                else if (m->v.type != LEPT_OBJECT)
+                    lept_copy(lept_set_object_value(t, m->k, m->klen), &m->v);
+                else
+                    lept_set_object_value(t, m->k, m->klen);
+            }
+            for (i = 0; i < p->u.o.size; i++)
+                if (p->u.o.m[i].v.type == LEPT_OBJECT) {
+                    task = (lept_value**)lept_context_push(&c, 2 * sizeof(lept_value*));
+                    task[0] = lept_find_object_value(t, p->u.o.m[i].k, p->u.o.m[i].klen);
+                    task[1] = (lept_value*)&p->u.o.m[i].v;
+                }
+        }
+        if (c.top == 0)
+            break;
+        task = (lept_value**)lept_context_pop(&c, 2 * sizeof(lept_value*));
+        t = task[0];
+        p = task[1];
+    }
+    free(c.stack);
+}
+
+// 子树哈希：对象与成员顺序无关，与 lept_is_equal() 一致
+static uint64_t lept_hash_mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static uint64_t lept_hash_scalar(const lept_value* v) {
+    uint64_t h = lept_fnv1a(LEPT_FNV_OFFSET, &v->type, sizeof(v->type));
+    double n;
+    if (v->type == LEPT_NUMBER) {
+        n = v->u.n == 0.0 ? 0.0 : v->u.n;   // -0 == 0
+        h = lept_fnv1a(h, &n, sizeof(n));
+    }
+    else if (v->type == LEPT_STRING)
+        h = lept_fnv1a(h, v->u.s.s, v->u.s.len);
+    return lept_hash_mix(h);
+}
+
+// 数组按顺序合并子结点的哈希，对象把各成员（键和值）的哈希相加
+static uint64_t lept_hash_combine(const lept_value* v, uint64_t h, size_t i, uint64_t child) {
+    if (v->type == LEPT_ARRAY)
+        return lept_hash_mix(h ^ child) + i;
+    return h + lept_hash_mix(lept_fnv1a(LEPT_FNV_OFFSET, v->u.o.m[i].k, v->u.o.m[i].klen) ^ child);
+}
+
+typedef struct {
+    uint64_t hash;
+    size_t count;       // 子树的结点数（含自身），先序中下一个兄弟在 i + count
+} lept_diff_node;
+
+typedef struct {
+    const lept_value* v;
+    size_t index;       // 先序编号
+    size_t cursor;
+} lept_diff_frame;
+
+static const lept_value* lept_diff_child(const lept_value* v, size_t i) {
+    return v->type == LEPT_ARRAY ? &v->u.a.e[i] : &v->u.o.m[i].v;
+}
+
+static size_t lept_diff_size(const lept_value* v) {
+    return v->type == LEPT_ARRAY ? v->u.a.size : v->type == LEPT_OBJECT ? v->u.o.size : 0;
+}
+
+// 对树做先序编号并计算每个子树的哈希和结点数，结果放在 nodes 栈中
+static void lept_diff_index(lept_context* nodes, lept_context* frames, const lept_value* root) {
+    lept_diff_frame* f;
+    lept_diff_node* n;
+    const lept_value* v = root;
+    size_t i, child;
+    uint64_t h;
+    for (;;) {
+        // 进入结点v
+        n = (lept_diff_node*)lept_context_push(nodes, sizeof(lept_diff_node));
+        n->count = 1;
+        if (v->type == LEPT_ARRAY || v->type == LEPT_OBJECT) {
+            f = (lept_diff_frame*)lept_context_push(frames, sizeof(lept_diff_frame));
+            f->v = v;
+            f->index = nodes->top / sizeof(lept_diff_node) - 1;
+            f->cursor = 0;
+        }
+        else
+            n->hash = lept_hash_scalar(v);
+        // 完成所有子结点都已编号的容器，直到找到下一个要进入的结点
+        for (;;) {
+            if (frames->top == 0)
+                return;
+            f = (lept_diff_frame*)(frames->stack + frames->top) - 1;
+            if (f->cursor < lept_diff_size(f->v)) {
+                v = lept_diff_child(f->v, f->cursor++);
+                break;
+            }
+            n = (lept_diff_node*)nodes->stack;
+            h = lept_hash_mix(LEPT_FNV_OFFSET ^ (uint64_t)f->v->type);
+            for (i = 0, child = f->index + 1; i < lept_diff_size(f->v); child += n[child].count, i++)
+                h = lept_hash_combine(f->v, h, i, n[child].hash);
+            n[f->index].hash = h;
+            n[f->index].count = nodes->top / sizeof(lept_diff_node) - f->index;
+            lept_context_pop(frames, sizeof(lept_diff_frame));
+        }
+    }
+}
+
+typedef struct {
+    const lept_value* a, *b;
+    size_t ai, bi;      // 先序编号
+    size_t off, len;    // 路径在 paths 中的位置
+} lept_diff_task;
+
+// 在 paths 栈顶生成 off/len 所指路径加上一个令牌的新路径，k为NULL时令牌为数组下标
+static size_t lept_diff_path(lept_context* paths, size_t off, size_t len, const char* k, size_t klen, size_t index) {
+    size_t head = paths->top, i;
+    char buffer[32];
+    if (len > 0) {
+        char* d = (char*)lept_context_push(paths, len);  // 先扩容，再取源地址
+        memcpy(d, paths->stack + off, len);
+    }
+    PUTC(paths, '/');
+    if (k == NULL) {
+        i = (size_t)sprintf(buffer, "%lu", (unsigned long)index);
+        PUTS(paths, buffer, i);
+    }
+    else
+        for (i = 0; i < klen; i++)
+            if (k[i] == '~' || k[i] == '/') {
+                PUTC(paths, '~');
+                PUTC(paths, k[i] == '~' ? '0' : '1');
+            }
+            else
+                PUTC(paths, k[i]);
+    return head;
+}
+
+static void lept_diff_emit(lept_value* patch, const char* op, const lept_context* paths, size_t off, const lept_value* value) {
+    lept_value* o = lept_pushback_array_element(patch);
+    lept_set_object(o, value ? 3 : 2);
+    lept_set_string(lept_set_object_value(o, "op", 2), op, strlen(op));
+    lept_set_string(lept_set_object_value(o, "path", 4), paths->stack + off, paths->top - off);
+    if (value)
+        lept_copy(lept_set_object_value(o, "value", 5), value);
+}
+
+static void lept_diff_push(lept_context* tasks, const lept_context* paths, const lept_value* a, const lept_value* b, size_t ai, size_t bi, size_t off) {
+    lept_diff_task* t = (lept_diff_task*)lept_context_push(tasks, sizeof(lept_diff_task));
+    t->a = a;
+    t->b = b;
+    t->ai = ai;
+    t->bi = bi;
+    t->off = off;
+    t->len = paths->top - off;
+}
+
+// 容器各子结点的先序编号
+static size_t* lept_diff_children(lept_context* scratch, const lept_diff_node* nodes, size_t index, size_t n) {
+    size_t* c = (size_t*)lept_context_push(scratch, (n + 1) * sizeof(size_t));
+    size_t i;
+    for (i = 0, index++; i < n; index += nodes[index].count, i++)
+        c[i] = index;
+    return c;
+}
+
+void lept_diff(const lept_value* a, const lept_value* b, lept_value* patch) {
+    lept_context nodes_a, nodes_b, tasks, paths, scratch;
+    const lept_diff_node* na, *nb;
+    lept_diff_task t;
+    size_t i, j, n, m, prefix, suffix, off, mask;
+    size_t* ca, *cb, *table;
+    assert(a != NULL && b != NULL && patch != NULL);
+    memset(&nodes_a, 0, sizeof(lept_context));
+    memset(&nodes_b, 0, sizeof(lept_context));
+    memset(&tasks, 0, sizeof(lept_context));
+    memset(&paths, 0, sizeof(lept_context));
+    memset(&scratch, 0, sizeof(lept_context));
+    lept_set_array(patch, 0);
+    lept_diff_index(&nodes_a, &tasks, a);
+    lept_diff_index(&nodes_b, &tasks, b);
+    na = (const lept_diff_node*)nodes_a.stack;
+    nb = (const lept_diff_node*)nodes_b.stack;
+    lept_diff_push(&tasks, &paths, a, b, 0, 0, 0);
+    while (tasks.top > 0) {
+        memcpy(&t, lept_context_pop(&tasks, sizeof(lept_diff_task)), sizeof(lept_diff_task));
+        paths.top = t.off + t.len;
+        scratch.top = 0;
+        // 哈希和结点数都相同则视为相同的子树，整个跳过
+        if (na[t.ai].hash == nb[t.bi].hash && na[t.ai].count == nb[t.bi].count)
+            continue;
+        if (t.a->type != t.b->type || (t.a->type != LEPT_ARRAY && t.a->type != LEPT_OBJECT)) {
+            lept_diff_emit(patch, "replace", &paths, t.off, t.b);
+            continue;
+        }
+        n = lept_diff_size(t.a);
+        m = lept_diff_size(t.b);
+        ca = lept_diff_children(&scratch, na, t.ai, n);
+        cb = lept_diff_children(&scratch, nb, t.bi, m);
+        ca = (size_t*)scratch.stack;
+        if (t.a->type == LEPT_ARRAY) {
+            // 去掉相同的前缀和后缀，中间部分逐个对应，多出的在末尾删除或插入
+            for (prefix = 0; prefix < n && prefix < m && na[ca[prefix]].hash == nb[cb[prefix]].hash; prefix++)
+                ;
+            for (suffix = 0; suffix < n - prefix && suffix < m - prefix && na[ca[n - 1 - suffix]].hash == nb[cb[m - 1 - suffix]].hash; suffix++)
+                ;
+            for (i = prefix; i < n - suffix && i < m - suffix; i++) {
+                off = lept_diff_path(&paths, t.off, t.len, NULL, 0, i);
+                lept_diff_push(&tasks, &paths, &t.a->u.a.e[i], &t.b->u.a.e[i], ca[i], cb[i], off);
+            }
+            for (j = i; j < n - suffix; j++) {
+                // 每次删除同一位置，后面的元素依次前移
+                off = lept_diff_path(&paths, t.off, t.len, NULL, 0, i);
+                lept_diff_emit(patch, "remove", &paths, off, NULL);
+                paths.top = off;
+            }
+            for (j = i; j < m - suffix; j++) {
+                off = lept_diff_path(&paths, t.off, t.len, NULL, 0, j);
+                lept_diff_emit(patch, "add", &paths, off, &t.b->u.a.e[j]);
+                paths.top = off;
+            }
+            continue;
+        }
+        // 对象：为b的键建立开放寻址的散列表（存放下标+1），逐个查找a的键，表的最后一格以后记录b的成员是否已配对
+        for (mask = 1; mask < m * 2; mask <<= 1)
+            ;
+        table = (size_t*)lept_context_push(&scratch, (mask + m) * sizeof(size_t));
+        ca = (size_t*)scratch.stack;
+        cb = ca + n + 1;
+        memset(table, 0, (mask + m) * sizeof(size_t));
+        mask--;
+        for (j = 0; j < m; j++) {
+            const lept_member* bm = &t.b->u.o.m[j];
+            for (i = (size_t)lept_fnv1a(LEPT_FNV_OFFSET, bm->k, bm->klen) & mask; table[i]; i = (i + 1) & mask)
+                ;
+            table[i] = j + 1;
+        }
+        for (i = 0; i < n; i++) {
+            const lept_member* am = &t.a->u.o.m[i];
+            for (j = (size_t)lept_fnv1a(LEPT_FNV_OFFSET, am->k, am->klen) & mask; table[j]; j = (j + 1) & mask) {
+                const lept_member* bm = &t.b->u.o.m[table[j] - 1];
+                if (bm->klen == am->klen && (bm->k == am->k || memcmp(bm->k, am->k, am->klen) == 0))
+                    break;
+            }
+            off = lept_diff_path(&paths, t.off, t.len, am->k, am->klen, 0);
+            if (table[j] == 0) {
+                lept_diff_emit(patch, "remove", &paths, off, NULL);
+                paths.top = off;
+            }
+            else {
+                table[mask + table[j]] = 1;
+                lept_diff_push(&tasks, &paths, &am->v, &t.b->u.o.m[table[j] - 1].v, ca[i], cb[table[j] - 1], off);
+            }
+        }
+        for (j = 0; j < m; j++)
+            if (!table[mask + 1 + j]) {
+                off = lept_diff_path(&paths, t.off, t.len, t.b->u.o.m[j].k, t.b->u.o.m[j].klen, 0);
+                lept_diff_emit(patch, "add", &paths, off, &t.b->u.o.m[j].v);
+                paths.top = off;
+            }
+    }
+    free(nodes_a.stack);
+    free(nodes_b.stack);
+    free(tasks.stack);
+    free(paths.stack);
+    free(scratch.stack);
+}
+
+typedef struct {
+    const lept_value* v;
+    size_t cursor;
+    uint64_t h;
+} lept_hash_frame;
+
+// 求v的哈希；store为真时把各容器的哈希写入缓存，只用于冻结的文档
+static uint64_t lept_hash_tree(const lept_value* v, int store) {
+    lept_context c;
+    lept_hash_frame* f;
+    lept_header* hd;
+    uint64_t h;
+    assert(v != NULL);
+    memset(&c, 0, sizeof(lept_context));
+    for (;;) {
+        // 求v的哈希：容器有缓存则直接使用，否则压栈逐个合并子结点
+        hd = lept_get_header(v);
+        if ((v->type == LEPT_ARRAY || v->type == LEPT_OBJECT) && !(hd && hd->hashed)) {
+            f = (lept_hash_frame*)lept_context_push(&c, sizeof(lept_hash_frame));
+            f->v = v;
+            f->cursor = 0;
+            f->h = lept_hash_mix(LEPT_FNV_OFFSET ^ (uint64_t)v->type);
+        }
+        else {
+            h = hd ? hd->hash : lept_hash_scalar(v);
+            if (c.top == 0)
+                break;
+            f = (lept_hash_frame*)(c.stack + c.top) - 1;
+            f->h = lept_hash_combine(f->v, f->h, f->cursor - 1, h);
+        }
+        // 完成子结点都已合并的容器并写入缓存，直到找到下一个要计算的子结点
+        for (;;) {
+            f = (lept_hash_frame*)(c.stack + c.top) - 1;
+            if (f->cursor < lept_diff_size(f->v)) {
+                v = lept_diff_child(f->v, f->cursor++);
+                break;
+            }
+            h = f->h;
+            if (store && (hd = lept_get_header(f->v)) != NULL) {
+                hd->hash = h;
+                hd->hashed = 1;
+            }
+            lept_context_pop(&c, sizeof(lept_hash_frame));
+            if (c.top == 0) {
+                free(c.stack);
+                return h;
+            }
+            f = (lept_hash_frame*)(c.stack + c.top) - 1;
+            f->h = lept_hash_combine(f->v, f->h, f->cursor - 1, h);
+        }
+    }
+    free(c.stack);
+    return h;
+}
+
+uint64_t lept_hash(const lept_value* v) {
+    assert(v != NULL);
+    return lept_hash_tree(v, 0);
+}
+
+#if 0
+CBOR (RFC 8949) 数据项 = 头部 [内容]
+头部首字节高3位为主类型，低5位为附加信息：<24 直接是参数，24~27 后跟 1/2/4/8 字节大端参数，31 为不定长
+主类型 0 无符号整数  1 负整数(-1-n)  2 字节串  3 文本串  4 数组  5 映射  6 标签  7 简单值/浮点数
+#endif
+#define LEPT_CBOR_INDEFINITE 31
+
+// 写入首字节和其后 bytes 个字节的大端参数
+static void lept_cbor_put(lept_context* c, unsigned first, uint64_t n, size_t bytes) {
+    unsigned char* p = (unsigned char*)lept_context_push(c, bytes + 1);
+    p[0] = (unsigned char)first;
+    for (; bytes > 0; bytes--, n >>= 8)
+        p[bytes] = (unsigned char)(n & 0xFF);
+}
+
+// 写入头部，参数用最短的编码
+static void lept_cbor_put_head(lept_context* c, unsigned major, uint64_t n) {
+    major <<= 5;
+    if (n < 24)
+        lept_cbor_put(c, major | (unsigned)n, 0, 0);
+    else if (n <= 0xFF)
+        lept_cbor_put(c, major | 24, n, 1);
+    else if (n <= 0xFFFF)
+        lept_cbor_put(c, major | 25, n, 2);
+    else if (n <= 0xFFFFFFFFu)
+        lept_cbor_put(c, major | 26, n, 4);
+    else
+        lept_cbor_put(c, major | 27, n, 8);
+}
+
+// 能无损表示为半精度浮点数时求出其位模式
+static int lept_cbor_half(double d, unsigned* h) {
+    unsigned sign = signbit(d) ? 0x8000 : 0;
+    double m, s;
+    int e;
+    if (d == 0.0) {
+        *h = sign;
+        return 1;
+    }
+    if (!(fabs(d) <= 65504.0))
+        return 0;
+    m = frexp(fabs(d), &e);
+    if (e >= -13) {
+        // 规格化数：11位有效数字，指数偏移15
+        s = ldexp(m, 11);
+        if (!lept_is_integer(s))
+            return 0;
+        *h = sign | (unsigned)(e + 14) << 10 | ((unsigned)s - 1024);
+    }
+    else {
+        // 非规格化数：2^-24 的整数倍
+        s = ldexp(fabs(d), 24);
+        if (!lept_is_integer(s))
+            return 0;
+        *h = sign | (unsigned)s;
+    }
+    return 1;
+}
+
+// 整数值用主类型0/1，其余按 半精度/单精度/双精度 中最短的无损形式
+static void lept_cbor_put_number(lept_context* c, double d) {
+    unsigned h;
+    float f;
+    uint32_t u32;
+    uint64_t u64;
+    if (lept_is_integer(d) && !(d == 0.0 && signbit(d))) {
+        if (d >= 0.0 && d < 18446744073709551616.0) {
+            lept_cbor_put_head(c, 0, (uint64_t)d);
+            return;
+        }
+        if (d < 0.0 && d > -18446744073709551616.0) {
+            lept_cbor_put_head(c, 1, (uint64_t)-d - 1);
+            return;
+        }
+    }
+    if (lept_cbor_half(d, &h))
+        lept_cbor_put(c, 0xF9, h, 2);
+    else if (fabs(d) <= FLT_MAX && (double)(f = (float)d) == d) {
+        memcpy(&u32, &f, sizeof(u32));
+        lept_cbor_put(c, 0xFA, u32, 4);
+    }
+    else {
+        memcpy(&u64, &d, sizeof(u64));
+        lept_cbor_put(c, 0xFB, u64, 8);
+    }
+}
+
+// 与 lept_stringify_value() 对应，数组和对象写入元素个数
+static void lept_cbor_put_value(lept_context* c, const lept_value* v) {
+    size_t i;
+    switch (v->type) {
+        case LEPT_NULL:   PUTC(c, (char)0xF6); break;
+        case LEPT_FALSE:  PUTC(c, (char)0xF4); break;
+        case LEPT_TRUE:   PUTC(c, (char)0xF5); break;
+        case LEPT_NUMBER: lept_cbor_put_number(c, v->u.n); break;
+        case LEPT_STRING:
+            lept_cbor_put_head(c, 3, v->u.s.len);
+            if (v->u.s.len)
+                PUTS(c, v->u.s.s, v->u.s.len);
+            break;
+        case LEPT_ARRAY:
+            lept_cbor_put_head(c, 4, v->u.a.size);
+            for (i = 0; i < v->u.a.size; i++)
+                lept_cbor_put_value(c, &v->u.a.e[i]);
+            break;
+        case LEPT_OBJECT:
+            lept_cbor_put_head(c, 5, v->u.o.size);
+            for (i = 0; i < v->u.o.size; i++) {
+                lept_cbor_put_head(c, 3, v->u.o.m[i].klen);
+                if (v->u.o.m[i].klen)
+                    PUTS(c, v->u.o.m[i].k, v->u.o.m[i].klen);
+                lept_cbor_put_value(c, &v->u.o.m[i].v);
+            }
+            break;
+        default: assert(0 && "invalid type");
+    }
+}
+
+unsigned char* lept_to_cbor(const lept_value* v, size_t* length) {
+    lept_context c;
+    assert(v != NULL && length != NULL);
+    memset(&c, 0, sizeof(c));
+    c.stack = (char*)malloc(c.size = LEPT_PARSE_STRINGIFY_INIT_SIZE);
+    lept_cbor_put_value(&c, v);
+    *length = c.top;
+    return (unsigned char*)c.stack;
+}
+
+// 解码时数组/对象的状态，放在 lept_context 堆栈上
+typedef struct {
+    lept_value* v;
+    size_t left;        // 定长时还未解码的元素个数
+    int indefinite;     // 不定长，以 0xFF 结束
+} lept_cbor_frame;
+
+typedef struct {
+    const unsigned char* p;
+    const unsigned char* end;
+    lept_context* c;
+} lept_cbor_reader;
+
+// 读一个头部，info为附加信息，n为参数（浮点数为其位模式）
+static int lept_cbor_get_head(lept_cbor_reader* r, unsigned* major, unsigned* info, uint64_t* n) {
+    size_t bytes;
+    if (r->p == r->end)
+        return LEPT_CBOR_TRUNCATED;
+    *major = *r->p >> 5;
+    *info = *r->p++ & 0x1F;
+    if (*info < 24) {
+        *n = *info;
+        return LEPT_CBOR_OK;
+    }
+    if (*info == LEPT_CBOR_INDEFINITE) {
+        // 整数和标签没有不定长形式
+        if (*major < 2 || *major == 6)
+            return LEPT_CBOR_INVALID;
+        *n = 0;
+        return LEPT_CBOR_OK;
+    }
+    if (*info > 27)
+        return LEPT_CBOR_INVALID;
+    bytes = (size_t)1 << (*info - 24);
+    if ((size_t)(r->end - r->p) < bytes)
+        return LEPT_CBOR_TRUNCATED;
+    for (*n = 0; bytes > 0; bytes--)
+        *n = *n << 8 | *r->p++;
+    return LEPT_CBOR_OK;
+}
+
+// 读一个文本串；定长的直接指向输入，不定长的各段拼接到堆栈上，由调用方弹出 *pushed 个字节
+static int lept_cbor_get_text(lept_cbor_reader* r, const char** s, size_t* len, size_t* pushed) {
+    unsigned major, info;
+    uint64_t n;
+    size_t head = r->c->top;
+    int ret;
+    *pushed = 0;
+    if ((ret = lept_cbor_get_head(r, &major, &info, &n)) != LEPT_CBOR_OK)
+        return ret;
+    if (major != 3)
+        return major == 2 ? LEPT_CBOR_UNSUPPORTED : LEPT_CBOR_INVALID;
+    if (info != LEPT_CBOR_INDEFINITE) {
+        if (n > (uint64_t)(r->end - r->p))
+            return LEPT_CBOR_TRUNCATED;
+        *s = (const char*)r->p;
+        *len = (size_t)n;
+        r->p += *len;
+        return LEPT_CBOR_OK;
+    }
+    for (;;) {
+        if (r->p == r->end)
+            ret = LEPT_CBOR_TRUNCATED;
+        else if (*r->p == 0xFF) {
+            r->p++;
+            break;
+        }
+        // 每段必须是定长文本串
+        else if ((ret = lept_cbor_get_head(r, &major, &info, &n)) == LEPT_CBOR_OK) {
+            if (major != 3 || info == LEPT_CBOR_INDEFINITE)
+                ret = LEPT_CBOR_INVALID;
+            else if (n > (uint64_t)(r->end - r->p))
+                ret = LEPT_CBOR_TRUNCATED;
+            else if (n > 0) {
+                PUTS(r->c, r->p, (size_t)n);
+                r->p += n;
+            }
+        }
+        if (ret != LEPT_CBOR_OK) {
+            r->c->top = head;
+            return ret;
+        }
+    }
+    *pushed = *len = r->c->top - head;
+    *s = r->c->stack + head;
+    return LEPT_CBOR_OK;
+}
+
+// 半精度转双精度（RFC 8949 附录D）
+static double lept_cbor_decode_half(unsigned h) {
+    unsigned e = (h >> 10) & 0x1F, m = h & 0x3FF;
+    double d = e == 0 ? ldexp(m, -24) : e != 31 ? ldexp(m + 1024, (int)e - 25) : m == 0 ? HUGE_VAL : NAN;
+    return h & 0x8000 ? -d : d;
+}
+
+// 解码一个数据项到v；非空的数组/对象只分配好空间并压入一帧，元素由 lept_from_cbor() 继续填充
+static int lept_cbor_get_value(lept_cbor_reader* r, lept_value* v) {
+    lept_cbor_frame* f;
+    unsigned major, info;
+    uint64_t n;
+    uint32_t u32;
+    float fl;
+    const char* s;
+    size_t len, pushed;
+    int ret;
+    for (;;) {
+        const unsigned char* head = r->p;
+        if ((ret = lept_cbor_get_head(r, &major, &info, &n)) != LEPT_CBOR_OK)
+            return ret;
+        switch (major) {
+            case 0:
+                lept_set_number(v, (double)n);
+                return LEPT_CBOR_OK;
+            case 1:
+                lept_set_number(v, -1.0 - (double)n);
+                return LEPT_CBOR_OK;
+            case 2:
+            case 3:
+                r->p = head;
+                if ((ret = lept_cbor_get_text(r, &s, &len, &pushed)) != LEPT_CBOR_OK)
+                    return ret;
+                lept_set_string(v, s, len);
+                r->c->top -= pushed;
+                return LEPT_CBOR_OK;
+            case 4:
+            case 5:
+                // 每个元素至少占1个字节，据此拒绝虚报的个数，之后按个数一次分配
+                if (info != LEPT_CBOR_INDEFINITE && n > (uint64_t)(r->end - r->p) >> (major - 4))
+                    return LEPT_CBOR_TRUNCATED;
+                if (major == 4)
+                    lept_set_array(v, (size_t)n);
+                else
+                    lept_set_object(v, (size_t)n);
+                if (n == 0 && info != LEPT_CBOR_INDEFINITE)
+                    return LEPT_CBOR_OK;
+                if (r->c->top / sizeof(lept_cbor_frame) >= LEPT_PARSE_MAX_DEPTH)
+                    return LEPT_CBOR_NESTING_TOO_DEEP;
+                f = (lept_cbor_frame*)lept_context_push(r->c, sizeof(lept_cbor_frame));
+                f->v = v;
+                f->left = (size_t)n;
+                f->indefinite = info == LEPT_CBOR_INDEFINITE;
+                return LEPT_CBOR_OK;
+            case 6:
+                // 标签不影响JSON的表示，忽略后解码被标记的数据项
+                break;
+            default:
+                switch (info) {
+                    case 20: lept_set_boolean(v, 0); return LEPT_CBOR_OK;
+                    case 21: lept_set_boolean(v, 1); return LEPT_CBOR_OK;
+                    case 22:
+                    case 23: lept_set_null(v); return LEPT_CBOR_OK;
+                    case 25: lept_set_number(v, lept_cbor_decode_half((unsigned)n)); break;
+                    case 26:
+                        u32 = (uint32_t)n;
+                        memcpy(&fl, &u32, sizeof(fl));
+                        lept_set_number(v, fl);
+                        break;
+                    case 27: memcpy(&v->u.n, &n, sizeof(n)); v->type = LEPT_NUMBER; break;
+                    case LEPT_CBOR_INDEFINITE: return LEPT_CBOR_INVALID;
+                    default: return LEPT_CBOR_UNSUPPORTED;
+                }
+                // JSON不能表示无穷大和NaN
+                if (!isfinite(v->u.n)) {
+                    v->type = LEPT_NULL;
+                    return LEPT_CBOR_UNSUPPORTED;
+                }
+                return LEPT_CBOR_OK;
+        }
+    }
+}
+
+int lept_from_cbor(lept_value* v, const unsigned char* data, size_t len) {
+    lept_context c;
+    lept_cbor_reader r;
+    lept_cbor_frame* f = NULL;
+    lept_value* cur = v;
+    lept_member* m;
+    const char* k;
+    size_t klen, pushed;
+    int ret;
+    assert(v != NULL && (data != NULL || len == 0));
+    memset(&c, 0, sizeof(c));
+    r.p = data;
+    r.end = data + len;
+    r.c = &c;
+    lept_init(v);
+    for (;;) {
+        if ((ret = lept_cbor_get_value(&r, cur)) != LEPT_CBOR_OK)
+            break;
+        // 弹出已填满的容器，找到下一个要解码的位置
+        while (c.top > 0) {
+            f = (lept_cbor_frame*)(c.stack + c.top) - 1;
+            if (f->indefinite) {
+                if (r.p == r.end) {
+                    ret = LEPT_CBOR_TRUNCATED;
+                    break;
+                }
+                if (*r.p != 0xFF)
+                    break;
+                r.p++;
+            }
+            else if (f->left > 0) {
+                f->left--;
+                break;
+            }
+            lept_context_pop(&c, sizeof(lept_cbor_frame));
+        }
+        if (ret != LEPT_CBOR_OK || c.top == 0)
+            break;
+        // 定长容器已按个数分配，不定长的按需扩容
+        if (f->v->type == LEPT_ARRAY) {
+            if (f->v->u.a.size == f->v->u.a.capacity)
+                lept_reserve_array(f->v, f->v->u.a.capacity == 0 ? 1 : f->v->u.a.capacity * 2);
+            cur = &f->v->u.a.e[f->v->u.a.size++];
+            lept_init(cur);
+        }
+        else {
+            // 键必须是文本串；不定长的键拼接在堆栈上，f 要重新定位
+            if ((ret = lept_cbor_get_text(&r, &k, &klen, &pushed)) != LEPT_CBOR_OK) {
+                if (ret == LEPT_CBOR_UNSUPPORTED)
+                    ret = LEPT_CBOR_INVALID;
+                break;
+            }
+            f = (lept_cbor_frame*)(c.stack + c.top - pushed) - 1;
+            if (f->v->u.o.size == f->v->u.o.capacity)
+                lept_reserve_object(f->v, f->v->u.o.capacity == 0 ? 1 : f->v->u.o.capacity * 2);
+            m = &f->v->u.o.m[f->v->u.o.size++];
+            m->k = lept_key_new(k, klen);
+            m->klen = klen;
+            c.top -= pushed;
+            cur = &m->v;
+            lept_init(cur);
+        }
+    }
+    if (ret == LEPT_CBOR_OK && r.p != r.end)
+        ret = LEPT_CBOR_ROOT_NOT_SINGULAR;
+    if (ret != LEPT_CBOR_OK)
+        lept_free(v);
+    free(c.stack);
+    return ret;
+}
+
+#if 0
+MessagePack：首字节决定类型，短格式把值/长度放在首字节的低位，其余格式后跟大端的长度或值
+0x00~0x7f 正整数  0x80~0x8f 映射  0x90~0x9f 数组  0xa0~0xbf 字符串  0xe0~0xff 负整数(-32~-1)
+0xc0 nil  0xc2/0xc3 false/true  0xc4~0xc6 bin  0xca/0xcb float32/64  0xcc~0xcf uint  0xd0~0xd3 int
+0xd9~0xdb str  0xdc/0xdd 数组  0xde/0xdf 映射  0xc7~0xc9 0xd4~0xd8 扩展类型  0xc1 未使用
+#endif
+
+// fix为短格式的首字节，个数小于limit时用短格式，否则用 first16 开头的16位格式或紧随其后的32位格式
+static void lept_msgpack_put_head(lept_context* c, unsigned fix, size_t limit, unsigned first16, size_t n) {
+    assert((uint64_t)n <= 0xFFFFFFFFu);
+    if (n < limit)
+        lept_cbor_put(c, fix | (unsigned)n, 0, 0);
+    else if (n <= 0xFFFF)
+        lept_cbor_put(c, first16, n, 2);
+    else
+        lept_cbor_put(c, first16 + 1, n, 4);
+}
+
+static void lept_msgpack_put_string(lept_context* c, const char* s, size_t len) {
+    if (len >= 32 && len <= 0xFF)
+        lept_cbor_put(c, 0xD9, len, 1);
+    else
+        lept_msgpack_put_head(c, 0xA0, 32, 0xDA, len);
+    if (len)
+        PUTS(c, s, len);
+}
+
+// 整数值取能容纳它的最短整数格式，其余取 float32/float64 中较短的无损格式
+static void lept_msgpack_put_number(lept_context* c, double d) {
+    float f;
+    uint32_t u32;
+    uint64_t u64;
+    int64_t i;
+    if (lept_is_integer(d) && !(d == 0.0 && signbit(d))) {
+        if (d >= 0.0 && d < 18446744073709551616.0) {
+            u64 = (uint64_t)d;
+            if (u64 < 0x80)
+                lept_cbor_put(c, (unsigned)u64, 0, 0);
+            else if (u64 <= 0xFF)
+                lept_cbor_put(c, 0xCC, u64, 1);
+            else if (u64 <= 0xFFFF)
+                lept_cbor_put(c, 0xCD, u64, 2);
+            else if (u64 <= 0xFFFFFFFFu)
+                lept_cbor_put(c, 0xCE, u64, 4);
+            else
+                lept_cbor_put(c, 0xCF, u64, 8);
+            return;
+        }
+        if (d < 0.0 && d >= -9223372036854775808.0) {
+            i = (int64_t)d;
+            if (i >= -32)
+                lept_cbor_put(c, (unsigned)(i & 0xFF), 0, 0);
+            else if (i >= -128)
+                lept_cbor_put(c, 0xD0, (uint64_t)i, 1);
+            else if (i >= -32768)
+                lept_cbor_put(c, 0xD1, (uint64_t)i, 2);
+            else if (i >= -2147483647 - 1)
+                lept_cbor_put(c, 0xD2, (uint64_t)i, 4);
+            else
+                lept_cbor_put(c, 0xD3, (uint64_t)i, 8);
+            return;
+        }
+    }
+    if (fabs(d) <= FLT_MAX && (double)(f = (float)d) == d) {
+        memcpy(&u32, &f, sizeof(u32));
+        lept_cbor_put(c, 0xCA, u32, 4);
+    }
+    else {
+        memcpy(&u64, &d, sizeof(u64));
+        lept_cbor_put(c, 0xCB, u64, 8);
+    }
+}
+
+static void lept_msgpack_put_value(lept_context* c, const lept_value* v) {
+    size_t i;
+    switch (v->type) {
+        case LEPT_NULL:   PUTC(c, (char)0xC0); break;
+        case LEPT_FALSE:  PUTC(c, (char)0xC2); break;
+        case LEPT_TRUE:   PUTC(c, (char)0xC3); break;
+        case LEPT_NUMBER: lept_msgpack_put_number(c, v->u.n); break;
+        case LEPT_STRING: lept_msgpack_put_string(c, v->u.s.s, v->u.s.len); break;
+        case LEPT_ARRAY:
+            lept_msgpack_put_head(c, 0x90, 16, 0xDC, v->u.a.size);
+            for (i = 0; i < v->u.a.size; i++)
+                lept_msgpack_put_value(c, &v->u.a.e[i]);
+            break;
+        case LEPT_OBJECT:
+            lept_msgpack_put_head(c, 0x80, 16, 0xDE, v->u.o.size);
+            for (i = 0; i < v->u.o.size; i++) {
+                lept_msgpack_put_string(c, v->u.o.m[i].k, v->u.o.m[i].klen);
+                lept_msgpack_put_value(c, &v->u.o.m[i].v);
+            }
+            break;
+        default: assert(0 && "invalid type");
+    }
+}
+
+unsigned char* lept_to_msgpack(const lept_value* v, size_t* length) {
+    lept_context c;
+    assert(v != NULL && length != NULL);
+    memset(&c, 0, sizeof(c));
+    c.stack = (char*)malloc(c.size = LEPT_PARSE_STRINGIFY_INIT_SIZE);
+    lept_msgpack_put_value(&c, v);
+    *length = c.top;
+    return (unsigned char*)c.stack;
+}
+
+// 读 bytes 个字节的大端整数
+static int lept_msgpack_get_uint(lept_cbor_reader* r, size_t bytes, uint64_t* n) {
+    if ((size_t)(r->end - r->p) < bytes)
+        return LEPT_MSGPACK_TRUNCATED;
+    for (*n = 0; bytes > 0; bytes--)
+        *n = *n << 8 | *r->p++;
+    return LEPT_MSGPACK_OK;
+}
+
+// 读字符串的长度，首字节不是str格式时返回 LEPT_MSGPACK_INVALID
+static int lept_msgpack_get_str(lept_cbor_reader* r, const char** s, size_t* len) {
+    uint64_t n;
+    int ret;
+    if (r->p == r->end)
+        return LEPT_MSGPACK_TRUNCATED;
+    if ((*r->p & 0xE0) == 0xA0)
+        n = *r->p++ & 0x1F;
+    else if (*r->p >= 0xD9 && *r->p <= 0xDB) {
+        r->p++;
+        if ((ret = lept_msgpack_get_uint(r, (size_t)1 << (r->p[-1] - 0xD9), &n)) != LEPT_MSGPACK_OK)
+            return ret;
+    }
+    else
+        return LEPT_MSGPACK_INVALID;
+    if (n > (uint64_t)(r->end - r->p))
+        return LEPT_MSGPACK_TRUNCATED;
+    *s = (const char*)r->p;
+    *len = (size_t)n;
+    r->p += n;
+    return LEPT_MSGPACK_OK;
+}
+
+// 解码一个值到v；非空的数组/映射只分配好空间并压入一帧，由 lept_from_msgpack() 继续填充
+static int lept_msgpack_get_value(lept_cbor_reader* r, lept_value* v, unsigned flags) {
+    lept_cbor_frame* f;
+    unsigned b;
+    uint64_t n;
+    uint32_t u32;
+    float fl;
+    size_t bytes;
+    int ret, map;
+    if (r->p == r->end)
+        return LEPT_MSGPACK_TRUNCATED;
+    b = *r->p;
+    if (b <= 0x7F || b >= 0xE0) {
+        r->p++;
+        lept_set_number(v, b <= 0x7F ? (double)b : (double)b - 256.0);
+        return LEPT_MSGPACK_OK;
+    }
+    if ((b & 0xE0) == 0xA0 || (b >= 0xD9 && b <= 0xDB) || (b >= 0xC4 && b <= 0xC6)) {
+        // bin 与 str 同样作为字符串
+        if (b >= 0xC4 && b <= 0xC6) {
+            r->p++;
+            if ((ret = lept_msgpack_get_uint(r, (size_t)1 << (b - 0xC4), &n)) != LEPT_MSGPACK_OK)
+                return ret;
+            if (n > (uint64_t)(r->end - r->p))
+                return LEPT_MSGPACK_TRUNCATED;
+            v->u.s.s = (char*)r->p;
+            v->u.s.len = (size_t)n;
+            r->p += n;
+        }
+        else if ((ret = lept_msgpack_get_str(r, (const char**)&v->u.s.s, &v->u.s.len)) != LEPT_MSGPACK_OK)
+            return ret;
+        // 借用模式直接指向输入，否则复制一份
+        if (flags & LEPT_MSGPACK_BORROW) {
+            v->u.s.borrowed = 1;
+            v->type = LEPT_STRING;
+        }
+        else
+            lept_set_string(v, v->u.s.s, v->u.s.len);
+        return LEPT_MSGPACK_OK;
+    }
+    r->p++;
+    if (b <= 0x9F || (b >= 0xDC && b <= 0xDF)) {
+        // 0x80~0x8f 0xde 0xdf 为映射，0x90~0x9f 0xdc 0xdd 为数组
+        map = b <= 0x8F || b >= 0xDE;
+        if (b <= 0x9F)
+            n = b & 0x0F;
+        else if ((ret = lept_msgpack_get_uint(r, (size_t)2 << (b & 1), &n)) != LEPT_MSGPACK_OK)
+            return ret;
+        // 每个元素至少占1个字节，据此拒绝虚报的个数，之后按个数一次分配
+        if (n > (uint64_t)(r->end - r->p) >> map)
+            return LEPT_MSGPACK_TRUNCATED;
+        if (map)
+            lept_set_object(v, (size_t)n);
+        else
+            lept_set_array(v, (size_t)n);
+        if (n == 0)
+            return LEPT_MSGPACK_OK;
+        if (r->c->top / sizeof(lept_cbor_frame) >= LEPT_PARSE_MAX_DEPTH)
+            return LEPT_MSGPACK_NESTING_TOO_DEEP;
+        f = (lept_cbor_frame*)lept_context_push(r->c, sizeof(lept_cbor_frame));
+        f->v = v;
+        f->left = (size_t)n;
+        f->indefinite = 0;
+        return LEPT_MSGPACK_OK;
+    }
+    switch (b) {
+        case 0xC0: lept_set_null(v); return LEPT_MSGPACK_OK;
+        case 0xC2: lept_set_boolean(v, 0); return LEPT_MSGPACK_OK;
+        case 0xC3: lept_set_boolean(v, 1); return LEPT_MSGPACK_OK;
+        case 0xCA:
+        case 0xCB:
+            if ((ret = lept_msgpack_get_uint(r, b == 0xCA ? 4 : 8, &n)) != LEPT_MSGPACK_OK)
+                return ret;
+            if (b == 0xCA) {
+                u32 = (uint32_t)n;
+                memcpy(&fl, &u32, sizeof(fl));
+                lept_set_number(v, fl);
+            }
+            else {
+                memcpy(&v->u.n, &n, sizeof(n));
+                v->type = LEPT_NUMBER;
+            }
+            // JSON不能表示无穷大和NaN
+            if (!isfinite(v->u.n)) {
+                v->type = LEPT_NULL;
+                return LEPT_MSGPACK_UNSUPPORTED;
+            }
+            return LEPT_MSGPACK_OK;
+        case 0xCC: case 0xCD: case 0xCE: case 0xCF:
+            if ((ret = lept_msgpack_get_uint(r, (size_t)1 << (b - 0xCC), &n)) != LEPT_MSGPACK_OK)
+                return ret;
+            lept_set_number(v, (double)n);
+            return LEPT_MSGPACK_OK;
+        case 0xD0: case 0xD1: case 0xD2: case 0xD3:
+            bytes = (size_t)1 << (b - 0xD0);
+            if ((ret = lept_msgpack_get_uint(r, bytes, &n)) != LEPT_MSGPACK_OK)
+                return ret;
+            // 符号位为1时按补码求绝对值
+            if (n >> (bytes * 8 - 1))
+                lept_set_number(v, -(double)((~n & (~(uint64_t)0 >> (64 - bytes * 8))) + 1));
+            else
+                lept_set_number(v, (double)n);
+            return LEPT_MSGPACK_OK;
+        case 0xC1: return LEPT_MSGPACK_INVALID;
+        default:   return LEPT_MSGPACK_UNSUPPORTED;    // 扩展类型
+    }
+}
+
+int lept_from_msgpack(lept_value* v, const unsigned char* data, size_t len, unsigned flags) {
+    lept_context c;
+    lept_cbor_reader r;
+    lept_cbor_frame* f = NULL;
+    lept_value* cur = v;
+    lept_member* m;
+    const char* k;
+    size_t klen;
+    int ret;
+    assert(v != NULL && (data != NULL || len == 0));
+    memset(&c, 0, sizeof(c));
+    r.p = data;
+    r.end = data + len;
+    r.c = &c;
+    lept_init(v);
+    for (;;) {
+        if ((ret = lept_msgpack_get_value(&r, cur, flags)) != LEPT_MSGPACK_OK)
+            break;
+        // 弹出已填满的容器，找到下一个要解码的位置
+        while (c.top > 0) {
+            f = (lept_cbor_frame*)(c.stack + c.top) - 1;
+            if (f->left > 0) {
+                f->left--;
+                break;
+            }
+            lept_context_pop(&c, sizeof(lept_cbor_frame));
+        }
+        if (c.top == 0)
+            break;
+        if (f->v->type == LEPT_ARRAY) {
+            cur = &f->v->u.a.e[f->v->u.a.size++];
+            lept_init(cur);
+        }
+        else {
+            // 键总是复制，只有值借用输入
+            if ((ret = lept_msgpack_get_str(&r, &k, &klen)) != LEPT_MSGPACK_OK)
+                break;
+            m = &f->v->u.o.m[f->v->u.o.size++];
+            m->k = lept_key_new(k, klen);
+            m->klen = klen;
+            cur = &m->v;
+            lept_init(cur);
+        }
+    }
+    if (ret == LEPT_MSGPACK_OK && r.p != r.end)
+        ret = LEPT_MSGPACK_ROOT_NOT_SINGULAR;
+    if (ret != LEPT_MSGPACK_OK)
+        lept_free(v);
+    free(c.stack);
+    return ret;
+}
+
+#if 0
+快照文件 = 文件头 结点区 字符串区，全部用相对偏移，映射到任何地址都可以直接读
+结点固定16字节，按广度优先顺序存放，同一容器的子结点连续；对象的每个成员占两个结点：键（字符串结点）和值
+tag 低8位为 lept_type，其余为字符串长度或元素个数
+u   数字为其位模式，字符串为到其字节的偏移，数组/对象为到第一个子结点的偏移，偏移都相对于结点自身
+字符串以'\0'结尾，可以直接当C字符串使用
+#endif
+#define LEPT_SNAPSHOT_MAGIC     "LEPTSNAP"
+#define LEPT_SNAPSHOT_VERSION   1
+#define LEPT_SNAPSHOT_ENDIAN    0x01020304u
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t endian;    // 写入方字节序下的 LEPT_SNAPSHOT_ENDIAN，字节序不同的机器拒绝打开
+    uint64_t nodes;     // 结点个数，根结点紧随文件头
+    uint64_t size;      // 文件总字节数
+} lept_snap_header;
+
+struct lept_snap_node {
+    uint64_t tag;
+    uint64_t u;
+};
+
+// 写快照的三遍扫描共用同一个广度优先顺序：统计、写结点、写字符串
+enum { LEPT_SNAP_COUNT, LEPT_SNAP_NODES, LEPT_SNAP_STRINGS };
+
+typedef struct {
+    FILE* fp;
+    int pass;
+    uint64_t index;     // 下一个结点的序号
+    uint64_t children;  // 下一个容器的子结点从哪个序号开始
+    uint64_t nodes;     // 结点总数，统计之后得到
+    uint64_t strings;   // 下一个字符串在文件中的位置，统计时为字符串区的大小
+} lept_snap_writer;
+
+static void lept_snap_emit(lept_snap_writer* w, lept_type type, size_t n, double d, const char* s) {
+    lept_snap_node node;
+    uint64_t pos = sizeof(lept_snap_header) + w->index * sizeof(lept_snap_node);
+    switch (w->pass) {
+        case LEPT_SNAP_COUNT:
+            if (type == LEPT_STRING)
+                w->strings += n + 1;
+            break;
+        case LEPT_SNAP_NODES:
+            node.tag = (uint64_t)type | (uint64_t)n << 8;
+            node.u = 0;
+            if (type == LEPT_NUMBER)
+                memcpy(&node.u, &d, sizeof(d));
+            else if (type == LEPT_STRING) {
+                node.u = w->strings - pos;
+                w->strings += n + 1;
+            }
+            else if (type == LEPT_ARRAY || type == LEPT_OBJECT) {
+                node.u = (w->children - w->index) * sizeof(lept_snap_node);
+                w->children += type == LEPT_OBJECT ? 2 * (uint64_t)n : n;
+            }
+            fwrite(&node, sizeof(node), 1, w->fp);
+            break;
+        default:
+            if (type == LEPT_STRING)
+                fwrite(s, 1, n + 1, w->fp);
+            break;
+    }
+    w->index++;
+}
+
+static void lept_snap_emit_value(lept_snap_writer* w, lept_context* queue, const lept_value* v) {
+    switch (v->type) {
+        case LEPT_NUMBER: lept_snap_emit(w, LEPT_NUMBER, 0, v->u.n, NULL); break;
+        case LEPT_STRING: lept_snap_emit(w, LEPT_STRING, v->u.s.len, 0.0, v->u.s.s); break;
+        case LEPT_ARRAY:
+        case LEPT_OBJECT:
+            lept_snap_emit(w, v->type, v->type == LEPT_ARRAY ? v->u.a.size : v->u.o.size, 0.0, NULL);
+            *(const lept_value**)lept_context_push(queue, sizeof(const lept_value*)) = v;
+            break;
+        default: lept_snap_emit(w, v->type, 0, 0.0, NULL); break;
+    }
+}
+
+// 容器在出队时连续写出全部子结点，因此结点的写出顺序就是序号顺序
+static void lept_snap_pass(lept_snap_writer* w, lept_context* queue, const lept_value* root) {
+    const lept_value* v;
+    size_t head = 0, i;
+    queue->top = 0;
+    w->index = 0;
+    w->children = 1;
+    lept_snap_emit_value(w, queue, root);
+    while (head < queue->top) {
+        memcpy(&v, queue->stack + head, sizeof(v));
+        head += sizeof(v);
+        if (v->type == LEPT_ARRAY)
+            for (i = 0; i < v->u.a.size; i++)
+                lept_snap_emit_value(w, queue, &v->u.a.e[i]);
+        else
+            for (i = 0; i < v->u.o.size; i++) {
+                lept_snap_emit(w, LEPT_STRING, v->u.o.m[i].klen, 0.0, v->u.o.m[i].k);
+                lept_snap_emit_value(w, queue, &v->u.o.m[i].v);
+            }
+    }
+}
+
+int lept_snapshot_write(const lept_value* v, const char* path) {
+    lept_context queue;
+    lept_snap_writer w;
+    lept_snap_header h;
+    int ret;
+    assert(v != NULL && path != NULL);
+    if ((w.fp = fopen(path, "wb")) == NULL)
+        return LEPT_SNAPSHOT_IO_ERROR;
+    memset(&queue, 0, sizeof(queue));
+    w.pass = LEPT_SNAP_COUNT;
+    w.strings = 0;
+    lept_snap_pass(&w, &queue, v);
+    w.nodes = w.index;
+    memcpy(h.magic, LEPT_SNAPSHOT_MAGIC, sizeof(h.magic));
+    h.version = LEPT_SNAPSHOT_VERSION;
+    h.endian = LEPT_SNAPSHOT_ENDIAN;
+    h.nodes = w.nodes;
+    h.size = sizeof(h) + w.nodes * sizeof(lept_snap_node) + w.strings;
+    fwrite(&h, sizeof(h), 1, w.fp);
+    w.pass = LEPT_SNAP_NODES;
+    w.strings = sizeof(h) + w.nodes * sizeof(lept_snap_node);
+    lept_snap_pass(&w, &queue, v);
+    w.pass = LEPT_SNAP_STRINGS;
+    lept_snap_pass(&w, &queue, v);
+    free(queue.stack);
+    ret = ferror(w.fp) ? LEPT_SNAPSHOT_IO_ERROR : LEPT_SNAPSHOT_OK;
+    if (fclose(w.fp) != 0)
+        ret = LEPT_SNAPSHOT_IO_ERROR;
+    return ret;
+}
+
+// 只检查文件头，不扫描内容：文件应当来自 lept_snapshot_write()
+static int lept_snapshot_check(const lept_snapshot* s) {
+    lept_snap_header h;
+    if (s->size < sizeof(h))
+        return LEPT_SNAPSHOT_INVALID;
+    memcpy(&h, s->data, sizeof(h));
+    if (memcmp(h.magic, LEPT_SNAPSHOT_MAGIC, sizeof(h.magic)) != 0 || h.version != LEPT_SNAPSHOT_VERSION
+        || h.endian != LEPT_SNAPSHOT_ENDIAN || h.size != s->size || h.nodes == 0
+        || h.nodes > (s->size - sizeof(h)) / sizeof(lept_snap_node))
+        return LEPT_SNAPSHOT_INVALID;
+    return LEPT_SNAPSHOT_OK;
+}
+
+int lept_snapshot_open(lept_snapshot* s, const char* path) {
+    int ret;
+#ifdef _WIN32
+    HANDLE file, mapping;
+    LARGE_INTEGER size;
+    assert(s != NULL && path != NULL);
+    s->data = NULL;
+    s->size = 0;
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return LEPT_SNAPSHOT_IO_ERROR;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0 || (uint64_t)size.QuadPart > (size_t)-1) {
+        CloseHandle(file);
+        return size.QuadPart == 0 ? LEPT_SNAPSHOT_INVALID : LEPT_SNAPSHOT_IO_ERROR;
+    }
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL)
+        return LEPT_SNAPSHOT_IO_ERROR;
+    // 视图保持映射有效，句柄可以立即关闭
+    s->data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (s->data == NULL)
+        return LEPT_SNAPSHOT_IO_ERROR;
+    s->size = (size_t)size.QuadPart;
+#else
+    struct stat st;
+    void* p;
+    int fd;
+    assert(s != NULL && path != NULL);
+    s->data = NULL;
+    s->size = 0;
+    if ((fd = open(path, O_RDONLY)) < 0)
+        return LEPT_SNAPSHOT_IO_ERROR;
+    if (fstat(fd, &st) != 0 || (uint64_t)st.st_size > (size_t)-1) {
+        close(fd);
+        return LEPT_SNAPSHOT_IO_ERROR;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return LEPT_SNAPSHOT_INVALID;
+    }
+    p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return LEPT_SNAPSHOT_IO_ERROR;
+    s->data = p;
+    s->size = (size_t)st.st_size;
+#endif
+    if ((ret = lept_snapshot_check(s)) != LEPT_SNAPSHOT_OK)
+        lept_snapshot_close(s);
+    return ret;
+}
+
+void lept_snapshot_close(lept_snapshot* s) {
+    assert(s != NULL);
+    if (s->data) {
+#ifdef _WIN32
+        UnmapViewOfFile(s->data);
+#else
+        munmap((void*)s->data, s->size);
+#endif
+    }
+    s->data = NULL;
+    s->size = 0;
+}
+
+const lept_snap_node* lept_snapshot_root(const lept_snapshot* s) {
+    assert(s != NULL && s->data != NULL);
+    return (const lept_snap_node*)((const char*)s->data + sizeof(lept_snap_header));
+}
+
+#define SNAP_TYPE(n)    ((lept_type)((n)->tag & 0xFF))
+#define SNAP_SIZE(n)    ((size_t)((n)->tag >> 8))
+#define SNAP_AT(n)      ((const char*)(n) + (n)->u)
+
+lept_type lept_snap_get_type(const lept_snap_node* n) {
+    assert(n != NULL);
+    return SNAP_TYPE(n);
+}
+
+int lept_snap_get_boolean(const lept_snap_node* n) {
+    assert(n != NULL && (SNAP_TYPE(n) == LEPT_TRUE || SNAP_TYPE(n) == LEPT_FALSE));
+    return SNAP_TYPE(n) == LEPT_TRUE;
+}
+
+double lept_snap_get_number(const lept_snap_node* n) {
+    double d;
+    assert(n != NULL && SNAP_TYPE(n) == LEPT_NUMBER);
+    memcpy(&d, &n->u, sizeof(d));
+    return d;
+}
+
+const char* lept_snap_get_string(const lept_snap_node* n) {
+    assert(n != NULL && SNAP_TYPE(n) == LEPT_STRING);
+    return SNAP_AT(n);
+}
+
+size_t lept_snap_get_string_length(const lept_snap_node* n) {
+    assert(n != NULL && SNAP_TYPE(n) == LEPT_STRING);
+    return SNAP_SIZE(n);
+}
+
+size_t lept_snap_get_array_size(const lept_snap_node* n) {
+    assert(n != NULL && SNAP_TYPE(n) == LEPT_ARRAY);
+    return SNAP_SIZE(n);
+}
+
+const lept_snap_node* lept_snap_get_array_element(const lept_snap_node* n, size_t index) {
+    assert(n != NULL && SNAP_TYPE(n) == LEPT_ARRAY && index < SNAP_SIZE(n));
+    return (const lept_snap_node*)SNAP_AT(n) + index;
+}
+
+size_t lept_snap_get_object_size(const lept_snap_node* n) {
+    assert(n != NULL && SNAP_TYPE(n) == LEPT_OBJECT);
+    return SNAP_SIZE(n);
+}
+
+const char* lept_snap_get_object_key(const lept_snap_node* n, size_t index) {
+    assert(n != NULL && SNAP_TYPE(n) == LEPT_OBJECT && index < SNAP_SIZE(n));
+    return lept_snap_get_string((const lept_snap_node*)SNAP_AT(n) + 2 * index);
+}
+
+size_t lept_snap_get_object_key_length(const lept_snap_node* n, size_t index) {
+    assert(n != NULL && SNAP_TYPE(n) == LEPT_OBJECT && index < SNAP_SIZE(n));
+    return SNAP_SIZE((const lept_snap_node*)SNAP_AT(n) + 2 * index);
+}
+
+const lept_snap_node* lept_snap_get_object_value(const lept_snap_node* n, size_t index) {
+    assert(n != NULL && SNAP_TYPE(n) == LEPT_OBJECT && index < SNAP_SIZE(n));
+    return (const lept_snap_node*)SNAP_AT(n) + 2 * index + 1;
+}
+
+const lept_snap_node* lept_snap_find_object_value(const lept_snap_node* n, const char* key, size_t klen) {
+    const lept_snap_node* m;
+    size_t i;
+    assert(n != NULL && SNAP_TYPE(n) == LEPT_OBJECT && key != NULL);
+    for (i = 0, m = (const lept_snap_node*)SNAP_AT(n); i < SNAP_SIZE(n); i++, m += 2)
+        if (SNAP_SIZE(m) == klen && memcmp(SNAP_AT(m), key, klen) == 0)
+            return m + 1;
+    return NULL;
+}
+
+// 编译模式时待处理的子模式
+typedef struct {
+    const lept_value* v;
+    size_t node;
+} lept_schema_task;
+
+// 子模式的引用：布尔模式不占结点，空对象等同于true；其余分配一个结点，留待之后编译
+static int lept_schema_ref(lept_schema* s, lept_context* c, const lept_value* v, size_t* node) {
+    lept_schema_task* t;
+    if (v->type == LEPT_TRUE || (v->type == LEPT_OBJECT && v->u.o.size == 0))
+        *node = LEPT_SCHEMA_NONE;
+    else if (v->type == LEPT_FALSE)
+        *node = LEPT_SCHEMA_FALSE;
+    else if (v->type == LEPT_OBJECT) {
+        LEPT_PATH_GROW(s->nodes, s->nnodes, s->ncap);
+        t = (lept_schema_task*)lept_context_push(c, sizeof(lept_schema_task));
+        t->v = v;
+        t->node = *node = s->nnodes++;
+    }
+    else
+        return 0;
+    return 1;
+}
+
+static int lept_schema_type(const lept_value* v, unsigned* types) {
+    static const char* const names[] = { "null", "boolean", "number", "string", "array", "object", "integer" };
+    static const unsigned bits[] = {
+        1u << LEPT_NULL, 1u << LEPT_FALSE, 1u << LEPT_NUMBER, 1u << LEPT_STRING,
+        1u << LEPT_ARRAY, 1u << LEPT_OBJECT, LEPT_SCHEMA_INTEGER
+    };
+    size_t i;
+    if (v->type != LEPT_STRING)
+        return 0;
+    for (i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+        if (strlen(names[i]) == v->u.s.len && memcmp(names[i], v->u.s.s, v->u.s.len) == 0) {
+            *types |= bits[i];
+            return 1;
+        }
+    return 0;
 }
 
-size_t lept_get_object_size(const lept_value* v) {
-    assert(v != NULL && v->type == LEPT_OBJECT);
-    return v->u.o.size;
+static int lept_schema_size(const lept_value* v, size_t* size) {
+    if (v->type != LEPT_NUMBER || v->u.n < 0 || !lept_is_integer(v->u.n))
+        return 0;
+    *size = v->u.n >= (double)(size_t)-1 ? (size_t)-1 : (size_t)v->u.n;
+    return 1;
 }
 
-size_t lept_get_object_capacity(const lept_value* v) {
-    assert(v != NULL && v->type == LEPT_OBJECT);
-    // 返回对象容量大小
-	return v->u.o.capacity;
+// 合并 minimum/exclusiveMinimum（或 maximum/exclusiveMaximum），保留更严格的一个
+static void lept_schema_bound(lept_schema_node* n, double d, int max, int exclusive) {
+    unsigned has = max ? LEPT_SCHEMA_MAXIMUM : LEPT_SCHEMA_MINIMUM;
+    unsigned excl = max ? LEPT_SCHEMA_EXCL_MAX : LEPT_SCHEMA_EXCL_MIN;
+    double* bound = max ? &n->maximum : &n->minimum;
+    if (!(n->checks & has) || (max ? d < *bound : d > *bound) || (d == *bound && exclusive)) {
+        n->checks = (n->checks & ~excl) | has | (exclusive ? excl : 0);
+        *bound = d;
+    }
 }
 
-void lept_reserve_object(lept_value* v, size_t capacity) {
-    assert(v != NULL && v->type == LEPT_OBJECT);
-    /* \todo */
-    // 重置容量, 比原来大。
-	if (v->u.o.capacity < capacity) {
-		v->u.o.capacity = capacity;
-		v->u.o.m = (lept_member*)realloc(v->u.o.m, capacity * sizeof(lept_member));
-	}
+// 属性表中键为k的项，没有则追加；同一结点的项在编译该结点时连续追加
+static lept_schema_property* lept_schema_property_get(lept_schema* s, lept_schema_node* n, const char* k, size_t klen) {
+    lept_schema_property* p;
+    size_t i = lept_schema_find(s, n, k, klen);
+    if (i != LEPT_KEY_NOT_EXIST)
+        return &s->props[i];
+    LEPT_PATH_GROW(s->props, s->nprops, s->pcap);
+    p = &s->props[s->nprops++];
+    memcpy(p->k = (char*)malloc(klen + 1), k, klen);
+    p->k[klen] = '\0';
+    p->klen = klen;
+    p->node = LEPT_SCHEMA_NONE;
+    p->required = 0;
+    n->nprops++;
+    return p;
 }
 
-void lept_shrink_object(lept_value* v) {
-    assert(v != NULL && v->type == LEPT_OBJECT);
-    /* \todo */
-    // 收缩容量到刚好符合大小
-	if (v->u.o.capacity > v->u.o.size) {
-		v->u.o.capacity = v->u.o.size;
-		v->u.o.m = (lept_member*)realloc(v->u.o.m, v->u.o.capacity * sizeof(lept_member));
-	}
+#define LEPT_SCHEMA_KEY(m, name) ((m)->klen == sizeof(name) - 1 && memcmp((m)->k, name, sizeof(name) - 1) == 0)
+
+// 编译一个对象模式至结点node，子模式压入c留待之后编译
+static int lept_schema_compile_node(lept_schema* s, lept_context* c, const lept_value* v, size_t node) {
+    lept_schema_node n;
+    size_t i, j;
+    memset(&n, 0, sizeof(n));
+    n.max_length = n.max_items = (size_t)-1;
+    n.items = n.additional = LEPT_SCHEMA_NONE;
+    n.props = s->nprops;
+    n.enums = s->nenums;
+    for (i = 0; i < v->u.o.size; i++) {
+        const lept_member* m = &v->u.o.m[i];
+        const lept_value* x = &m->v;
+        if (LEPT_SCHEMA_KEY(m, "type")) {
+            if (x->type == LEPT_ARRAY) {
+                if (x->u.a.size == 0)
+                    return 0;
+                for (j = 0; j < x->u.a.size; j++)
+                    if (!lept_schema_type(&x->u.a.e[j], &n.types))
+                        return 0;
+            }
+            else if (!lept_schema_type(x, &n.types))
+                return 0;
+        }
+        else if (LEPT_SCHEMA_KEY(m, "enum")) {
+            if (x->type != LEPT_ARRAY)
+                return 0;
+            n.checks |= LEPT_SCHEMA_ENUM;
+            for (j = 0; j < x->u.a.size; j++) {
+                LEPT_PATH_GROW(s->enums, s->nenums, s->ecap);
+                lept_init(&s->enums[s->nenums]);
+                lept_copy(&s->enums[s->nenums++], &x->u.a.e[j]);
+                n.nenums++;
+            }
+        }
+        else if (LEPT_SCHEMA_KEY(m, "minimum") || LEPT_SCHEMA_KEY(m, "exclusiveMinimum")
+            || LEPT_SCHEMA_KEY(m, "maximum") || LEPT_SCHEMA_KEY(m, "exclusiveMaximum")) {
+            if (x->type != LEPT_NUMBER)
+                return 0;
+            // 四个名字只差在 "Min"/"Max" 和 "exclusive" 前缀上
+            lept_schema_bound(&n, x->u.n, m->k[m->klen - 6] == 'a', m->k[0] == 'e');
+        }
+        else if (LEPT_SCHEMA_KEY(m, "minLength")) {
+            if (!lept_schema_size(x, &n.min_length))
+                return 0;
+        }
+        else if (LEPT_SCHEMA_KEY(m, "maxLength")) {
+            if (!lept_schema_size(x, &n.max_length))
+                return 0;
+        }
+        else if (LEPT_SCHEMA_KEY(m, "minItems")) {
+            if (!lept_schema_size(x, &n.min_items))
+                return 0;
+        }
+        else if (LEPT_SCHEMA_KEY(m, "maxItems")) {
+            if (!lept_schema_size(x, &n.max_items))
+                return 0;
+        }
+        else if (LEPT_SCHEMA_KEY(m, "required")) {
+            if (x->type != LEPT_ARRAY)
+                return 0;
+            for (j = 0; j < x->u.a.size; j++) {
+                lept_schema_property* p;
+                if (x->u.a.e[j].type != LEPT_STRING)
+                    return 0;
+                p = lept_schema_property_get(s, &n, x->u.a.e[j].u.s.s, x->u.a.e[j].u.s.len);
+                if (!p->required)
+                    n.nrequired++;
+                p->required = 1;
+            }
+        }
+        else if (LEPT_SCHEMA_KEY(m, "properties")) {
+            if (x->type != LEPT_OBJECT)
+                return 0;
+            for (j = 0; j < x->u.o.size; j++) {
+                size_t child;
+                if (!lept_schema_ref(s, c, &x->u.o.m[j].v, &child))
+                    return 0;
+                lept_schema_property_get(s, &n, x->u.o.m[j].k, x->u.o.m[j].klen)->node = child;
+            }
+        }
+        else if (LEPT_SCHEMA_KEY(m, "additionalProperties")) {
+            if (!lept_schema_ref(s, c, x, &n.additional))
+                return 0;
+        }
+        else if (LEPT_SCHEMA_KEY(m, "items")) {
+            if (!lept_schema_ref(s, c, x, &n.items))
+                return 0;
+        }
+        else if (!LEPT_SCHEMA_KEY(m, "$schema") && !LEPT_SCHEMA_KEY(m, "$id") && !LEPT_SCHEMA_KEY(m, "title")
+            && !LEPT_SCHEMA_KEY(m, "description") && !LEPT_SCHEMA_KEY(m, "default") && !LEPT_SCHEMA_KEY(m, "examples"))
+            return 0;   // 不支持的关键字：宁可拒绝编译，也不要悄悄放过本应拒绝的值
+    }
+    memcpy(&s->nodes[node], &n, sizeof(n));
+    return 1;
 }
 
-void lept_clear_object(lept_value* v) {
-    assert(v != NULL && v->type == LEPT_OBJECT);
-    /* \todo */
-    // 清空对象
-	size_t i;
-	for (i = 0; i < v->u.o.size; i++) {
-		//回收k和v空间
-		free(v->u.o.m[i].k);
-		v->u.o.m[i].k = NULL;
-		v->u.o.m[i].klen = 0;
-		lept_free(&v->u.o.m[i].v);
-	}
-	v->u.o.size = 0;
+lept_schema* lept_schema_compile(const lept_value* schema) {
+    lept_schema* s;
+    lept_context c;
+    lept_schema_task t;
+    assert(schema != NULL);
+    s = (lept_schema*)calloc(1, sizeof(lept_schema));
+    c.stack = NULL;
+    c.size = c.top = 0;
+    c.stats = NULL;
+    // 子模式按需分配结点，结点表可能扩容，所以任务中只记下标
+    if (!lept_schema_ref(s, &c, schema, &s->root))
+        goto error;
+    while (c.top > 0) {
+        memcpy(&t, lept_context_pop(&c, sizeof(lept_schema_task)), sizeof(t));
+        if (!lept_schema_compile_node(s, &c, t.v, t.node))
+            goto error;
+    }
+    free(c.stack);
+    return s;
+error:
+    // 尚未编译的结点没有属性和枚举值，只需释放已追加到表中的
+    free(c.stack);
+    lept_schema_free(s);
+    return NULL;
 }
 
-const char* lept_get_object_key(const lept_value* v, size_t index) {
-    assert(v != NULL && v->type == LEPT_OBJECT);
-    assert(index < v->u.o.size);
-    return v->u.o.m[index].k;
+void lept_schema_free(lept_schema* s) {
+    size_t i;
+    if (s == NULL)
+        return;
+    for (i = 0; i < s->nprops; i++)
+        free(s->props[i].k);
+    for (i = 0; i < s->nenums; i++)
+        lept_free(&s->enums[i]);
+    free(s->nodes);
+    free(s->props);
+    free(s->enums);
+    free(s);
 }
 
-size_t lept_get_object_key_length(const lept_value* v, size_t index) {
-    assert(v != NULL && v->type == LEPT_OBJECT);
-    assert(index < v->u.o.size);
-    return v->u.o.m[index].klen;
+int lept_schema_validate(const lept_schema* s, const lept_value* v) {
+    lept_context c;
+    lept_schema_task t;
+    size_t i, child;
+    int ret = 1;
+    assert(s != NULL && v != NULL);
+    c.stack = NULL;
+    c.size = c.top = 0;
+    c.stats = NULL;
+    t.v = v;
+    t.node = s->root;
+    for (;;) {
+        if (!lept_schema_check(s, t.node, t.v)) {
+            ret = 0;
+            break;
+        }
+        // 只有受约束的子结点才入栈，没有约束的子树整个跳过
+        if (t.node != LEPT_SCHEMA_NONE && t.v->type == LEPT_ARRAY && s->nodes[t.node].items != LEPT_SCHEMA_NONE)
+            for (i = 0; i < t.v->u.a.size; i++) {
+                lept_schema_task* p = (lept_schema_task*)lept_context_push(&c, sizeof(lept_schema_task));
+                p->v = &t.v->u.a.e[i];
+                p->node = s->nodes[t.node].items;
+            }
+        else if (t.node != LEPT_SCHEMA_NONE && t.v->type == LEPT_OBJECT)
+            for (i = 0; i < t.v->u.o.size; i++)
+                if ((child = lept_schema_child(s, t.node, t.v->u.o.m[i].k, t.v->u.o.m[i].klen)) != LEPT_SCHEMA_NONE) {
+                    lept_schema_task* p = (lept_schema_task*)lept_context_push(&c, sizeof(lept_schema_task));
+                    p->v = &t.v->u.o.m[i].v;
+                    p->node = child;
+                }
+        if (c.top == 0)
+            break;
+        memcpy(&t, lept_context_pop(&c, sizeof(lept_schema_task)), sizeof(t));
+    }
+    free(c.stack);
+    return ret;
 }
 
-lept_value* lept_get_object_value(lept_value* v, size_t index) {
-    assert(v != NULL && v->type == LEPT_OBJECT);
-    assert(index < v->u.o.size);
-    return &v->u.o.m[index].v;
+// 结构体绑定中一个值（数组的一个元素）所占的字节数
+static size_t lept_bind_size(lept_bind_type type, const lept_struct_desc* d) {
+    switch (type) {
+        case LEPT_BIND_BOOL:    return sizeof(int);
+        case LEPT_BIND_INT:     return sizeof(int64_t);
+        case LEPT_BIND_DOUBLE:  return sizeof(double);
+        case LEPT_BIND_STRING:  return sizeof(char*);
+        case LEPT_BIND_STRUCT:  return d->size;
+        default: assert(0 && "invalid bind type"); return 0;
+    }
 }
 
-size_t lept_find_object_index(const lept_value* v, const char* key, size_t klen) {
+static void lept_bind_free_value(char* p, lept_bind_type type, const lept_struct_desc* d) {
+    if (type == LEPT_BIND_STRING) {
+        free(*(char**)p);
+        *(char**)p = NULL;
+    }
+    else if (type == LEPT_BIND_STRUCT) {
+        // 清零标量成员：重复的键重新解析嵌套结构体时，json中没有的成员应为0
+        lept_bind_free(p, d);
+        memset(p, 0, d->size);
+    }
+}
+
+static void lept_bind_free_field(char* base, const lept_field* f) {
+    if (f->type == LEPT_BIND_ARRAY) {
+        char** a = (char**)(base + f->offset);
+        size_t* n = (size_t*)(base + f->count);
+        size_t i, size = lept_bind_size(f->elem, f->desc);
+        assert(f->elem != LEPT_BIND_ARRAY);
+        for (i = 0; i < *n; i++)
+            lept_bind_free_value(*a + i * size, f->elem, f->desc);
+        free(*a);
+        *a = NULL;
+        *n = 0;
+    }
+    else
+        lept_bind_free_value(base + f->offset, f->type, f->desc);
+}
+
+void lept_bind_free(void* p, const lept_struct_desc* d) {
     size_t i;
-    assert(v != NULL && v->type == LEPT_OBJECT && key != NULL);
-    for (i = 0; i < v->u.o.size; i++)
-        if (v->u.o.m[i].klen == klen && memcmp(v->u.o.m[i].k, key, klen) == 0)
-            return i;
-    return LEPT_KEY_NOT_EXIST;
+    assert(p != NULL && d != NULL);
+    for (i = 0; i < d->nfields; i++)
+        lept_bind_free_field((char*)p, &d->fields[i]);
 }
 
-lept_value* lept_find_object_value(lept_value* v, const char* key, size_t klen) {
-    size_t index = lept_find_object_index(v, key, klen);
-    return index != LEPT_KEY_NOT_EXIST ? &v->u.o.m[index].v : NULL;
+static int lept_bind_parse_struct(lept_context* c, char* base, const lept_struct_desc* d);
+
+// 解析一个值写入p，类型不符时 c->json 停在值的开头
+static int lept_bind_parse_value(lept_context* c, char* p, lept_bind_type type, const lept_struct_desc* d) {
+    const char* start = c->json;
+    lept_value e;
+    char* s;
+    size_t len;
+    int ret;
+    if (type == LEPT_BIND_STRUCT)
+        return lept_bind_parse_struct(c, p, d);
+    if (type == LEPT_BIND_STRING && *c->json == '"') {
+        // 直接从栈上拷贝，不经过 lept_set_string()
+        if ((ret = lept_parse_string_raw(c, &s, &len)) != LEPT_PARSE_OK)
+            return ret;
+        *(char**)p = (char*)malloc(len + 1);
+        if (len > 0)    // 栈可能还未分配
+            memcpy(*(char**)p, s, len);
+        (*(char**)p)[len] = '\0';
+        return LEPT_PARSE_OK;
+    }
+    if (*c->json == '[' || *c->json == '{')
+        return LEPT_PARSE_BIND_MISMATCH;
+    lept_init(&e);
+    if ((ret = lept_parse_scalar(c, &e)) != LEPT_PARSE_OK)
+        return ret;
+    switch (type) {
+        case LEPT_BIND_BOOL:
+            if (e.type == LEPT_FALSE || e.type == LEPT_TRUE) {
+                *(int*)p = e.type == LEPT_TRUE;
+                return LEPT_PARSE_OK;
+            }
+            break;
+        case LEPT_BIND_INT:
+            if (e.type == LEPT_NUMBER && lept_is_integer(e.u.n)
+                && e.u.n >= -9223372036854775808.0 && e.u.n < 9223372036854775808.0) {
+                *(int64_t*)p = (int64_t)e.u.n;
+                return LEPT_PARSE_OK;
+            }
+            break;
+        case LEPT_BIND_DOUBLE:
+            if (e.type == LEPT_NUMBER) {
+                *(double*)p = e.u.n;
+                return LEPT_PARSE_OK;
+            }
+            break;
+        case LEPT_BIND_STRING:
+            if (e.type == LEPT_NULL)
+                return LEPT_PARSE_OK;   // 绑定前已释放并置为NULL
+            break;
+        default: break;
+    }
+    lept_free(&e);
+    c->json = start;
+    return LEPT_PARSE_BIND_MISMATCH;
 }
 
-// 设置k字段为key的对象的值，如果在查找过程中找到了已经存在key，则返回；否则新申请一块空间并初始化，然后返回
-lept_value* lept_set_object_value(lept_value* v, const char* key, size_t klen) {
-    assert(v != NULL && v->type == LEPT_OBJECT && key != NULL);
-    /* \todo */
-    size_t i, index;
-	index = lept_find_object_index(v, key, klen);
-	if (index != LEPT_KEY_NOT_EXIST)
-		return &v->u.o.m[index].v;
-	//key not exist, then we make room and init
-	if (v->u.o.size == v->u.o.capacity) {
-		lept_reserve_object(v, v->u.o.capacity == 0 ? 1 : (v->u.o.capacity << 1));
-	}
-	i = v->u.o.size;
-	v->u.o.m[i].k = (char*)malloc((klen + 1));
-	memcpy(v->u.o.m[i].k, key, klen);
-	v->u.o.m[i].k[klen] = '\0';
-	v->u.o.m[i].klen = klen;
-	lept_init(&v->u.o.m[i].v);
-	v->u.o.size++;
-	return &v->u.o.m[i].v;
+// 数组直接解析进按1.5倍扩容的缓冲区；先计入元素个数再解析元素，出错时半成品也能被释放
+static int lept_bind_parse_array(lept_context* c, char* base, const lept_field* f) {
+    char** a = (char**)(base + f->offset);
+    size_t* n = (size_t*)(base + f->count);
+    size_t cap = 0, size = lept_bind_size(f->elem, f->desc);
+    lept_value e;
+    int ret;
+    if (*c->json == 'n')
+        return lept_parse_literal(c, &e, "null", LEPT_NULL);
+    if (*c->json != '[')
+        return *c->json == '\0' ? LEPT_PARSE_EXPECT_VALUE : LEPT_PARSE_BIND_MISMATCH;
+    c->json++;
+    lept_parse_whitespace(c);
+    if (*c->json == ']') {
+        c->json++;
+        return LEPT_PARSE_OK;
+    }
+    for (;;) {
+        if (*n == cap) {
+            cap = cap ? cap + (cap >> 1) : 4;
+            *a = (char*)realloc(*a, cap * size);
+        }
+        memset(*a + *n * size, 0, size);
+        (*n)++;
+        if ((ret = lept_bind_parse_value(c, *a + (*n - 1) * size, f->elem, f->desc)) != LEPT_PARSE_OK)
+            return ret;
+        lept_parse_whitespace(c);
+        if (*c->json == ',') {
+            c->json++;
+            lept_parse_whitespace(c);
+        }
+        else if (*c->json == ']') {
+            c->json++;
+            return LEPT_PARSE_OK;
+        }
+        else
+            return LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+    }
 }
 
-void lept_remove_object_value(lept_value* v, size_t index) {
-    assert(v != NULL && v->type == LEPT_OBJECT && index < v->u.o.size);
-    /* \todo */
-    free(v->u.o.m[index].k);
-	lept_free(&v->u.o.m[index].v);
-	//think like a list
-	memcpy(v->u.o.m + index, v->u.o.m + index + 1, (v->u.o.size - index - 1) * sizeof(lept_member));   // 这里原来有错误
-	// 原来的size比如是10，最多其实只能访问下标为9
-	// 删除一个元素，再进行挪移，原来为9的地方要清空
-	// 现在先将size--，则size就是9
-	v->u.o.m[--v->u.o.size].k = NULL;  
-	v->u.o.m[v->u.o.size].klen = 0;
-	lept_init(&v->u.o.m[v->u.o.size].v);
+static int lept_bind_parse_struct(lept_context* c, char* base, const lept_struct_desc* d) {
+    const lept_field* f;
+    size_t next = 0, i, len;
+    char* k;
+    int ret;
+    if (*c->json != '{')
+        return *c->json == '\0' ? LEPT_PARSE_EXPECT_VALUE : LEPT_PARSE_BIND_MISMATCH;
+    // 描述表可以自引用（如树结点），嵌套深度仍然要受限
+    if (c->depth >= c->max_depth)
+        return LEPT_PARSE_NESTING_TOO_DEEP;
+    c->depth++;
+    c->json++;
+    lept_parse_whitespace(c);
+    if (*c->json == '}') {
+        c->json++;
+        c->depth--;
+        return LEPT_PARSE_OK;
+    }
+    for (;;) {
+        if (*c->json != '"')
+            return LEPT_PARSE_MISS_KEY;
+        if ((ret = lept_parse_string_raw(c, &k, &len)) != LEPT_PARSE_OK)
+            return ret;
+        // 键的顺序通常与描述表一致，从上一个成员的下一个开始找；k在下一次压栈前有效
+        for (i = 0, f = NULL; i < d->nfields; i++) {
+            const lept_field* g = &d->fields[(next + i) % d->nfields];
+            if (strlen(g->name) == len && memcmp(g->name, k, len) == 0) {
+                f = g;
+                next = (size_t)(g - d->fields) + 1;
+                break;
+            }
+        }
+        lept_parse_whitespace(c);
+        if (*c->json != ':')
+            return LEPT_PARSE_MISS_COLON;
+        c->json++;
+        lept_parse_whitespace(c);
+        if (f == NULL)
+            ret = lept_project_skip(c);
+        else {
+            lept_bind_free_field(base, f);
+            if (f->type == LEPT_BIND_ARRAY)
+                ret = lept_bind_parse_array(c, base, f);
+            else
+                ret = lept_bind_parse_value(c, base + f->offset, f->type, f->desc);
+        }
+        if (ret != LEPT_PARSE_OK)
+            return ret;
+        lept_parse_whitespace(c);
+        if (*c->json == ',') {
+            c->json++;
+            lept_parse_whitespace(c);
+        }
+        else if (*c->json == '}') {
+            c->json++;
+            c->depth--;
+            return LEPT_PARSE_OK;
+        }
+        else
+            return LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+    }
+}
+
+int lept_parse_bind(void* out, const lept_struct_desc* d, const char* json) {
+    lept_context c;
+    int ret;
+    assert(out != NULL && d != NULL && json != NULL);
+    c.json = json;
+    c.stack = NULL;
+    c.size = c.top = 0;
+    c.stats = NULL;
+    c.depth = 0;
+    c.max_depth = LEPT_PARSE_MAX_DEPTH;
+    c.proj = NULL;
+    c.nproj = 0;
+    c.flags = 0;
+    c.schema = NULL;
+    memset(out, 0, d->size);
+    lept_parse_whitespace(&c);
+    if ((ret = lept_bind_parse_struct(&c, (char*)out, d)) == LEPT_PARSE_OK) {
+        lept_parse_whitespace(&c);
+        if (*c.json != '\0')
+            ret = LEPT_PARSE_ROOT_NOT_SINGULAR;
+    }
+    if (ret != LEPT_PARSE_OK)
+        lept_bind_free(out, d);
+    assert(c.top == 0);
+    free(c.stack);
+    return ret;
+}
+
+static void lept_bind_stringify_struct(lept_context* c, const char* base, const lept_struct_desc* d);
+
+static void lept_bind_stringify_value(lept_context* c, const char* p, lept_bind_type type, const lept_struct_desc* d) {
+    switch (type) {
+        case LEPT_BIND_BOOL:
+            if (*(const int*)p)
+                PUTS(c, "true", 4);
+            else
+                PUTS(c, "false", 5);
+            break;
+        case LEPT_BIND_INT:
+            c->top -= 32 - sprintf(lept_context_push(c, 32), "%lld", (long long)*(const int64_t*)p);
+            break;
+        case LEPT_BIND_DOUBLE:
+            if (isfinite(*(const double*)p))
+                c->top -= 32 - sprintf(lept_context_push(c, 32), "%.17g", *(const double*)p);
+            else
+                PUTS(c, "null", 4);     // json没有无穷大和NaN
+            break;
+        case LEPT_BIND_STRING:
+            if (*(char* const*)p == NULL)
+                PUTS(c, "null", 4);
+            else
+                lept_stringify_string(c, *(char* const*)p, strlen(*(char* const*)p));
+            break;
+        case LEPT_BIND_STRUCT:
+            lept_bind_stringify_struct(c, p, d);
+            break;
+        default: assert(0 && "invalid bind type");
+    }
+}
+
+static void lept_bind_stringify_struct(lept_context* c, const char* base, const lept_struct_desc* d) {
+    size_t i, j;
+    PUTC(c, '{');
+    for (i = 0; i < d->nfields; i++) {
+        const lept_field* f = &d->fields[i];
+        if (i > 0)
+            PUTC(c, ',');
+        lept_stringify_string(c, f->name, strlen(f->name));
+        PUTC(c, ':');
+        if (f->type == LEPT_BIND_ARRAY) {
+            const char* a = *(char* const*)(base + f->offset);
+            size_t n = *(const size_t*)(base + f->count), size = lept_bind_size(f->elem, f->desc);
+            PUTC(c, '[');
+            for (j = 0; j < n; j++) {
+                if (j > 0)
+                    PUTC(c, ',');
+                lept_bind_stringify_value(c, a + j * size, f->elem, f->desc);
+            }
+            PUTC(c, ']');
+        }
+        else
+            lept_bind_stringify_value(c, base + f->offset, f->type, f->desc);
+    }
+    PUTC(c, '}');
+}
+
+char* lept_stringify_bind(const void* in, const lept_struct_desc* d, size_t* length) {
+    lept_context c;
+    assert(in != NULL && d != NULL);
+    c.stack = (char*)malloc(c.size = LEPT_PARSE_STRINGIFY_INIT_SIZE);
+    c.top = 0;
+    c.stats = NULL;
+    c.flags = 0;
+    lept_bind_stringify_struct(&c, (const char*)in, d);
+    if (length)
+        *length = c.top;
+    PUTC(&c, '\0');
+    return c.stack;
+}
+
+// 冻结的文档：根值和原子引用计数
+struct lept_doc {
+    lept_refcount refs;
+    lept_value root;
+};
+
+lept_doc* lept_doc_freeze(lept_value* v) {
+    lept_doc* d;
+    lept_context c;
+    const lept_value* x;
+    size_t i;
+    assert(v != NULL);
+    d = (lept_doc*)malloc(sizeof(lept_doc));
+    d->refs = 1;
+    memcpy(&d->root, v, sizeof(lept_value));
+    lept_init(v);
+    // 读访问会按需写入的缓存（子树哈希、键索引）在这里一次建好，此后并发读不会再写任何内存
+    lept_hash_tree(&d->root, 1);
+    c.stack = NULL;
+    c.size = c.top = 0;
+    c.stats = NULL;
+    x = &d->root;
+    for (;;) {
+        if (x->type == LEPT_OBJECT) {
+            if (x->u.o.size >= LEPT_OBJECT_INDEX_MIN)
+                lept_object_index((lept_value*)x);
+            for (i = 0; i < x->u.o.size; i++)
+                if (x->u.o.m[i].v.type == LEPT_ARRAY || x->u.o.m[i].v.type == LEPT_OBJECT)
+                    *(const lept_value**)lept_context_push(&c, sizeof(lept_value*)) = &x->u.o.m[i].v;
+        }
+        else if (x->type == LEPT_ARRAY) {
+            for (i = 0; i < x->u.a.size; i++)
+                if (x->u.a.e[i].type == LEPT_ARRAY || x->u.a.e[i].type == LEPT_OBJECT)
+                    *(const lept_value**)lept_context_push(&c, sizeof(lept_value*)) = &x->u.a.e[i];
+        }
+        if (c.top == 0)
+            break;
+        x = *(const lept_value**)lept_context_pop(&c, sizeof(lept_value*));
+    }
+    free(c.stack);
+    return d;
+}
+
+lept_doc* lept_doc_retain(lept_doc* d) {
+    assert(d != NULL);
+    LEPT_REF_INC(&d->refs);
+    return d;
+}
+
+void lept_doc_release(lept_doc* d) {
+    if (d != NULL && LEPT_REF_DEC(&d->refs) == 0) {
+        lept_free(&d->root);
+        free(d);
+    }
+}
+
+const lept_value* lept_doc_root(const lept_doc* d) {
+    assert(d != NULL);
+    return &d->root;
 }
@@ -5,6 +5,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifndef _WIN32
+#include <pthread.h>
+#endif
 #include "leptjson.h"
 
 static int main_ret = 0;
@@ -229,10 +232,16 @@ static void test_parse_object() {
 #define TEST_PARSE_ERROR(error, json)\
     do {\
         lept_value v;\
+        lept_error err;\
+        lept_parse_result result;\
         lept_init(&v);\
         v.type = LEPT_FALSE;\
         EXPECT_EQ_INT(error, lept_parse(&v, json));\
         EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));\
+        EXPECT_EQ_INT(error, lept_validate(json, strlen(json), &err));\
+        result = lept_parse_ex(&v, json, NULL);\
+        EXPECT_EQ_INT(error, result.code);\
+        EXPECT_EQ_SIZE_T(err.offset, result.offset);\
         lept_free(&v);\
     } while(0)
 
@@ -345,6 +354,302 @@ static void test_parse_miss_comma_or_curly_bracket() {
     TEST_PARSE_ERROR(LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, "{\"a\":{}");
 }
 
+static void test_parse_nesting_too_deep() {
+    lept_value v;
+    lept_parse_options opt;
+    char* json;
+    size_t i, n = 1025;
+
+    memset(&opt, 0, sizeof(opt));
+    opt.max_depth = 2;
+    lept_init(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_opt(&v, "[[1],{\"a\":1},[]]", &opt));
+    lept_free(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_NESTING_TOO_DEEP, lept_parse_opt(&v, "[[[1]]]", &opt));
+    EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+    EXPECT_EQ_INT(LEPT_PARSE_NESTING_TOO_DEEP, lept_parse_opt(&v, "{\"a\":{\"b\":[]}}", &opt));
+    EXPECT_EQ_INT(LEPT_PARSE_NESTING_TOO_DEEP, lept_parse_opt(&v, "[\"a\",{\"b\":1,\"c\":[{}]}]", &opt));
+    EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+
+    /* 默认深度为1024 */
+    json = (char*)malloc(n * 2 + 1);
+    for (i = 0; i < n; i++) {
+        json[i] = '[';
+        json[n * 2 - 1 - i] = ']';
+    }
+    json[n * 2] = '\0';
+    EXPECT_EQ_INT(LEPT_PARSE_NESTING_TOO_DEEP, lept_parse(&v, json));
+    json[n * 2 - 1] = '\0';
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json + 1));
+    EXPECT_EQ_INT(LEPT_ARRAY, lept_get_type(&v));
+    lept_free(&v);
+    free(json);
+}
+
+#define TEST_UTF8(error, pos, json)\
+    do {\
+        lept_value v;\
+        lept_parse_options opt;\
+        lept_parse_result r;\
+        memset(&opt, 0, sizeof(opt));\
+        opt.flags = LEPT_PARSE_VALIDATE_UTF8;\
+        lept_init(&v);\
+        r = lept_parse_ex(&v, json, &opt);\
+        EXPECT_EQ_INT(error, r.code);\
+        if (error != LEPT_PARSE_OK)\
+            EXPECT_EQ_SIZE_T(pos, r.offset);\
+        lept_free(&v);\
+    } while(0)
+
+// 首字节b1、第二字节b2、其后补足len字节的后续字节是否合法（参考实现只看首字节允许的第二字节范围）
+static int utf8_pair_valid(unsigned b1, unsigned b2, unsigned len) {
+    unsigned lo = b1 == 0xE0 ? 0xA0 : b1 == 0xF0 ? 0x90 : 0x80;
+    unsigned hi = b1 == 0xED ? 0x9F : b1 == 0xF4 ? 0x8F : 0xBF;
+    return b1 >= 0xC2 && b1 <= 0xF4 && len == (b1 < 0xE0 ? 2u : b1 < 0xF0 ? 3u : 4u) && b2 >= lo && b2 <= hi;
+}
+
+static void test_parse_invalid_utf8() {
+    lept_value v;
+    lept_parse_options opt;
+    char json[64];
+    unsigned b1, b2, len, pos, bad = 0;
+
+    TEST_UTF8(LEPT_PARSE_OK, 0, "\"Hello\\u0000\xc3\xb6\xe2\x82\xac\xf0\x9f\x98\x80\xf4\x8f\xbf\xbf\"");
+    TEST_UTF8(LEPT_PARSE_OK, 0, "{\"\xc3\xb6\xc3\xb6\xc3\xb6\xc3\xb6\xc3\xb6\xc3\xb6\xc3\xb6\xc3\xb6\xc3\xb6\":[\"abcdefghijklmnopqrstuvwxyz\"]}");
+    TEST_UTF8(LEPT_PARSE_INVALID_UTF8, 1, "\"\x80\"");
+    TEST_UTF8(LEPT_PARSE_INVALID_UTF8, 1, "\"\xc0\xaf\"");
+    TEST_UTF8(LEPT_PARSE_INVALID_UTF8, 2, "\"a\xe0\x9f\xbf\"");
+    TEST_UTF8(LEPT_PARSE_INVALID_UTF8, 1, "\"\xed\xa0\x80\"");
+    TEST_UTF8(LEPT_PARSE_INVALID_UTF8, 1, "\"\xf4\x90\x80\x80\"");
+    TEST_UTF8(LEPT_PARSE_INVALID_UTF8, 1, "\"\xf5\x80\x80\x80\"");
+    TEST_UTF8(LEPT_PARSE_INVALID_UTF8, 1, "\"\xff\"");
+    TEST_UTF8(LEPT_PARSE_INVALID_UTF8, 1, "\"\xe2\x82\"");
+    TEST_UTF8(LEPT_PARSE_INVALID_UTF8, 3, "\"\xc3\xb6\xb6\"");
+    TEST_UTF8(LEPT_PARSE_INVALID_UTF8, 20, "\"0123456789abcdef012\xf0\x9f\x98\"");
+    TEST_UTF8(LEPT_PARSE_INVALID_UTF8, 19, "\"0123456789abcde\xe2\x82\xac\xe2\x82\"");
+    TEST_UTF8(LEPT_PARSE_INVALID_UTF8, 39, "{\"key\":\"abcdefghijklmnopqrstuvwxyz\",\"\xc3\xb6\xc3\":1}");
+    TEST_UTF8(LEPT_PARSE_INVALID_UNICODE_SURROGATE, 1, "\"\\uDC00\"");
+    TEST_UTF8(LEPT_PARSE_OK, 0, "\"\\uD834\\uDD1E\"");
+
+    /* 不开启时照旧接受 */
+    lept_init(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, "\"\xff\xed\xa0\x80\\uDC00\""));
+    lept_free(&v);
+
+    /* 多字节序列放在向量块边界附近，与逐字节的参考结果对照 */
+    memset(&opt, 0, sizeof(opt));
+    opt.flags = LEPT_PARSE_VALIDATE_UTF8;
+    for (pos = 13; pos <= 16; pos++)
+        for (len = 2; len <= 4; len++)
+            for (b1 = 0x80; b1 <= 0xFF; b1++)
+                for (b2 = 0x20; b2 <= 0xFF; b2++) {
+                    if (b2 == '"' || b2 == '\\')
+                        continue;
+                    memset(json, 'x', sizeof(json));
+                    json[0] = '"';
+                    json[pos] = (char)b1;
+                    json[pos + 1] = (char)b2;
+                    if (len >= 3)
+                        json[pos + 2] = (char)0x80;
+                    if (len >= 4)
+                        json[pos + 3] = (char)0xBF;
+                    json[40] = '"';
+                    json[41] = '\0';
+                    if ((lept_parse_opt(&v, json, &opt) == LEPT_PARSE_OK) != utf8_pair_valid(b1, b2, len))
+                        bad++;
+                    lept_free(&v);
+                }
+    EXPECT_EQ_INT(0, bad);
+}
+
+static void test_parse_error_position() {
+    lept_value v;
+    lept_parse_result r;
+    size_t line, column;
+    const char* json = "{\n  \"a\" : [1, 2],\n  \"b\" : tru\n}";
+
+    lept_init(&v);
+    r = lept_parse_ex(&v, json, NULL);
+    EXPECT_EQ_INT(LEPT_PARSE_INVALID_VALUE, r.code);
+    EXPECT_EQ_SIZE_T(29, r.offset);
+    lept_get_error_position(json, r.offset, &line, &column);
+    EXPECT_EQ_SIZE_T(3, line);
+    EXPECT_EQ_SIZE_T(12, column);
+    EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+
+    r = lept_parse_ex(&v, "\"\\uD800\\uE000\"", NULL);
+    EXPECT_EQ_INT(LEPT_PARSE_INVALID_UNICODE_SURROGATE, r.code);
+    EXPECT_EQ_SIZE_T(9, r.offset);
+    r = lept_parse_ex(&v, "[\"\\u12x4\"]", NULL);
+    EXPECT_EQ_INT(LEPT_PARSE_INVALID_UNICODE_HEX, r.code);
+    EXPECT_EQ_SIZE_T(6, r.offset);
+    lept_get_error_position("[1,\n2\n", 6, &line, &column);
+    EXPECT_EQ_SIZE_T(3, line);
+    EXPECT_EQ_SIZE_T(1, column);
+    lept_get_error_position("[1,\n2", 4, &line, &column);
+    EXPECT_EQ_SIZE_T(2, line);
+    EXPECT_EQ_SIZE_T(1, column);
+
+    /* 超出文本的偏移停在结尾的'\0'处 */
+    lept_get_error_position("[1,\n2\n", 100, &line, &column);
+    EXPECT_EQ_SIZE_T(3, line);
+    EXPECT_EQ_SIZE_T(1, column);
+    lept_get_error_position("ab", 5, &line, &column);
+    EXPECT_EQ_SIZE_T(1, line);
+    EXPECT_EQ_SIZE_T(3, column);
+
+    r = lept_parse_ex(&v, " [1] ", NULL);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, r.code);
+    EXPECT_EQ_SIZE_T(5, r.offset);
+    lept_free(&v);
+    r = lept_parse_ex(&v, " [1] x", NULL);
+    EXPECT_EQ_INT(LEPT_PARSE_ROOT_NOT_SINGULAR, r.code);
+    EXPECT_EQ_SIZE_T(5, r.offset);
+    EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+}
+
+static void test_validate() {
+    static const struct { const char* head; size_t zeros; const char* tail; int expect; } huge[] = {
+        { "17976931348623159", 292, "", LEPT_PARSE_NUMBER_TOO_BIG },
+        { "-17976931348623159", 292, "", LEPT_PARSE_NUMBER_TOO_BIG },
+        { "17976931348623157", 292, "", LEPT_PARSE_OK },
+        { "17976931348623157", 291, ".5e1", LEPT_PARSE_OK },
+        { "0.", 200, "17976931348623158e509", LEPT_PARSE_OK },
+        { "0.", 200, "17976931348623159e509", LEPT_PARSE_NUMBER_TOO_BIG },
+        /* 2^1024 - 2^970 恰好舍入为无穷大，比它小一点则不会 */
+        { "179769313486231580793728971405303415079934132710037826936173778980444968"
+          "292764750946649017977587207096330286416692887910946555547851940402630657"
+          "488671505820681908902000708383676273854845817711531764475730270069855571"
+          "366959622842914819860834936475292719074168444365510704342711559699508093"
+          "042880177904174497792", 0, "", LEPT_PARSE_NUMBER_TOO_BIG },
+        { "179769313486231580793728971405303415079934132710037826936173778980444968"
+          "292764750946649017977587207096330286416692887910946555547851940402630657"
+          "488671505820681908902000708383676273854845817711531764475730270069855571"
+          "366959622842914819860834936475292719074168444365510704342711559699508093"
+          "042880177904174497791", 0, ".999", LEPT_PARSE_OK },
+    };
+    lept_error err;
+    const char* json;
+    char* deep, *big;
+    size_t i, n = 1025;
+
+    json = " { \"a\" : [ 1, -2.5e+3, true, false, null, \"\\u00A2\" ], \"b\" : {} } ";
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_validate(json, strlen(json), &err));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, err.code);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_validate("[{\"a\":[{\"b\":[[{}]]}]},[]]", 25, NULL));
+    EXPECT_EQ_INT(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, lept_validate("[{\"a\":[{\"b\":[[{}}]}]},[]]", 25, NULL));
+    EXPECT_EQ_INT(LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, lept_validate("[{\"a\":[{\"b\":[[{}]]]]},[]]", 25, NULL));
+
+    /* 以长度界定，后面的内容不参与校验 */
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_validate("[1,2]xyz", 5, NULL));
+    EXPECT_EQ_INT(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, lept_validate("[1,2]", 4, NULL));
+    EXPECT_EQ_INT(LEPT_PARSE_MISS_QUOTATION_MARK, lept_validate("\"abc\"", 4, NULL));
+    EXPECT_EQ_INT(LEPT_PARSE_INVALID_VALUE, lept_validate("true", 3, NULL));
+    EXPECT_EQ_INT(LEPT_PARSE_EXPECT_VALUE, lept_validate(NULL, 0, NULL));
+    EXPECT_EQ_INT(LEPT_PARSE_INVALID_STRING_CHAR, lept_validate("\"a\0b\"", 5, NULL));
+    EXPECT_EQ_INT(LEPT_PARSE_ROOT_NOT_SINGULAR, lept_validate("1\0", 2, NULL));
+
+    /* 数量级 */
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_validate("1.7976931348623157e308", 22, NULL));
+    EXPECT_EQ_INT(LEPT_PARSE_NUMBER_TOO_BIG, lept_validate("1.8e308", 7, NULL));
+    EXPECT_EQ_INT(LEPT_PARSE_NUMBER_TOO_BIG, lept_validate("0.000123e313", 12, NULL));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_validate("0.000123e311", 12, NULL));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_validate("0e99999999999", 13, NULL));
+
+    /* 超过 128 字节的数字逐位与溢出边界比较，结果与 lept_parse() 一致 */
+    big = (char*)malloc(400);
+    for (i = 0; i < sizeof(huge) / sizeof(huge[0]); i++) {
+        lept_value v;
+        n = strlen(huge[i].head);
+        memcpy(big, huge[i].head, n);
+        memset(big + n, '0', huge[i].zeros);
+        strcpy(big + n + huge[i].zeros, huge[i].tail);
+        lept_init(&v);
+        EXPECT_EQ_INT(huge[i].expect, lept_parse(&v, big));
+        EXPECT_EQ_INT(huge[i].expect, lept_validate(big, strlen(big), NULL));
+        lept_free(&v);
+    }
+    free(big);
+    n = 1025;
+
+    /* 出错位置 */
+    lept_validate("[1, 2, x]", 9, &err);
+    EXPECT_EQ_INT(LEPT_PARSE_INVALID_VALUE, err.code);
+    EXPECT_EQ_SIZE_T(7, err.offset);
+    lept_validate("{\"a\":1 \"b\"", 11, &err);
+    EXPECT_EQ_INT(LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, err.code);
+    EXPECT_EQ_SIZE_T(7, err.offset);
+    lept_validate("\"ab\\x\"", 7, &err);
+    EXPECT_EQ_INT(LEPT_PARSE_INVALID_STRING_ESCAPE, err.code);
+    EXPECT_EQ_SIZE_T(4, err.offset);
+
+    /* 嵌套深度 */
+    deep = (char*)malloc(n * 2);
+    for (i = 0; i < n; i++) {
+        deep[i] = '[';
+        deep[n * 2 - 1 - i] = ']';
+    }
+    EXPECT_EQ_INT(LEPT_PARSE_NESTING_TOO_DEEP, lept_validate(deep, n * 2, NULL));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_validate(deep + 1, n * 2 - 2, NULL));
+    free(deep);
+}
+
+#define TEST_PROJECTED(expect, json, ...)\
+    do {\
+        static const char* queries[] = { __VA_ARGS__ };\
+        const lept_pointer* paths[sizeof(queries) / sizeof(queries[0])];\
+        lept_value v, e;\
+        size_t i, n = sizeof(queries) / sizeof(queries[0]);\
+        for (i = 0; i < n; i++)\
+            paths[i] = lept_pointer_compile(queries[i], strlen(queries[i]));\
+        lept_init(&v);\
+        lept_init(&e);\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_projected(&v, json, paths, n));\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&e, expect));\
+        EXPECT_TRUE(lept_is_equal(&e, &v));\
+        lept_free(&v);\
+        lept_free(&e);\
+        for (i = 0; i < n; i++)\
+            lept_pointer_free((lept_pointer*)paths[i]);\
+    } while(0)
+
+static void test_parse_projected() {
+    const char* json =
+        "{\"id\":7,\"user\":{\"name\":\"Ann\",\"tags\":[\"a\",\"b\",\"c\"],\"bio\":\"x\\\"}y\"},"
+        "\"events\":[{\"t\":1,\"skip\":[{}]},{\"t\":2}],\"blob\":[1,[2,[3,{\"k\":\"]\"}]]]}";
+    const lept_pointer* paths[1];
+    lept_value v;
+    TEST_PROJECTED("{\"id\":7}", json, "/id");
+    TEST_PROJECTED("{\"id\":7,\"user\":{\"name\":\"Ann\"}}", json, "/user/name", "/id");
+    TEST_PROJECTED("{\"user\":{\"tags\":[null,\"b\",null]}}", json, "/user/tags/1");
+    TEST_PROJECTED("{\"user\":{\"name\":\"Ann\",\"tags\":[\"a\",\"b\",\"c\"],\"bio\":\"x\\\"}y\"}}", json, "/user", "/user/name");
+    TEST_PROJECTED("{\"events\":[{\"t\":1},{\"t\":2}]}", json, "/events/0/t", "/events/1/t");
+    TEST_PROJECTED("{\"events\":[{},{}]}", json, "/events/0/x", "/events/1/t/deeper");
+    TEST_PROJECTED("{}", json, "/missing");
+    TEST_PROJECTED("{\"blob\":[1,[2,[3,{\"k\":\"]\"}]]]}", json, "/blob");
+    TEST_PROJECTED("[1,{\"a\":[]}]", "[1, {\"a\":[], \"b\":2}]", "/0", "/1/a");
+    TEST_PROJECTED("[1,2]", "[1,2]", "");
+    TEST_PROJECTED("null", "5", "/a");
+    TEST_PROJECTED("[1,2]", "[1,2]", "", "/0");
+    lept_init(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_projected(&v, json, NULL, 0));
+    EXPECT_EQ_SIZE_T(4, lept_get_object_size(&v));
+    lept_free(&v);
+
+    /* 跳过的值只检查括号和引号 */
+    paths[0] = lept_pointer_compile("/a", 2);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_projected(&v, "{\"b\":tru,\"a\":1}", paths, 1));
+    lept_free(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_MISS_QUOTATION_MARK, lept_parse_projected(&v, "{\"b\":\"abc", paths, 1));
+    EXPECT_EQ_INT(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, lept_parse_projected(&v, "{\"b\":[1,[2]", paths, 1));
+    EXPECT_EQ_INT(LEPT_PARSE_INVALID_VALUE, lept_parse_projected(&v, "{\"b\":}", paths, 1));
+    EXPECT_EQ_INT(LEPT_PARSE_EXPECT_VALUE, lept_parse_projected(&v, "{\"b\":", paths, 1));
+    EXPECT_EQ_INT(LEPT_PARSE_INVALID_VALUE, lept_parse_projected(&v, "{\"b\":1,\"a\":x}", paths, 1));
+    EXPECT_EQ_INT(LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, lept_parse_projected(&v, "{\"b\":1,\"a\":1", paths, 1));
+    EXPECT_EQ_INT(LEPT_PARSE_ROOT_NOT_SINGULAR, lept_parse_projected(&v, "{\"b\":1} x", paths, 1));
+    lept_pointer_free((lept_pointer*)paths[0]);
+}
+
 static void test_parse() {
     test_parse_null();
     test_parse_true();
@@ -367,6 +672,11 @@ static void test_parse() {
     test_parse_miss_key();
     test_parse_miss_colon();
     test_parse_miss_comma_or_curly_bracket();
+    test_parse_nesting_too_deep();
+    test_parse_invalid_utf8();
+    test_validate();
+    test_parse_error_position();
+    test_parse_projected();
 }
 
 #define TEST_ROUNDTRIP(json)\
@@ -375,6 +685,7 @@ static void test_parse() {
         char* json2;\
         size_t length;\
         lept_init(&v);\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_validate(json, strlen(json), NULL));\
         EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));\
         json2 = lept_stringify(&v, &length);\
         EXPECT_EQ_STRING(json, json2, length);\
@@ -423,6 +734,165 @@ static void test_stringify_object() {
     TEST_ROUNDTRIP("{\"n\":null,\"f\":false,\"t\":true,\"i\":123,\"s\":\"abc\",\"a\":[1,2,3],\"o\":{\"1\":1,\"2\":2,\"3\":3}}");
 }
 
+#define TEST_CANONICAL(expect, json)\
+    do {\
+        lept_value v;\
+        char* json2;\
+        size_t length;\
+        lept_init(&v);\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));\
+        json2 = lept_stringify_canonical(&v, &length);\
+        EXPECT_EQ_STRING(expect, json2, length);\
+        lept_free(&v);\
+        free(json2);\
+    } while(0)
+
+static void test_stringify_canonical() {
+    lept_value v1, v2;
+    char* s1, *s2;
+    size_t i, n1, n2;
+    volatile double zero;
+
+    /* 数字（RFC 8785 附录B 与 ECMAScript 格式） */
+    TEST_CANONICAL("0", "-0");
+    TEST_CANONICAL("1", "1.0");
+    TEST_CANONICAL("-1.5", "-1.5");
+    TEST_CANONICAL("123.456", "123.456");
+    TEST_CANONICAL("100000000000000000000", "1e20");
+    TEST_CANONICAL("1e+21", "1e21");
+    TEST_CANONICAL("0.000001", "1e-6");
+    TEST_CANONICAL("1e-7", "1e-7");
+    TEST_CANONICAL("1.5e-7", "0.00000015");
+    TEST_CANONICAL("333333333.3333333", "333333333.33333329");
+    TEST_CANONICAL("1.7976931348623157e+308", "1.7976931348623157e308");
+    TEST_CANONICAL("5e-324", "4.9406564584124654e-324");
+    TEST_CANONICAL("9007199254740992", "9007199254740992");
+    TEST_CANONICAL("295147905179352830000", "295147905179352825856");
+    TEST_CANONICAL("0.1", "0.1");
+
+    /* 字符串 */
+    TEST_CANONICAL("\"\\u001f\\b\\n\\\"\\\\/\x7f\xc3\xb6\"", "\"\\u001F\\b\\n\\\"\\\\\\/\\u007F\\u00f6\"");
+
+    /* 键按UTF-16码元排序（RFC 8785 3.2.3） */
+    TEST_CANONICAL("{\"\\r\":1,\"1\":2,\"\xc2\x80\":3,\"\xc3\xb6\":4,\"\xe2\x82\xac\":5,\"\xf0\x9f\x98\x80\":6,\"\xef\xac\xb3\":7}",
+        "{\"\\u20ac\":5,\"\\r\":1,\"\\ufb33\":7,\"1\":2,\"\\ud83d\\ude00\":6,\"\\u0080\":3,\"\\u00f6\":4}");
+    TEST_CANONICAL("{\"\":true,\"a\":{\"b\":null,\"c\":[{\"y\":2,\"z\":1}]},\"aa\":false}",
+        "{\"aa\":false,\"a\":{\"b\":null,\"c\":[{\"y\":2,\"z\":1}]},\"\":true}");
+
+    /* 键较多时走基数排序，结果与插入顺序无关 */
+    lept_init(&v1);
+    lept_init(&v2);
+    lept_set_object(&v1, 0);
+    lept_set_object(&v2, 0);
+    for (i = 0; i < 300; i++) {
+        char key[16];
+        lept_set_number(lept_set_object_value(&v1, key, (size_t)sprintf(key, "key%d", (int)i)), (double)i);
+        lept_set_number(lept_set_object_value(&v2, key, (size_t)sprintf(key, "key%d", (int)(299 - i))), (double)(299 - i));
+    }
+    s1 = lept_stringify_canonical(&v1, &n1);
+    s2 = lept_stringify_canonical(&v2, &n2);
+    EXPECT_TRUE(n1 == n2 && memcmp(s1, s2, n1) == 0);
+    EXPECT_TRUE(strncmp(s1, "{\"key0\":0,\"key1\":1,\"key10\":10,\"key100\":100,", sizeof("{\"key0\":0,\"key1\":1,\"key10\":10,\"key100\":100,") - 1) == 0);
+    /* 解析回来，键应严格递增 */
+    lept_free(&v2);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v2, s1));
+    EXPECT_EQ_SIZE_T(300, lept_get_object_size(&v2));
+    for (i = 1; i < lept_get_object_size(&v2); i++)
+        EXPECT_TRUE(strcmp(lept_get_object_key(&v2, i - 1), lept_get_object_key(&v2, i)) < 0);
+    free(s1);
+    free(s2);
+    lept_free(&v1);
+    lept_free(&v2);
+
+    /* 很长的共同前缀："a" "aa" ... 各键依次嵌套，排序不能按前缀长度递归 */
+    s1 = (char*)malloc(3001);
+    memset(s1, 'a', 3000);
+    lept_set_object(&v1, 0);
+    for (i = 3000; i > 0; i--)
+        lept_set_number(lept_set_object_value(&v1, s1, i), (double)i);
+    free(s1);
+    s1 = lept_stringify_canonical(&v1, &n1);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v2, s1));
+    EXPECT_EQ_SIZE_T(3000, lept_get_object_size(&v2));
+    for (i = 0; i < lept_get_object_size(&v2); i++)
+        EXPECT_EQ_SIZE_T(i + 1, lept_get_object_key_length(&v2, i));
+    free(s1);
+    lept_free(&v1);
+    lept_free(&v2);
+
+    /* NaN 和无穷大没有规范的表示，不能与 null 输出相同的字节 */
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v1, "{\"a\":[null,1]}"));
+    s1 = lept_stringify_canonical(&v1, &n1);
+    EXPECT_EQ_STRING("{\"a\":[null,1]}", s1, n1);
+    free(s1);
+    zero = 0.0;
+    lept_set_number(lept_get_array_element(lept_find_object_value(&v1, "a", 1), 1), zero / zero);
+    n1 = 1;
+    EXPECT_TRUE(lept_stringify_canonical(&v1, &n1) == NULL);
+    EXPECT_EQ_SIZE_T(0, n1);
+    lept_set_number(lept_get_array_element(lept_find_object_value(&v1, "a", 1), 1), 1.0 / zero);
+    EXPECT_TRUE(lept_stringify_canonical(&v1, NULL) == NULL);
+    lept_set_number(&v1, -1.0 / zero);
+    EXPECT_TRUE(lept_stringify_canonical(&v1, &n1) == NULL);
+    lept_free(&v1);
+}
+
+#define TEST_STRINGIFY_ASCII(expect, json)\
+    do {\
+        lept_value v;\
+        lept_stringify_options opt;\
+        char* json2;\
+        size_t length;\
+        memset(&opt, 0, sizeof(opt));\
+        opt.flags = LEPT_STRINGIFY_ASCII;\
+        lept_init(&v);\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));\
+        json2 = lept_stringify_opt(&v, &length, &opt);\
+        EXPECT_EQ_STRING(expect, json2, length);\
+        lept_free(&v);\
+        free(json2);\
+    } while(0)
+
+static void test_stringify_ascii() {
+    lept_value v, v2;
+    lept_stringify_options opt;
+    char* json;
+    size_t i, length;
+
+    TEST_STRINGIFY_ASCII("\"Hello\"", "\"Hello\"");
+    TEST_STRINGIFY_ASCII("\"\\u00A2\\u20AC\\uD834\\uDD1E\"", "\"\xc2\xa2\xe2\x82\xac\xf0\x9d\x84\x9e\"");
+    TEST_STRINGIFY_ASCII("\"\x7f\\u0080\\uFFFF\\uDBFF\\uDFFF\"", "\"\\u007f\\u0080\\uffff\\udbff\\udfff\"");
+    TEST_STRINGIFY_ASCII("\"\\\"\\\\/\\b\\f\\n\\r\\t\\u001F\"", "\"\\\"\\\\\\/\\b\\f\\n\\r\\t\\u001f\"");
+    TEST_STRINGIFY_ASCII("{\"\\u00F6\":[\"\\u00FC\"]}", "{\"\xc3\xb6\":[\"\xc3\xbc\"]}");
+    /* 非法的UTF-8逐字节替换为U+FFFD */
+    TEST_STRINGIFY_ASCII("\"a\\uFFFDb\\uFFFD\\uFFFD\\uFFFDc\\uFFFD\"", "\"a\xff" "b\xe2\x82\xff" "c\xc3\"");
+    /* 向量块边界两侧 */
+    TEST_STRINGIFY_ASCII("\"0123456789abcde\\u00F60123456789abcdef\\\"0123456789abcd\\u20AC\"",
+        "\"0123456789abcde\xc3\xb6" "0123456789abcdef\\\"0123456789abcd\xe2\x82\xac\"");
+
+    /* 输出与不转义时解析结果相同 */
+    lept_init(&v);
+    lept_init(&v2);
+    lept_set_string(&v, "", 0);
+    memset(&opt, 0, sizeof(opt));
+    opt.flags = LEPT_STRINGIFY_ASCII;
+    json = (char*)malloc(4000);
+    for (i = 0; i < 1000; i++)
+        memcpy(json + i * 4, i % 7 == 0 ? "\xf0\x9f\x98\x80" : i % 5 == 0 ? "\"\xc3\xa9\n" : "abcd", 4);
+    lept_set_string(&v, json, 4000);
+    free(json);
+    json = lept_stringify_opt(&v, &length, &opt);
+    for (i = 0; i < length; i++)
+        if ((unsigned char)json[i] >= 0x80)
+            break;
+    EXPECT_EQ_SIZE_T(length, i);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v2, json));
+    EXPECT_TRUE(lept_is_equal(&v, &v2));
+    free(json);
+    lept_free(&v);
+    lept_free(&v2);
+}
+
 static void test_stringify() {
     TEST_ROUNDTRIP("null");
     TEST_ROUNDTRIP("false");
@@ -431,6 +901,8 @@ static void test_stringify() {
     test_stringify_string();
     test_stringify_array();
     test_stringify_object();
+    test_stringify_canonical();
+    test_stringify_ascii();
 }
 
 #define TEST_EQUAL(json1, json2, equality) \
@@ -471,6 +943,75 @@ static void test_equal() {
     TEST_EQUAL("{\"a\":{\"b\":{\"c\":{}}}}", "{\"a\":{\"b\":{\"c\":[]}}}", 0);
 }
 
+#define TEST_HASH(equal, json1, json2)\
+    do {\
+        lept_value v1, v2;\
+        lept_init(&v1);\
+        lept_init(&v2);\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v1, json1));\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v2, json2));\
+        EXPECT_EQ_INT(equal, lept_hash(&v1) == lept_hash(&v2));\
+        EXPECT_EQ_INT(equal, lept_is_equal(&v1, &v2));\
+        lept_free(&v1);\
+        lept_free(&v2);\
+    } while(0)
+
+static void test_hash() {
+    lept_value v1, v2, *inner;
+    uint64_t h;
+    TEST_HASH(1, "null", "null");
+    TEST_HASH(0, "null", "false");
+    TEST_HASH(1, "0", "-0");
+    TEST_HASH(0, "1", "\"1\"");
+    TEST_HASH(0, "[]", "{}");
+    TEST_HASH(1, "[1,[2,3]]", "[1,[2,3]]");
+    TEST_HASH(0, "[1,2]", "[2,1]");
+    TEST_HASH(0, "[[1],2]", "[1,[2]]");
+    TEST_HASH(1, "{\"a\":1,\"b\":[true]}", "{\"b\":[true],\"a\":1}");
+    TEST_HASH(0, "{\"a\":1,\"b\":2}", "{\"a\":2,\"b\":1}");
+    TEST_HASH(0, "{\"a\":{\"b\":1}}", "{\"b\":{\"a\":1}}");
+
+    /* 修改后哈希和相等比较随之改变 */
+    lept_init(&v1);
+    lept_init(&v2);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v1, "{\"a\":[1,2,{\"b\":3}],\"c\":\"d\"}"));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v2, "{\"a\":[1,2,{\"b\":4}],\"c\":\"d\"}"));
+    h = lept_hash(&v1);
+    EXPECT_TRUE(h != lept_hash(&v2));
+    EXPECT_FALSE(lept_is_equal(&v1, &v2));
+    lept_set_number(lept_find_object_value(lept_get_array_element(lept_find_object_value(&v2, "a", 1), 2), "b", 1), 3.0);
+    EXPECT_TRUE(lept_is_equal(&v1, &v2));
+    EXPECT_TRUE(h == lept_hash(&v2));
+    lept_pushback_array_element(lept_find_object_value(&v2, "a", 1));
+    EXPECT_TRUE(h != lept_hash(&v2));
+    EXPECT_FALSE(lept_is_equal(&v1, &v2));
+    lept_popback_array_element(lept_find_object_value(&v2, "a", 1));
+    EXPECT_TRUE(h == lept_hash(&v2));
+    lept_remove_object_value(&v2, lept_find_object_index(&v2, "c", 1));
+    EXPECT_TRUE(h != lept_hash(&v2));
+    lept_set_string(lept_set_object_value(&v2, "c", 1), "d", 1);
+    EXPECT_TRUE(h == lept_hash(&v2));
+    lept_copy(&v1, &v2);
+    EXPECT_TRUE(h == lept_hash(&v1));
+    lept_free(&v1);
+    lept_free(&v2);
+
+    /* 经保存的子结点指针修改，祖先的哈希也要改变 */
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v1, "{\"x\":[1,2]}"));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v2, "{\"x\":[1,2,3]}"));
+    h = lept_hash(&v1);
+    EXPECT_TRUE(h != lept_hash(&v2));
+    inner = lept_find_object_value(&v1, "x", 1);
+    lept_set_number(lept_pushback_array_element(inner), 3.0);
+    EXPECT_TRUE(lept_is_equal(&v1, &v2));
+    EXPECT_TRUE(lept_hash(&v1) == lept_hash(&v2));
+    lept_popback_array_element(inner);
+    EXPECT_TRUE(h == lept_hash(&v1));
+    EXPECT_FALSE(lept_is_equal(&v1, &v2));
+    lept_free(&v1);
+    lept_free(&v2);
+}
+
 static void test_copy() {
     lept_value v1, v2;
     lept_init(&v1);
@@ -482,6 +1023,158 @@ static void test_copy() {
     lept_free(&v2);
 }
 
+static void test_copy_deep() {
+    lept_value v1, v2, *e;
+    lept_parse_options opt;
+    char* json, *p;
+    size_t i, n = 100000;
+
+    /* 交替嵌套 n 层 [{"a":...}]，深度远超递归所能承受的层数 */
+    p = json = (char*)malloc(n * 8 + 2);
+    for (i = 0; i < n; i++) {
+        memcpy(p, "[{\"a\":", 6);
+        p += 6;
+    }
+    *p++ = '1';
+    for (i = 0; i < n; i++) {
+        *p++ = '}';
+        *p++ = ']';
+    }
+    *p = '\0';
+    memset(&opt, 0, sizeof(opt));
+    opt.max_depth = (size_t)-1;
+    lept_init(&v1);
+    lept_init(&v2);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_opt(&v1, json, &opt));
+    lept_copy(&v2, &v1);
+    EXPECT_TRUE(lept_is_equal(&v1, &v2));
+    EXPECT_TRUE(lept_hash(&v1) == lept_hash(&v2));
+    for (e = &v2; lept_get_type(e) == LEPT_ARRAY; )
+        e = lept_find_object_value(lept_get_array_element(e, 0), "a", 1);
+    EXPECT_EQ_DOUBLE(1.0, lept_get_number(e));
+    lept_set_number(e, 2.0);
+    EXPECT_FALSE(lept_is_equal(&v1, &v2));
+    EXPECT_TRUE(lept_hash(&v1) != lept_hash(&v2));
+    lept_free(&v1);
+    lept_free(&v2);
+    free(json);
+}
+
+static void test_copy_object() {
+    lept_value v1, v2;
+    size_t i;
+    char key[8];
+    lept_init(&v1);
+    lept_init(&v2);
+    lept_set_object(&v1, 0);
+    for (i = 0; i < 1000; i++) {
+        sprintf(key, "k%d", (int)i);
+        lept_set_number(lept_set_object_value(&v1, key, strlen(key)), (double)i);
+    }
+    lept_copy(&v2, &v1);
+    EXPECT_EQ_SIZE_T(1000, lept_get_object_size(&v2));
+    for (i = 0; i < 1000; i++) {
+        sprintf(key, "k%d", (int)i);
+        EXPECT_TRUE(strcmp(key, lept_get_object_key(&v2, i)) == 0);
+        EXPECT_EQ_DOUBLE((double)i, lept_get_number(lept_get_object_value(&v2, i)));
+    }
+    EXPECT_TRUE(lept_is_equal(&v1, &v2));
+    lept_free(&v1);
+    lept_free(&v2);
+}
+
+static void test_copy_shared() {
+    lept_value v1, v2, v3, a, b;
+    lept_value* pv;
+    lept_path* path;
+    lept_path_iter it;
+    const lept_value* b1;
+    lept_init(&v1);
+    lept_init(&v2);
+    lept_init(&v3);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v1, "{\"a\":[1,{\"x\":\"s\"}],\"b\":{\"c\":[true]},\"d\":\"str\"}"));
+    lept_copy_shared(&v2, &v1);
+    EXPECT_TRUE(lept_is_equal(&v1, &v2));
+    EXPECT_TRUE(lept_hash(&v1) == lept_hash(&v2));
+
+    /* 修改 v2.a[1].x 只分离根、a、a[1] 三层，b 仍然共享 */
+    b1 = lept_find_object_value(&v1, "b", 1);
+    lept_set_string(lept_find_object_value(lept_get_array_element(lept_find_object_value(&v2, "a", 1), 1), "x", 1), "t", 1);
+    EXPECT_FALSE(lept_is_equal(&v1, &v2));
+    EXPECT_EQ_STRING("s", lept_get_string(lept_find_object_value(lept_get_array_element(lept_find_object_value(&v1, "a", 1), 1), "x", 1)), 1);
+    EXPECT_EQ_STRING("t", lept_get_string(lept_find_object_value(lept_get_array_element(lept_find_object_value(&v2, "a", 1), 1), "x", 1)), 1);
+    EXPECT_TRUE(lept_get_array_element(lept_find_object_value(&v1, "a", 1), 0) != lept_get_array_element(lept_find_object_value(&v2, "a", 1), 0));
+    EXPECT_TRUE(lept_get_object_key(b1, 0) == lept_get_object_key(lept_find_object_value(&v2, "b", 1), 0));
+
+    /* 源一方修改也不影响副本；多级共享 */
+    lept_copy_shared(&v3, &v2);
+    lept_pushback_array_element(lept_find_object_value(lept_find_object_value(&v1, "b", 1), "c", 1));
+    EXPECT_EQ_SIZE_T(2, lept_get_array_size(lept_find_object_value(lept_find_object_value(&v1, "b", 1), "c", 1)));
+    EXPECT_EQ_SIZE_T(1, lept_get_array_size(lept_find_object_value(lept_find_object_value(&v2, "b", 1), "c", 1)));
+    lept_remove_object_value(&v2, lept_find_object_index(&v2, "d", 1));
+    lept_shrink_object(&v2);
+    EXPECT_EQ_SIZE_T(2, lept_get_object_size(&v2));
+    EXPECT_EQ_SIZE_T(3, lept_get_object_size(&v3));
+    EXPECT_EQ_STRING("str", lept_get_string(lept_find_object_value(&v3, "d", 1)), 3);
+
+    /* 拷贝之后 src 一方先写时分离的是 src；经访问函数重新取得的指针只修改 src */
+    lept_init(&a);
+    lept_init(&b);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&a, "[1,2]"));
+    lept_copy_shared(&b, &a);
+    EXPECT_EQ_DOUBLE(2.0, lept_get_number(lept_get_array_element(&a, 1)));
+    lept_set_number(lept_get_array_element(&a, 0), 99.0);
+    EXPECT_EQ_DOUBLE(99.0, lept_get_number(lept_get_array_element(&a, 0)));
+    EXPECT_EQ_DOUBLE(1.0, lept_get_number(lept_get_array_element(&b, 0)));
+    lept_set_number(lept_get_array_element(&b, 1), 7.0);
+    EXPECT_EQ_DOUBLE(2.0, lept_get_number(lept_get_array_element(&a, 1)));
+    EXPECT_EQ_DOUBLE(7.0, lept_get_number(lept_get_array_element(&b, 1)));
+    lept_free(&a);
+    lept_free(&b);
+
+    /* JSONPath 切片的结果也先分离共享的存储，写入只影响所查询的一方 */
+    lept_init(&a);
+    lept_init(&b);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&a, "[1,2,3]"));
+    lept_copy_shared(&b, &a);
+    path = lept_path_compile("$[0:2]");
+    lept_path_iter_init(&it);
+    lept_path_iter_begin(&it, path, &b);
+    while ((pv = lept_path_iter_next(&it)) != NULL)
+        lept_set_number(pv, 99.0);
+    lept_path_free(path);
+    EXPECT_EQ_DOUBLE(1.0, lept_get_number(lept_get_array_element(&a, 0)));
+    EXPECT_EQ_DOUBLE(2.0, lept_get_number(lept_get_array_element(&a, 1)));
+    EXPECT_EQ_DOUBLE(99.0, lept_get_number(lept_get_array_element(&b, 1)));
+    lept_free(&a);
+    lept_free(&b);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&a, "[{\"x\":1},{\"x\":2}]"));
+    lept_copy_shared(&b, &a);
+    path = lept_path_compile("$[0:1].x");
+    lept_path_iter_begin(&it, path, &b);
+    while ((pv = lept_path_iter_next(&it)) != NULL)
+        lept_set_number(pv, 99.0);
+    lept_path_free(path);
+    lept_path_iter_free(&it);
+    EXPECT_EQ_DOUBLE(1.0, lept_get_number(lept_find_object_value(lept_get_array_element(&a, 0), "x", 1)));
+    EXPECT_EQ_DOUBLE(99.0, lept_get_number(lept_find_object_value(lept_get_array_element(&b, 0), "x", 1)));
+    lept_free(&a);
+    lept_free(&b);
+
+    /* 释放原件后副本仍然完整；src 在 dst 之内 */
+    lept_free(&v2);
+    lept_copy_shared(&v1, lept_find_object_value(&v1, "b", 1));
+    EXPECT_EQ_INT(LEPT_TRUE, lept_get_type(lept_get_array_element(lept_find_object_value(&v1, "c", 1), 0)));
+    lept_copy_shared(&v2, &v3);
+    lept_free(&v3);
+    EXPECT_EQ_SIZE_T(2, lept_get_array_size(lept_find_object_value(&v2, "a", 1)));
+    lept_copy_shared(&v3, lept_find_object_value(&v2, "d", 1));
+    EXPECT_EQ_STRING("str", lept_get_string(&v3), 3);
+    lept_free(&v1);
+    lept_free(&v2);
+    lept_free(&v3);
+}
+
 static void test_move() {
     lept_value v1, v2, v3;
     lept_init(&v1);
@@ -698,6 +1391,226 @@ static void test_access_object() {
 #endif
 }
 
+#define TEST_POINTER(expect, doc, pointer)\
+    do {\
+        lept_pointer* p = lept_pointer_compile(pointer, sizeof(pointer) - 1);\
+        lept_value e, *pv;\
+        EXPECT_TRUE(p != NULL);\
+        lept_init(&e);\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&e, expect));\
+        pv = lept_pointer_get(p, doc);\
+        EXPECT_TRUE(pv != NULL && lept_is_equal(&e, pv));\
+        lept_free(&e);\
+        lept_pointer_free(p);\
+    } while(0)
+
+static void test_access_pointer() {
+    lept_value v, *pv;
+    lept_pointer* p;
+    /* RFC 6901 第5节的例子 */
+    lept_init(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v,
+        "{\"foo\":[\"bar\",\"baz\"],\"\":0,\"a/b\":1,\"c%d\":2,\"e^f\":3,\"g|h\":4,"
+        "\"i\\\\j\":5,\"k\\\"l\":6,\" \":7,\"m~n\":8}"));
+    TEST_POINTER("{\"foo\":[\"bar\",\"baz\"],\"\":0,\"a/b\":1,\"c%d\":2,\"e^f\":3,\"g|h\":4,"
+        "\"i\\\\j\":5,\"k\\\"l\":6,\" \":7,\"m~n\":8}", &v, "");
+    TEST_POINTER("[\"bar\",\"baz\"]", &v, "/foo");
+    TEST_POINTER("\"bar\"", &v, "/foo/0");
+    TEST_POINTER("0", &v, "/");
+    TEST_POINTER("1", &v, "/a~1b");
+    TEST_POINTER("2", &v, "/c%d");
+    TEST_POINTER("3", &v, "/e^f");
+    TEST_POINTER("4", &v, "/g|h");
+    TEST_POINTER("5", &v, "/i\\j");
+    TEST_POINTER("6", &v, "/k\"l");
+    TEST_POINTER("7", &v, "/ ");
+    TEST_POINTER("8", &v, "/m~0n");
+
+    /* 不存在的路径和非法下标 */
+    EXPECT_TRUE(lept_pointer_compile("foo", 3) == NULL);
+    EXPECT_TRUE(lept_pointer_compile("/a~2", 4) == NULL);
+    EXPECT_TRUE(lept_pointer_compile("/a~", 3) == NULL);
+    p = lept_pointer_compile("/foo/2", 6);
+    EXPECT_TRUE(lept_pointer_get(p, &v) == NULL);
+    lept_pointer_free(p);
+    p = lept_pointer_compile("/foo/01", 7);
+    EXPECT_TRUE(lept_pointer_get(p, &v) == NULL);
+    lept_pointer_free(p);
+    p = lept_pointer_compile("/foo/-", 6);
+    EXPECT_TRUE(lept_pointer_get(p, &v) == NULL);
+
+    /* 写入 */
+    pv = lept_pointer_set(p, &v);
+    EXPECT_TRUE(pv != NULL);
+    lept_set_string(pv, "qux", 3);
+    lept_pointer_free(p);
+    TEST_POINTER("[\"bar\",\"baz\",\"qux\"]", &v, "/foo");
+    p = lept_pointer_compile("/x/y", 4);
+    EXPECT_TRUE(lept_pointer_set(p, &v) == NULL);
+    lept_pointer_free(p);
+    p = lept_pointer_compile("/x", 2);
+    lept_set_object(lept_pointer_set(p, &v), 0);
+    lept_pointer_free(p);
+    p = lept_pointer_compile("/x/y", 4);
+    lept_set_boolean(lept_pointer_set(p, &v), 1);
+    lept_pointer_free(p);
+    TEST_POINTER("{\"y\":true}", &v, "/x");
+    p = lept_pointer_compile("/foo/5", 6);
+    EXPECT_TRUE(lept_pointer_set(p, &v) == NULL);
+    lept_pointer_free(p);
+    lept_free(&v);
+}
+
+#define TEST_PATH(expect, doc, query)\
+    do {\
+        lept_path* p = lept_path_compile(query);\
+        lept_value e, r, *pv;\
+        EXPECT_TRUE(p != NULL);\
+        if (p) {\
+            lept_init(&e);\
+            lept_init(&r);\
+            EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&e, expect));\
+            lept_set_array(&r, 0);\
+            lept_path_iter_begin(&it, p, doc);\
+            while ((pv = lept_path_iter_next(&it)) != NULL)\
+                lept_copy(lept_pushback_array_element(&r), pv);\
+            EXPECT_TRUE(lept_is_equal(&e, &r));\
+            lept_free(&e);\
+            lept_free(&r);\
+            lept_path_free(p);\
+        }\
+    } while(0)
+
+static void test_access_path() {
+    static const char* invalid[] = {
+        "", "foo", "$.", "$[", "$[0", "$['a]", "$[?(@.a <)]", "$[?(1)]", "$[?(@.a == 1]", "$[::0]", "$[?(@..a)]", "$[?(@.*)]", "$ x"
+    };
+    lept_value v, *pv;
+    lept_path_iter it;
+    lept_path* p;
+    size_t i;
+    lept_init(&v);
+    lept_path_iter_init(&it);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v,
+        "{\"store\":{"
+            "\"book\":["
+                "{\"category\":\"reference\",\"author\":\"Nigel Rees\",\"title\":\"Sayings of the Century\",\"price\":8.95},"
+                "{\"category\":\"fiction\",\"author\":\"Evelyn Waugh\",\"title\":\"Sword of Honour\",\"price\":12.99},"
+                "{\"category\":\"fiction\",\"author\":\"Herman Melville\",\"title\":\"Moby Dick\",\"isbn\":\"0-553-21311-3\",\"price\":8.99},"
+                "{\"category\":\"fiction\",\"author\":\"J. R. R. Tolkien\",\"title\":\"The Lord of the Rings\",\"isbn\":\"0-395-19395-8\",\"price\":22.99}"
+            "],"
+            "\"bicycle\":{\"color\":\"red\",\"price\":399}"
+        "}}"));
+    TEST_PATH("[\"Nigel Rees\",\"Evelyn Waugh\",\"Herman Melville\",\"J. R. R. Tolkien\"]", &v, "$.store.book[*].author");
+    TEST_PATH("[\"Nigel Rees\",\"Evelyn Waugh\",\"Herman Melville\",\"J. R. R. Tolkien\"]", &v, "$..author");
+    TEST_PATH("[8.95,12.99,8.99,22.99,399]", &v, "$.store..price");
+    TEST_PATH("[\"Moby Dick\"]", &v, "$..book[2].title");
+    TEST_PATH("[\"The Lord of the Rings\"]", &v, "$..book[-1].title");
+    TEST_PATH("[\"Nigel Rees\",\"Evelyn Waugh\"]", &v, "$['store']['book'][:2].author");
+    TEST_PATH("[\"Nigel Rees\",\"Herman Melville\"]", &v, "$.store.book[0::2][\"author\"]");
+    TEST_PATH("[\"Sayings of the Century\",\"Moby Dick\"]", &v, "$..book[?(@.price < 10)].title");
+    TEST_PATH("[\"Moby Dick\",\"The Lord of the Rings\"]", &v, "$..book[?@.isbn].title");
+    TEST_PATH("[\"Sword of Honour\"]", &v, "$..book[?(@.category == 'fiction' && !@.isbn)].title");
+    TEST_PATH("[\"Sayings of the Century\",\"The Lord of the Rings\"]", &v, "$..book[?(@.price > 20 || @.category != \"fiction\")].title");
+    TEST_PATH("[\"Evelyn Waugh\"]", &v, "$..book[?(@.price >= 12.99 && @.price <= $.store.book[1].price)].author");
+    TEST_PATH("[\"red\"]", &v, "$..[?(@.color)].color");
+    TEST_PATH("[]", &v, "$.store.book[4]");
+    TEST_PATH("[]", &v, "$.store.bicycle[0]");
+    TEST_PATH("[]", &v, "$..book[?(@.price < 'x')]");
+    TEST_PATH("[]", &v, "$..missing");
+    TEST_PATH("[399]", &v, "$.store.*.price");
+
+    /* 查询结果可以写入，切片也一样 */
+    p = lept_path_compile("$.store.book[1:3].price");
+    lept_path_iter_begin(&it, p, &v);
+    while ((pv = lept_path_iter_next(&it)) != NULL)
+        lept_set_number(pv, 1.0);
+    lept_path_free(p);
+    TEST_PATH("[8.95,1,1,22.99]", &v, "$.store.book[*].price");
+    p = lept_path_compile("$.store.book[1::2].category");
+    lept_path_iter_begin(&it, p, &v);
+    while ((pv = lept_path_iter_next(&it)) != NULL)
+        lept_set_null(pv);
+    lept_path_free(p);
+    TEST_PATH("[\"reference\",null,\"fiction\",null]", &v, "$.store.book[*].category");
+    lept_path_iter_free(&it);
+    lept_free(&v);
+
+    for (i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+        EXPECT_TRUE(lept_path_compile(invalid[i]) == NULL);
+}
+
+static void test_access_object_index() {
+    lept_value o, o2, patch;
+    char key[16];
+    size_t i, n;
+
+    EXPECT_TRUE(lept_key_hash("", 0) == 14695981039346656037ULL);
+    EXPECT_TRUE(lept_key_hash("a", 1) == 0xaf63dc4c8601ec8cULL);
+
+    /* 成员达到 LEPT_OBJECT_INDEX_MIN 后经键索引查找，增删成员后结果应与线性查找一致 */
+    lept_init(&o);
+    lept_set_object(&o, 0);
+    for (i = 0; i < 100; i++) {
+        n = (size_t)sprintf(key, "k%d", (int)i);
+        lept_set_number(lept_set_object_value(&o, key, n), (double)i);
+        EXPECT_EQ_SIZE_T(i, lept_find_object_index_hashed(&o, key, n, lept_key_hash(key, n)));
+        EXPECT_EQ_SIZE_T(0, lept_find_object_index(&o, "k0", 2));
+    }
+    EXPECT_EQ_SIZE_T(LEPT_KEY_NOT_EXIST, lept_find_object_index(&o, "k100", 4));
+    EXPECT_EQ_SIZE_T(LEPT_KEY_NOT_EXIST, lept_find_object_index(&o, "", 0));
+    lept_remove_object_value(&o, 0);
+    EXPECT_EQ_SIZE_T(LEPT_KEY_NOT_EXIST, lept_find_object_index(&o, "k0", 2));
+    EXPECT_EQ_SIZE_T(49, lept_find_object_index(&o, "k50", 3));
+    EXPECT_EQ_DOUBLE(99.0, lept_get_number(lept_find_object_value_hashed(&o, "k99", 3, lept_key_hash("k99", 3))));
+
+    /* 拷贝有自己的索引 */
+    lept_init(&o2);
+    lept_copy(&o2, &o);
+    EXPECT_EQ_SIZE_T(49, lept_find_object_index(&o2, "k50", 3));
+    lept_remove_object_value(&o2, 0);
+    EXPECT_EQ_SIZE_T(48, lept_find_object_index(&o2, "k50", 3));
+    EXPECT_EQ_SIZE_T(49, lept_find_object_index(&o, "k50", 3));
+    EXPECT_TRUE(!lept_is_equal(&o, &o2));
+    lept_free(&o2);
+
+    /* 常量查找不建立索引，刚解析的大对象也能查到；键顺序不同的大对象比较时使用临时索引 */
+    lept_init(&o2);
+    lept_set_object(&o2, 0);
+    for (i = lept_get_object_size(&o); i-- > 0; )
+        lept_copy(lept_set_object_value(&o2, lept_get_object_key(&o, i), lept_get_object_key_length(&o, i)), lept_get_object_value(&o, i));
+    EXPECT_EQ_SIZE_T(lept_get_object_size(&o) - 50, lept_find_object_index(&o2, "k50", 3));
+    EXPECT_TRUE(lept_is_equal(&o, &o2));
+    EXPECT_TRUE(lept_is_equal(&o2, &o));
+    lept_free(&o2);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&o2, "{\"a\":1,\"b\":2,\"c\":3,\"d\":4,\"e\":5,\"f\":6,\"g\":7,\"h\":8,\"i\":9}"));
+    EXPECT_EQ_SIZE_T(7, lept_find_object_index(&o2, "h", 1));
+    EXPECT_EQ_SIZE_T(LEPT_KEY_NOT_EXIST, lept_find_object_index_hashed(&o2, "j", 1, lept_key_hash("j", 1)));
+    EXPECT_EQ_DOUBLE(9.0, lept_get_number(lept_find_object_value(&o2, "i", 1)));
+    EXPECT_EQ_SIZE_T(0, lept_find_object_index(&o2, "a", 1));
+    lept_free(&o2);
+
+    /* JSON Patch 在中间插入和删除成员 */
+    lept_init(&patch);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&patch, "[{\"op\":\"remove\",\"path\":\"/k1\"},{\"op\":\"move\",\"from\":\"/k2\",\"path\":\"/x\"}]"));
+    EXPECT_EQ_INT(LEPT_PATCH_OK, lept_patch_apply(&o, &patch));
+    EXPECT_EQ_SIZE_T(LEPT_KEY_NOT_EXIST, lept_find_object_index(&o, "k1", 2));
+    EXPECT_EQ_SIZE_T(LEPT_KEY_NOT_EXIST, lept_find_object_index(&o, "k2", 2));
+    EXPECT_EQ_DOUBLE(2.0, lept_get_number(lept_find_object_value(&o, "x", 1)));
+    EXPECT_EQ_DOUBLE(3.0, lept_get_number(lept_get_object_value(&o, lept_find_object_index(&o, "k3", 2))));
+    lept_free(&patch);
+
+    lept_clear_object(&o);
+    EXPECT_EQ_SIZE_T(LEPT_KEY_NOT_EXIST, lept_find_object_index(&o, "k3", 2));
+    lept_free(&o);
+
+    /* 重复的键：与线性查找一样返回第一个 */
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&o, "{\"a\":0,\"b\":1,\"c\":2,\"d\":3,\"e\":4,\"f\":5,\"g\":6,\"a\":7,\"h\":8}"));
+    EXPECT_EQ_SIZE_T(0, lept_find_object_index(&o, "a", 1));
+    EXPECT_EQ_SIZE_T(8, lept_find_object_index(&o, "h", 1));
+    lept_free(&o);
+}
+
 static void test_access() {
     test_access_null();
     test_access_boolean();
@@ -705,6 +1618,1083 @@ static void test_access() {
     test_access_string();
     test_access_array();
     test_access_object();
+    test_access_object_index();
+    test_access_pointer();
+    test_access_path();
+}
+
+static void test_stats() {
+    lept_stats s;
+    lept_parse_options opt;
+    lept_value v;
+    char* json;
+    size_t length;
+    const char* text = "{\"a\":[1,2,{\"b\":null}],\"s\":\"abc\",\"t\":true}";
+
+    lept_stats_reset(&s);
+    memset(&opt, 0, sizeof(opt));
+    opt.stats = &s;
+    lept_init(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_opt(&v, text, &opt));
+    EXPECT_EQ_SIZE_T(strlen(text), s.parse_bytes);
+    EXPECT_EQ_SIZE_T(1, s.nodes[LEPT_NULL]);
+    EXPECT_EQ_SIZE_T(0, s.nodes[LEPT_FALSE]);
+    EXPECT_EQ_SIZE_T(1, s.nodes[LEPT_TRUE]);
+    EXPECT_EQ_SIZE_T(2, s.nodes[LEPT_NUMBER]);
+    EXPECT_EQ_SIZE_T(1, s.nodes[LEPT_STRING]);
+    EXPECT_EQ_SIZE_T(1, s.nodes[LEPT_ARRAY]);
+    EXPECT_EQ_SIZE_T(2, s.nodes[LEPT_OBJECT]);
+    EXPECT_EQ_SIZE_T(3, s.max_depth);
+    EXPECT_EQ_SIZE_T(1, s.stack_mallocs);
+    EXPECT_TRUE(s.stack_alloc_bytes >= s.stack_peak);
+    EXPECT_TRUE(s.stack_peak > 0);
+    EXPECT_TRUE(s.string_seconds >= 0.0 && s.number_seconds >= 0.0 && s.structure_seconds >= 0.0);
+
+    /* 线程统计 */
+    lept_stats_reset(&s);
+    EXPECT_TRUE(lept_set_thread_stats(&s) == NULL);
+    json = lept_stringify(&v, &length);
+    EXPECT_EQ_SIZE_T(length, s.stringify_bytes);
+    EXPECT_EQ_SIZE_T(1, s.stack_mallocs);
+    lept_free(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));
+    EXPECT_EQ_SIZE_T(length, s.parse_bytes);
+    EXPECT_TRUE(lept_set_thread_stats(NULL) == &s);
+    lept_free(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));
+    EXPECT_EQ_SIZE_T(length, s.parse_bytes);
+    lept_free(&v);
+    free(json);
+}
+
+#define TEST_PATCH(expect_ret, expect, doc, patch)\
+    do {\
+        lept_value d, p, e;\
+        lept_init(&d);\
+        lept_init(&p);\
+        lept_init(&e);\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&d, doc));\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&p, patch));\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&e, expect));\
+        EXPECT_EQ_INT(expect_ret, lept_patch_apply(&d, &p));\
+        EXPECT_TRUE(lept_is_equal(&e, &d));\
+        lept_free(&d);\
+        lept_free(&p);\
+        lept_free(&e);\
+    } while(0)
+
+static void test_patch() {
+    /* RFC 6902 附录A */
+    TEST_PATCH(LEPT_PATCH_OK, "{\"baz\":\"qux\",\"foo\":\"bar\"}", "{\"foo\":\"bar\"}",
+        "[{\"op\":\"add\",\"path\":\"/baz\",\"value\":\"qux\"}]");
+    TEST_PATCH(LEPT_PATCH_OK, "{\"foo\":[\"bar\",\"qux\",\"baz\"]}", "{\"foo\":[\"bar\",\"baz\"]}",
+        "[{\"op\":\"add\",\"path\":\"/foo/1\",\"value\":\"qux\"}]");
+    TEST_PATCH(LEPT_PATCH_OK, "{\"foo\":\"bar\"}", "{\"baz\":\"qux\",\"foo\":\"bar\"}",
+        "[{\"op\":\"remove\",\"path\":\"/baz\"}]");
+    TEST_PATCH(LEPT_PATCH_OK, "{\"foo\":[\"bar\",\"baz\"]}", "{\"foo\":[\"bar\",\"qux\",\"baz\"]}",
+        "[{\"op\":\"remove\",\"path\":\"/foo/1\"}]");
+    TEST_PATCH(LEPT_PATCH_OK, "{\"baz\":\"boo\",\"foo\":\"bar\"}", "{\"baz\":\"qux\",\"foo\":\"bar\"}",
+        "[{\"op\":\"replace\",\"path\":\"/baz\",\"value\":\"boo\"}]");
+    TEST_PATCH(LEPT_PATCH_OK, "{\"foo\":{\"bar\":\"baz\"},\"qux\":{\"corge\":\"grault\",\"thud\":\"fred\"}}",
+        "{\"foo\":{\"bar\":\"baz\",\"waldo\":\"fred\"},\"qux\":{\"corge\":\"grault\"}}",
+        "[{\"op\":\"move\",\"from\":\"/foo/waldo\",\"path\":\"/qux/thud\"}]");
+    TEST_PATCH(LEPT_PATCH_OK, "{\"foo\":[\"all\",\"cows\",\"eat\",\"grass\"]}", "{\"foo\":[\"all\",\"grass\",\"cows\",\"eat\"]}",
+        "[{\"op\":\"move\",\"from\":\"/foo/1\",\"path\":\"/foo/3\"}]");
+    TEST_PATCH(LEPT_PATCH_OK, "{\"baz\":\"qux\",\"foo\":[\"a\",2,\"c\"]}", "{\"baz\":\"qux\",\"foo\":[\"a\",2,\"c\"]}",
+        "[{\"op\":\"test\",\"path\":\"/baz\",\"value\":\"qux\"},{\"op\":\"test\",\"path\":\"/foo/1\",\"value\":2}]");
+    TEST_PATCH(LEPT_PATCH_TEST_FAILED, "{\"baz\":\"qux\"}", "{\"baz\":\"qux\"}",
+        "[{\"op\":\"test\",\"path\":\"/baz\",\"value\":\"bar\"}]");
+    TEST_PATCH(LEPT_PATCH_OK, "{\"foo\":\"bar\",\"child\":{\"grandchild\":{}}}", "{\"foo\":\"bar\"}",
+        "[{\"op\":\"add\",\"path\":\"/child\",\"value\":{\"grandchild\":{}}}]");
+    TEST_PATCH(LEPT_PATCH_PATH_NOT_FOUND, "{\"foo\":\"bar\"}", "{\"foo\":\"bar\"}",
+        "[{\"op\":\"add\",\"path\":\"/baz/bat\",\"value\":\"qux\"}]");
+    TEST_PATCH(LEPT_PATCH_OK, "{\"foo\":[\"bar\",[\"abc\",\"def\"]]}", "{\"foo\":[\"bar\"]}",
+        "[{\"op\":\"add\",\"path\":\"/foo/-\",\"value\":[\"abc\",\"def\"]}]");
+    TEST_PATCH(LEPT_PATCH_OK, "{\"/\":9,\"~1\":10}", "{\"/\":9,\"~1\":10}",
+        "[{\"op\":\"test\",\"path\":\"/~01\",\"value\":10}]");
+    TEST_PATCH(LEPT_PATCH_OK, "[1,2]", "{\"a\":1}",
+        "[{\"op\":\"replace\",\"path\":\"\",\"value\":[1,2]}]");
+    TEST_PATCH(LEPT_PATCH_OK, "{\"a\":[1,1]}", "{\"a\":[1]}",
+        "[{\"op\":\"copy\",\"from\":\"/a/0\",\"path\":\"/a/-\"}]");
+    TEST_PATCH(LEPT_PATCH_OK, "{\"a\":1}", "{\"a\":1}",
+        "[{\"op\":\"move\",\"from\":\"/a\",\"path\":\"/a\"}]");
+
+    /* 出错时撤销全部操作 */
+    TEST_PATCH(LEPT_PATCH_PATH_NOT_FOUND, "{\"a\":[1,2,3],\"b\":{\"c\":1}}", "{\"a\":[1,2,3],\"b\":{\"c\":1}}",
+        "[{\"op\":\"remove\",\"path\":\"/a/0\"},{\"op\":\"add\",\"path\":\"/b/d\",\"value\":[4]},{\"op\":\"replace\",\"path\":\"/b/c\",\"value\":2},"
+        "{\"op\":\"move\",\"from\":\"/a/1\",\"path\":\"/b/c\"},{\"op\":\"add\",\"path\":\"/a/-\",\"value\":5},"
+        "{\"op\":\"add\",\"path\":\"\",\"value\":0},{\"op\":\"remove\",\"path\":\"/x\"}]");
+    TEST_PATCH(LEPT_PATCH_PATH_NOT_FOUND, "{\"a\":[1,2],\"b\":{}}", "{\"a\":[1,2],\"b\":{}}",
+        "[{\"op\":\"move\",\"from\":\"/a/0\",\"path\":\"/b/c\"},{\"op\":\"move\",\"from\":\"/a/0\",\"path\":\"/x/y\"}]");
+    TEST_PATCH(LEPT_PATCH_PATH_NOT_FOUND, "{\"a\":[1]}", "{\"a\":[1]}",
+        "[{\"op\":\"add\",\"path\":\"/a/0\",\"value\":0},{\"op\":\"add\",\"path\":\"/a/3\",\"value\":0}]");
+    TEST_PATCH(LEPT_PATCH_PATH_NOT_FOUND, "{\"a\":[1]}", "{\"a\":[1]}",
+        "[{\"op\":\"replace\",\"path\":\"/a/1\",\"value\":0}]");
+    TEST_PATCH(LEPT_PATCH_INVALID_OPERATION, "{\"a\":{\"b\":1}}", "{\"a\":{\"b\":1}}",
+        "[{\"op\":\"remove\",\"path\":\"/a/b\"},{\"op\":\"move\",\"from\":\"/a\",\"path\":\"/a/b\"}]");
+    TEST_PATCH(LEPT_PATCH_INVALID_OPERATION, "{}", "{}", "[{\"op\":\"add\",\"path\":\"/a\"}]");
+    TEST_PATCH(LEPT_PATCH_INVALID_OPERATION, "{}", "{}", "[{\"op\":\"frob\",\"path\":\"/a\"}]");
+    TEST_PATCH(LEPT_PATCH_INVALID_OPERATION, "{}", "{}", "[{\"op\":\"remove\",\"path\":\"a\"}]");
+    TEST_PATCH(LEPT_PATCH_INVALID_OPERATION, "{}", "{}", "{\"op\":\"remove\",\"path\":\"/a\"}");
+}
+
+#define TEST_MERGE_PATCH(expect, target, patch)\
+    do {\
+        lept_value t, p, e;\
+        lept_init(&t);\
+        lept_init(&p);\
+        lept_init(&e);\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&t, target));\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&p, patch));\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&e, expect));\
+        lept_merge_patch(&t, &p);\
+        EXPECT_TRUE(lept_is_equal(&e, &t));\
+        lept_free(&t);\
+        lept_free(&p);\
+        lept_free(&e);\
+    } while(0)
+
+static void test_merge_patch() {
+    /* RFC 7396 附录A */
+    TEST_MERGE_PATCH("{\"a\":\"c\"}", "{\"a\":\"b\"}", "{\"a\":\"c\"}");
+    TEST_MERGE_PATCH("{\"a\":\"b\",\"b\":\"c\"}", "{\"a\":\"b\"}", "{\"b\":\"c\"}");
+    TEST_MERGE_PATCH("{}", "{\"a\":\"b\"}", "{\"a\":null}");
+    TEST_MERGE_PATCH("{\"b\":\"c\"}", "{\"a\":\"b\",\"b\":\"c\"}", "{\"a\":null}");
+    TEST_MERGE_PATCH("{\"a\":\"c\"}", "{\"a\":[\"b\"]}", "{\"a\":\"c\"}");
+    TEST_MERGE_PATCH("{\"a\":[\"b\"]}", "{\"a\":\"c\"}", "{\"a\":[\"b\"]}");
+    TEST_MERGE_PATCH("{\"a\":{\"b\":\"d\"}}", "{\"a\":{\"b\":\"c\"}}", "{\"a\":{\"b\":\"d\",\"c\":null}}");
+    TEST_MERGE_PATCH("{\"a\":[1]}", "{\"a\":[{\"b\":\"c\"}]}", "{\"a\":[1]}");
+    TEST_MERGE_PATCH("[\"c\",\"d\"]", "[\"a\",\"b\"]", "[\"c\",\"d\"]");
+    TEST_MERGE_PATCH("[\"c\"]", "{\"a\":\"b\"}", "[\"c\"]");
+    TEST_MERGE_PATCH("null", "{\"a\":\"foo\"}", "null");
+    TEST_MERGE_PATCH("\"bar\"", "{\"a\":\"foo\"}", "\"bar\"");
+    TEST_MERGE_PATCH("{\"e\":null,\"a\":1}", "{\"e\":null}", "{\"a\":1}");
+    TEST_MERGE_PATCH("{\"a\":{\"bb\":{}}}", "[1,2]", "{\"a\":{\"bb\":{\"ccc\":null}}}");
+    TEST_MERGE_PATCH("{\"a\":{\"b\":{\"c\":1,\"d\":2},\"e\":{\"f\":3}},\"g\":4}", "{\"a\":{\"b\":{\"c\":0},\"x\":1},\"g\":4}",
+        "{\"a\":{\"b\":{\"c\":1,\"d\":2},\"e\":{\"f\":3},\"x\":null}}");
+}
+
+#define TEST_DIFF(a, b, expect_ops)\
+    do {\
+        lept_value va, vb, patch;\
+        lept_init(&va);\
+        lept_init(&vb);\
+        lept_init(&patch);\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&va, a));\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&vb, b));\
+        lept_diff(&va, &vb, &patch);\
+        EXPECT_EQ_SIZE_T(expect_ops, lept_get_array_size(&patch));\
+        EXPECT_EQ_INT(LEPT_PATCH_OK, lept_patch_apply(&va, &patch));\
+        EXPECT_TRUE(lept_is_equal(&va, &vb));\
+        lept_free(&va);\
+        lept_free(&vb);\
+        lept_free(&patch);\
+    } while(0)
+
+static void test_diff() {
+    lept_value a, b, patch;
+    size_t i;
+    TEST_DIFF("{\"a\":1}", "{\"a\":1}", 0);
+    TEST_DIFF("{\"a\":1,\"b\":[1,2]}", "{\"b\":[1,2],\"a\":1}", 0);
+    TEST_DIFF("0", "-0", 0);
+    TEST_DIFF("1", "\"1\"", 1);
+    TEST_DIFF("{\"a\":1}", "[1]", 1);
+    TEST_DIFF("{\"a\":1,\"b\":2}", "{\"a\":1,\"c\":2}", 2);
+    TEST_DIFF("{\"a\":{\"b\":{\"c\":1,\"d\":2}},\"e\":3}", "{\"a\":{\"b\":{\"c\":1,\"d\":4}},\"e\":3}", 1);
+    TEST_DIFF("[1,2,3,4,5]", "[1,2,9,4,5]", 1);
+    TEST_DIFF("[1,2,3,4,5]", "[1,2,4,5]", 1);
+    TEST_DIFF("[1,2,3,4,5]", "[0,1,2,3,4,5]", 1);
+    TEST_DIFF("[1,2,3,4,5]", "[1,5]", 3);
+    TEST_DIFF("[1,2]", "[1,2,3,4]", 2);
+    TEST_DIFF("[[1,{\"x\":[]}],{\"y\":null}]", "[[1,{\"x\":[true]}],{\"y\":false}]", 2);
+    TEST_DIFF("{\"a/b\":1,\"m~n\":2}", "{\"a/b\":3,\"m~n\":4}", 2);
+    TEST_DIFF("{}", "{\"\":{\"\":[]}}", 1);
+    TEST_DIFF("[]", "{}", 1);
+
+    /* 较大的文档：只修改一处 */
+    lept_init(&a);
+    lept_init(&patch);
+    lept_set_object(&a, 0);
+    for (i = 0; i < 1000; i++) {
+        char key[16];
+        lept_value* e = lept_set_object_value(&a, key, (size_t)sprintf(key, "k%d", (int)i));
+        lept_set_array(e, 0);
+        lept_set_number(lept_pushback_array_element(e), (double)i);
+    }
+    lept_init(&b);
+    lept_copy(&b, &a);
+    lept_set_number(lept_get_array_element(lept_find_object_value(&b, "k500", 4), 0), -1.0);
+    lept_diff(&a, &b, &patch);
+    EXPECT_EQ_SIZE_T(1, lept_get_array_size(&patch));
+    EXPECT_EQ_STRING("/k500/0", lept_get_string(lept_find_object_value(lept_get_array_element(&patch, 0), "path", 4)),
+        lept_get_string_length(lept_find_object_value(lept_get_array_element(&patch, 0), "path", 4)));
+    EXPECT_EQ_INT(LEPT_PATCH_OK, lept_patch_apply(&a, &patch));
+    EXPECT_TRUE(lept_is_equal(&a, &b));
+    lept_free(&a);
+    lept_free(&b);
+    lept_free(&patch);
+}
+
+#define TEST_CBOR(expect, json)\
+    do {\
+        lept_value v, v2;\
+        unsigned char* data;\
+        size_t length;\
+        lept_init(&v);\
+        lept_init(&v2);\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));\
+        data = lept_to_cbor(&v, &length);\
+        EXPECT_TRUE(sizeof(expect) - 1 == length && memcmp(expect, data, length) == 0);\
+        EXPECT_EQ_INT(LEPT_CBOR_OK, lept_from_cbor(&v2, data, length));\
+        EXPECT_TRUE(lept_is_equal(&v, &v2));\
+        free(data);\
+        lept_free(&v);\
+        lept_free(&v2);\
+    } while(0)
+
+#define TEST_CBOR_DECODE(json, data)\
+    do {\
+        lept_value v, v2;\
+        lept_init(&v);\
+        lept_init(&v2);\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));\
+        EXPECT_EQ_INT(LEPT_CBOR_OK, lept_from_cbor(&v2, (const unsigned char*)data, sizeof(data) - 1));\
+        EXPECT_TRUE(lept_is_equal(&v, &v2));\
+        lept_free(&v);\
+        lept_free(&v2);\
+    } while(0)
+
+#define TEST_CBOR_ERROR(error, data)\
+    do {\
+        lept_value v;\
+        lept_init(&v);\
+        v.type = LEPT_FALSE;\
+        EXPECT_EQ_INT(error, lept_from_cbor(&v, (const unsigned char*)data, sizeof(data) - 1));\
+        EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));\
+    } while(0)
+
+static void test_cbor() {
+    lept_value v, v2;
+    unsigned char* data;
+    size_t i, length;
+
+    /* RFC 8949 附录A */
+    TEST_CBOR("\x00", "0");
+    TEST_CBOR("\x17", "23");
+    TEST_CBOR("\x18\x18", "24");
+    TEST_CBOR("\x19\x03\xe8", "1000");
+    TEST_CBOR("\x1a\x00\x0f\x42\x40", "1000000");
+    TEST_CBOR("\x1b\x00\x00\x00\xe8\xd4\xa5\x10\x00", "1000000000000");
+    TEST_CBOR("\x20", "-1");
+    TEST_CBOR("\x38\x63", "-100");
+    TEST_CBOR("\x39\x03\xe7", "-1000");
+    TEST_CBOR("\xf9\x80\x00", "-0");
+    TEST_CBOR("\xf9\x3e\x00", "1.5");
+    TEST_CBOR("\xf9\x00\x01", "5.960464477539063e-8");
+    TEST_CBOR("\xf9\x04\x00", "0.00006103515625");
+    TEST_CBOR("\xfa\x30\x80\x00\x00", "9.313225746154785e-10");
+    TEST_CBOR("\xfa\x7f\x7f\xff\xff", "3.4028234663852886e+38");
+    TEST_CBOR("\xfb\x3f\xf1\x99\x99\x99\x99\x99\x9a", "1.1");
+    TEST_CBOR("\xfb\xc0\x10\x66\x66\x66\x66\x66\x66", "-4.1");
+    TEST_CBOR("\xfb\x7e\x37\xe4\x3c\x88\x00\x75\x9c", "1.0e+300");
+    TEST_CBOR("\xf4", "false");
+    TEST_CBOR("\xf5", "true");
+    TEST_CBOR("\xf6", "null");
+    TEST_CBOR("\x60", "\"\"");
+    TEST_CBOR("\x64\x49\x45\x54\x46", "\"IETF\"");
+    TEST_CBOR("\x62\xc3\xbc", "\"\\u00fc\"");
+    TEST_CBOR("\x80", "[]");
+    TEST_CBOR("\x83\x01\x82\x02\x03\x82\x04\x05", "[1,[2,3],[4,5]]");
+    TEST_CBOR("\xa0", "{}");
+    TEST_CBOR("\xa2\x61\x61\x01\x61\x62\x82\x02\x03", "{\"a\":1,\"b\":[2,3]}");
+
+    /* 只能解码的形式：不定长、标签、其它宽度 */
+    TEST_CBOR_DECODE("null", "\xf7");
+    TEST_CBOR_DECODE("1", "\xfa\x3f\x80\x00\x00");
+    TEST_CBOR_DECODE("100000", "\xfa\x47\xc3\x50\x00");
+    TEST_CBOR_DECODE("-18446744073709551616", "\x3b\xff\xff\xff\xff\xff\xff\xff\xff");
+    TEST_CBOR_DECODE("\"streaming\"", "\x7f\x65\x73\x74\x72\x65\x61\x64\x6d\x69\x6e\x67\xff");
+    TEST_CBOR_DECODE("\"\"", "\x7f\xff");
+    TEST_CBOR_DECODE("[]", "\x9f\xff");
+    TEST_CBOR_DECODE("[1,[2,3],[4,5]]", "\x9f\x01\x82\x02\x03\x9f\x04\x05\xff\xff");
+    TEST_CBOR_DECODE("{\"a\":1,\"b\":[2,3]}", "\xbf\x61\x61\x01\x61\x62\x9f\x02\x03\xff\xff");
+    TEST_CBOR_DECODE("{\"ab\":[]}", "\xbf\x7f\x61\x61\x61\x62\xff\x80\xff");
+    TEST_CBOR_DECODE("\"a\"", "\xc0\xd8\x20\x61\x61");
+
+    TEST_CBOR_ERROR(LEPT_CBOR_TRUNCATED, "");
+    TEST_CBOR_ERROR(LEPT_CBOR_TRUNCATED, "\x18");
+    TEST_CBOR_ERROR(LEPT_CBOR_TRUNCATED, "\x62\x61");
+    TEST_CBOR_ERROR(LEPT_CBOR_TRUNCATED, "\x82\x01");
+    TEST_CBOR_ERROR(LEPT_CBOR_TRUNCATED, "\x9f\x01");
+    TEST_CBOR_ERROR(LEPT_CBOR_TRUNCATED, "\x9b\xff\xff\xff\xff\xff\xff\xff\xff\x01");
+    TEST_CBOR_ERROR(LEPT_CBOR_TRUNCATED, "\xa2\x61\x61\x01");
+    TEST_CBOR_ERROR(LEPT_CBOR_INVALID, "\x1c");
+    TEST_CBOR_ERROR(LEPT_CBOR_INVALID, "\xff");
+    TEST_CBOR_ERROR(LEPT_CBOR_INVALID, "\x1f");
+    TEST_CBOR_ERROR(LEPT_CBOR_INVALID, "\x7f\x41\x61\xff");
+    TEST_CBOR_ERROR(LEPT_CBOR_INVALID, "\x7f\x7f\xff\xff");
+    TEST_CBOR_ERROR(LEPT_CBOR_INVALID, "\xa1\x01\x02");
+    TEST_CBOR_ERROR(LEPT_CBOR_INVALID, "\xa1\x41\x61\x02");
+    TEST_CBOR_ERROR(LEPT_CBOR_UNSUPPORTED, "\x41\x61");
+    TEST_CBOR_ERROR(LEPT_CBOR_UNSUPPORTED, "\xf0");
+    TEST_CBOR_ERROR(LEPT_CBOR_UNSUPPORTED, "\xf8\x20");
+    TEST_CBOR_ERROR(LEPT_CBOR_UNSUPPORTED, "\xf9\x7c\x00");
+    TEST_CBOR_ERROR(LEPT_CBOR_UNSUPPORTED, "\xf9\x7e\x00");
+    TEST_CBOR_ERROR(LEPT_CBOR_UNSUPPORTED, "\x82\x01\xfb\xff\xf0\x00\x00\x00\x00\x00\x00");
+    TEST_CBOR_ERROR(LEPT_CBOR_ROOT_NOT_SINGULAR, "\x00\x00");
+    TEST_CBOR_ERROR(LEPT_CBOR_ROOT_NOT_SINGULAR, "\x80\xff");
+
+    /* 嵌套过深 */
+    data = (unsigned char*)malloc(2001);
+    memset(data, 0x81, 2000);
+    data[2000] = 0x80;
+    lept_init(&v);
+    EXPECT_EQ_INT(LEPT_CBOR_NESTING_TOO_DEEP, lept_from_cbor(&v, data, 2001));
+    EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+    free(data);
+
+    /* 往返，定长数组/对象按个数分配 */
+    lept_init(&v);
+    lept_init(&v2);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, "{\"n\":null,\"f\":false,\"t\":true,\"i\":-123,\"d\":0.1,\"s\":\"abc\\u0000def\",\"a\":[1,2,3],\"o\":{\"1\":1,\"\":[{}]}}"));
+    lept_set_array(lept_set_object_value(&v, "big", 3), 0);
+    for (i = 0; i < 300; i++)
+        lept_set_number(lept_pushback_array_element(lept_find_object_value(&v, "big", 3)), (double)i * 1000);
+    data = lept_to_cbor(&v, &length);
+    EXPECT_EQ_INT(LEPT_CBOR_OK, lept_from_cbor(&v2, data, length));
+    EXPECT_TRUE(lept_is_equal(&v, &v2));
+    EXPECT_EQ_SIZE_T(9, lept_get_object_capacity(&v2));
+    EXPECT_EQ_SIZE_T(300, lept_get_array_capacity(lept_find_object_value(&v2, "big", 3)));
+    free(data);
+    lept_free(&v);
+    lept_free(&v2);
+}
+
+#define TEST_MSGPACK(expect, json)\
+    do {\
+        lept_value v, v2;\
+        unsigned char* data;\
+        size_t length;\
+        lept_init(&v);\
+        lept_init(&v2);\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));\
+        data = lept_to_msgpack(&v, &length);\
+        EXPECT_TRUE(sizeof(expect) - 1 == length && memcmp(expect, data, length) == 0);\
+        EXPECT_EQ_INT(LEPT_MSGPACK_OK, lept_from_msgpack(&v2, data, length, 0));\
+        EXPECT_TRUE(lept_is_equal(&v, &v2));\
+        lept_free(&v2);\
+        EXPECT_EQ_INT(LEPT_MSGPACK_OK, lept_from_msgpack(&v2, data, length, LEPT_MSGPACK_BORROW));\
+        EXPECT_TRUE(lept_is_equal(&v, &v2));\
+        lept_free(&v2);\
+        free(data);\
+        lept_free(&v);\
+    } while(0)
+
+#define TEST_MSGPACK_DECODE(json, data)\
+    do {\
+        lept_value v, v2;\
+        lept_init(&v);\
+        lept_init(&v2);\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));\
+        EXPECT_EQ_INT(LEPT_MSGPACK_OK, lept_from_msgpack(&v2, (const unsigned char*)data, sizeof(data) - 1, 0));\
+        EXPECT_TRUE(lept_is_equal(&v, &v2));\
+        lept_free(&v);\
+        lept_free(&v2);\
+    } while(0)
+
+#define TEST_MSGPACK_ERROR(error, data)\
+    do {\
+        lept_value v;\
+        lept_init(&v);\
+        v.type = LEPT_FALSE;\
+        EXPECT_EQ_INT(error, lept_from_msgpack(&v, (const unsigned char*)data, sizeof(data) - 1, LEPT_MSGPACK_BORROW));\
+        EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));\
+    } while(0)
+
+static void test_msgpack() {
+    lept_value v, v2;
+    unsigned char data[] = "\x82\xa1\x61\xa3\x78\x79\x7a\xa1\x62\x92\xc4\x01\x00\xa0";
+    const char* s;
+
+    TEST_MSGPACK("\xc0", "null");
+    TEST_MSGPACK("\xc2", "false");
+    TEST_MSGPACK("\xc3", "true");
+    TEST_MSGPACK("\x00", "0");
+    TEST_MSGPACK("\x7f", "127");
+    TEST_MSGPACK("\xcc\x80", "128");
+    TEST_MSGPACK("\xcd\x01\x00", "256");
+    TEST_MSGPACK("\xce\x00\x01\x00\x00", "65536");
+    TEST_MSGPACK("\xcf\x00\x00\x00\x01\x00\x00\x00\x00", "4294967296");
+    TEST_MSGPACK("\xff", "-1");
+    TEST_MSGPACK("\xe0", "-32");
+    TEST_MSGPACK("\xd0\xdf", "-33");
+    TEST_MSGPACK("\xd0\x80", "-128");
+    TEST_MSGPACK("\xd1\xff\x7f", "-129");
+    TEST_MSGPACK("\xd2\xff\xff\x7f\xff", "-32769");
+    TEST_MSGPACK("\xd3\xff\xff\xff\xff\x7f\xff\xff\xff", "-2147483649");
+    TEST_MSGPACK("\xd3\x80\x00\x00\x00\x00\x00\x00\x00", "-9223372036854775808");
+    TEST_MSGPACK("\xca\x80\x00\x00\x00", "-0");
+    TEST_MSGPACK("\xca\x3f\xc0\x00\x00", "1.5");
+    TEST_MSGPACK("\xcb\x3f\xb9\x99\x99\x99\x99\x99\x9a", "0.1");
+    TEST_MSGPACK("\xcb\xc3\xe0\x00\x00\x00\x00\x00\x01", "-9223372036854777856");
+    TEST_MSGPACK("\xa0", "\"\"");
+    TEST_MSGPACK("\xa3\x61\x62\x63", "\"abc\"");
+    TEST_MSGPACK("\x90", "[]");
+    TEST_MSGPACK("\x93\x01\x92\x02\x03\xc0", "[1,[2,3],null]");
+    TEST_MSGPACK("\x80", "{}");
+    TEST_MSGPACK("\x82\xa1\x61\x01\xa1\x62\x91\xc3", "{\"a\":1,\"b\":[true]}");
+
+    TEST_MSGPACK_DECODE("1", "\xcc\x01");
+    TEST_MSGPACK_DECODE("-1", "\xd3\xff\xff\xff\xff\xff\xff\xff\xff");
+    TEST_MSGPACK_DECODE("1", "\xd0\x01");
+    TEST_MSGPACK_DECODE("\"a\"", "\xd9\x01\x61");
+    TEST_MSGPACK_DECODE("\"a\"", "\xdb\x00\x00\x00\x01\x61");
+    TEST_MSGPACK_DECODE("\"a\\u0000\"", "\xc5\x00\x02\x61\x00");
+    TEST_MSGPACK_DECODE("[1]", "\xdd\x00\x00\x00\x01\x01");
+    TEST_MSGPACK_DECODE("{\"\":[]}", "\xde\x00\x01\xa0\xdc\x00\x00");
+
+    TEST_MSGPACK_ERROR(LEPT_MSGPACK_TRUNCATED, "");
+    TEST_MSGPACK_ERROR(LEPT_MSGPACK_TRUNCATED, "\xcd\x01");
+    TEST_MSGPACK_ERROR(LEPT_MSGPACK_TRUNCATED, "\xa2\x61");
+    TEST_MSGPACK_ERROR(LEPT_MSGPACK_TRUNCATED, "\x92\x01");
+    TEST_MSGPACK_ERROR(LEPT_MSGPACK_TRUNCATED, "\xdd\xff\xff\xff\xff\x01");
+    TEST_MSGPACK_ERROR(LEPT_MSGPACK_TRUNCATED, "\x81\xa1\x61");
+    TEST_MSGPACK_ERROR(LEPT_MSGPACK_INVALID, "\xc1");
+    TEST_MSGPACK_ERROR(LEPT_MSGPACK_INVALID, "\x81\x01\x02");
+    TEST_MSGPACK_ERROR(LEPT_MSGPACK_INVALID, "\x81\xc4\x01\x61\x02");
+    TEST_MSGPACK_ERROR(LEPT_MSGPACK_UNSUPPORTED, "\xd4\x01\x00");
+    TEST_MSGPACK_ERROR(LEPT_MSGPACK_UNSUPPORTED, "\xca\x7f\x80\x00\x00");
+    TEST_MSGPACK_ERROR(LEPT_MSGPACK_UNSUPPORTED, "\x91\xcb\x7f\xf8\x00\x00\x00\x00\x00\x00");
+    TEST_MSGPACK_ERROR(LEPT_MSGPACK_ROOT_NOT_SINGULAR, "\xc0\xc0");
+
+    /* 借用模式：值指向输入，键被复制；拷贝后拥有自己的字符串 */
+    lept_init(&v);
+    lept_init(&v2);
+    EXPECT_EQ_INT(LEPT_MSGPACK_OK, lept_from_msgpack(&v, data, sizeof(data) - 1, LEPT_MSGPACK_BORROW));
+    s = lept_get_string(lept_find_object_value(&v, "a", 1));
+    EXPECT_TRUE(s == (const char*)data + 4);
+    EXPECT_EQ_SIZE_T(3, lept_get_string_length(lept_find_object_value(&v, "a", 1)));
+    EXPECT_TRUE(lept_get_object_key(&v, 0) != (const char*)data + 2);
+    EXPECT_TRUE(lept_get_string(lept_get_array_element(lept_find_object_value(&v, "b", 1), 0)) == (const char*)data + 12);
+    lept_copy(&v2, &v);
+    EXPECT_TRUE(lept_is_equal(&v, &v2));
+    EXPECT_EQ_STRING("xyz", lept_get_string(lept_find_object_value(&v2, "a", 1)), 3);
+    lept_set_string(lept_find_object_value(&v, "a", 1), "w", 1);
+    EXPECT_EQ_INT('x', data[4]);
+    lept_free(&v);
+    lept_free(&v2);
+}
+
+// 逐个结点比较快照与原值
+static int snap_equal(const lept_snap_node* n, const lept_value* v) {
+    size_t i;
+    if (lept_snap_get_type(n) != v->type)
+        return 0;
+    switch (v->type) {
+        case LEPT_NUMBER: return lept_snap_get_number(n) == v->u.n;
+        case LEPT_STRING:
+            return lept_snap_get_string_length(n) == v->u.s.len && memcmp(lept_snap_get_string(n), v->u.s.s, v->u.s.len + 1) == 0;
+        case LEPT_ARRAY:
+            if (lept_snap_get_array_size(n) != v->u.a.size)
+                return 0;
+            for (i = 0; i < v->u.a.size; i++)
+                if (!snap_equal(lept_snap_get_array_element(n, i), &v->u.a.e[i]))
+                    return 0;
+            return 1;
+        case LEPT_OBJECT:
+            if (lept_snap_get_object_size(n) != v->u.o.size)
+                return 0;
+            for (i = 0; i < v->u.o.size; i++)
+                if (lept_snap_get_object_key_length(n, i) != v->u.o.m[i].klen
+                    || memcmp(lept_snap_get_object_key(n, i), v->u.o.m[i].k, v->u.o.m[i].klen + 1) != 0
+                    || !snap_equal(lept_snap_get_object_value(n, i), &v->u.o.m[i].v))
+                    return 0;
+            return 1;
+        default: return 1;
+    }
+}
+
+#define TEST_SNAPSHOT(json)\
+    do {\
+        lept_value v;\
+        lept_snapshot snap;\
+        lept_init(&v);\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));\
+        EXPECT_EQ_INT(LEPT_SNAPSHOT_OK, lept_snapshot_write(&v, SNAPSHOT_FILE));\
+        EXPECT_EQ_INT(LEPT_SNAPSHOT_OK, lept_snapshot_open(&snap, SNAPSHOT_FILE));\
+        EXPECT_TRUE(snap_equal(lept_snapshot_root(&snap), &v));\
+        lept_snapshot_close(&snap);\
+        lept_free(&v);\
+    } while(0)
+
+#define SNAPSHOT_FILE "leptjson_snapshot.tmp"
+
+static void test_snapshot() {
+    lept_value v;
+    lept_snapshot snap;
+    const lept_snap_node* n;
+    FILE* fp;
+    size_t i;
+
+    TEST_SNAPSHOT("null");
+    TEST_SNAPSHOT("true");
+    TEST_SNAPSHOT("-1.5e300");
+    TEST_SNAPSHOT("\"\"");
+    TEST_SNAPSHOT("\"Hello\\u0000World\"");
+    TEST_SNAPSHOT("[]");
+    TEST_SNAPSHOT("{}");
+    TEST_SNAPSHOT("[[[]],[{}],\"a\",[1,[2,[3]]]]");
+    TEST_SNAPSHOT("{\"n\":null,\"f\":false,\"t\":true,\"i\":123,\"s\":\"abc\",\"a\":[1,2,3],\"o\":{\"1\":1,\"2\":2,\"\":{\"x\":[{}]}}}");
+
+    /* 按键查找 */
+    lept_init(&v);
+    lept_set_object(&v, 0);
+    for (i = 0; i < 100; i++) {
+        char key[16];
+        lept_set_number(lept_set_object_value(&v, key, (size_t)sprintf(key, "k%d", (int)i)), (double)i);
+    }
+    EXPECT_EQ_INT(LEPT_SNAPSHOT_OK, lept_snapshot_write(&v, SNAPSHOT_FILE));
+    lept_free(&v);
+    EXPECT_EQ_INT(LEPT_SNAPSHOT_OK, lept_snapshot_open(&snap, SNAPSHOT_FILE));
+    n = lept_snapshot_root(&snap);
+    EXPECT_EQ_SIZE_T(100, lept_snap_get_object_size(n));
+    EXPECT_EQ_STRING("k42", lept_snap_get_object_key(n, 42), lept_snap_get_object_key_length(n, 42));
+    EXPECT_EQ_DOUBLE(42.0, lept_snap_get_number(lept_snap_find_object_value(n, "k42", 3)));
+    EXPECT_EQ_DOUBLE(99.0, lept_snap_get_number(lept_snap_find_object_value(n, "k99", 3)));
+    EXPECT_TRUE(lept_snap_find_object_value(n, "k100", 4) == NULL);
+    lept_snapshot_close(&snap);
+    EXPECT_TRUE(snap.data == NULL);
+
+    /* 不是快照文件 */
+    fp = fopen(SNAPSHOT_FILE, "wb");
+    fputs("{\"not\":\"a snapshot\"}", fp);
+    fclose(fp);
+    EXPECT_EQ_INT(LEPT_SNAPSHOT_INVALID, lept_snapshot_open(&snap, SNAPSHOT_FILE));
+    EXPECT_TRUE(snap.data == NULL);
+    fp = fopen(SNAPSHOT_FILE, "wb");
+    fclose(fp);
+    EXPECT_EQ_INT(LEPT_SNAPSHOT_INVALID, lept_snapshot_open(&snap, SNAPSHOT_FILE));
+    remove(SNAPSHOT_FILE);
+    EXPECT_EQ_INT(LEPT_SNAPSHOT_IO_ERROR, lept_snapshot_open(&snap, SNAPSHOT_FILE));
+}
+
+/* 同一个值分别在树上校验和边解析边校验，结果应一致 */
+#define TEST_SCHEMA(expect, text, json)\
+    do {\
+        lept_value sv, v;\
+        lept_schema* s;\
+        lept_parse_options opt;\
+        lept_init(&sv);\
+        lept_init(&v);\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&sv, text));\
+        s = lept_schema_compile(&sv);\
+        EXPECT_TRUE(s != NULL);\
+        if (s != NULL) {\
+            EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));\
+            EXPECT_EQ_INT(expect, lept_schema_validate(s, &v));\
+            lept_free(&v);\
+            memset(&opt, 0, sizeof(opt));\
+            opt.schema = s;\
+            EXPECT_EQ_INT(expect ? LEPT_PARSE_OK : LEPT_PARSE_SCHEMA_MISMATCH, lept_parse_opt(&v, json, &opt));\
+            if (!expect)\
+                EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));\
+            lept_free(&v);\
+            lept_schema_free(s);\
+        }\
+        lept_free(&sv);\
+    } while(0)
+
+#define TEST_SCHEMA_INVALID(text)\
+    do {\
+        lept_value sv;\
+        lept_init(&sv);\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&sv, text));\
+        EXPECT_TRUE(lept_schema_compile(&sv) == NULL);\
+        lept_free(&sv);\
+    } while(0)
+
+static void test_schema() {
+    lept_value sv, v;
+    lept_schema* s;
+    lept_parse_options opt;
+    lept_parse_result r;
+    const lept_pointer* paths[1];
+    const char* person =
+        "{\"type\":\"object\",\"required\":[\"name\",\"age\"],"
+        "\"properties\":{\"name\":{\"type\":\"string\",\"minLength\":1,\"maxLength\":3},"
+        "\"age\":{\"type\":\"integer\",\"minimum\":0,\"exclusiveMaximum\":150},"
+        "\"tags\":{\"type\":\"array\",\"items\":{\"enum\":[\"a\",\"b\",[1]]},\"maxItems\":2}},"
+        "\"additionalProperties\":false}";
+
+    TEST_SCHEMA(1, "true", "[1,{\"a\":null}]");
+    TEST_SCHEMA(0, "false", "null");
+    TEST_SCHEMA(1, "{}", "\"x\"");
+    TEST_SCHEMA(1, "{\"title\":\"t\",\"description\":\"d\",\"default\":1}", "2");
+
+    TEST_SCHEMA(1, "{\"type\":\"null\"}", "null");
+    TEST_SCHEMA(0, "{\"type\":\"null\"}", "false");
+    TEST_SCHEMA(1, "{\"type\":\"boolean\"}", "true");
+    TEST_SCHEMA(1, "{\"type\":\"boolean\"}", "false");
+    TEST_SCHEMA(0, "{\"type\":\"boolean\"}", "0");
+    TEST_SCHEMA(1, "{\"type\":\"number\"}", "1.5");
+    TEST_SCHEMA(1, "{\"type\":\"integer\"}", "3");
+    TEST_SCHEMA(1, "{\"type\":\"integer\"}", "1.0e2");
+    TEST_SCHEMA(0, "{\"type\":\"integer\"}", "1.5");
+    TEST_SCHEMA(0, "{\"type\":\"integer\"}", "\"1\"");
+    TEST_SCHEMA(1, "{\"type\":[\"string\",\"null\"]}", "null");
+    TEST_SCHEMA(0, "{\"type\":[\"string\",\"null\"]}", "[]");
+    TEST_SCHEMA(0, "{\"type\":\"object\"}", "[1,2]");
+    TEST_SCHEMA(0, "{\"type\":\"array\"}", "{}");
+
+    TEST_SCHEMA(1, "{\"enum\":[1,\"a\",{\"x\":[true]}]}", "{\"x\":[true]}");
+    TEST_SCHEMA(0, "{\"enum\":[1,\"a\",{\"x\":[true]}]}", "{\"x\":[false]}");
+    TEST_SCHEMA(0, "{\"enum\":[]}", "1");
+
+    TEST_SCHEMA(1, "{\"minimum\":1,\"maximum\":2}", "1");
+    TEST_SCHEMA(1, "{\"minimum\":1,\"maximum\":2}", "2");
+    TEST_SCHEMA(0, "{\"minimum\":1,\"maximum\":2}", "0.5");
+    TEST_SCHEMA(0, "{\"minimum\":1,\"maximum\":2}", "2.5");
+    TEST_SCHEMA(0, "{\"exclusiveMinimum\":1}", "1");
+    TEST_SCHEMA(0, "{\"exclusiveMaximum\":2}", "2");
+    TEST_SCHEMA(0, "{\"minimum\":1,\"exclusiveMinimum\":1}", "1");
+    TEST_SCHEMA(0, "{\"exclusiveMinimum\":1,\"minimum\":1}", "1");
+    TEST_SCHEMA(0, "{\"exclusiveMinimum\":1,\"minimum\":3}", "2");
+    TEST_SCHEMA(1, "{\"minimum\":1}", "\"not a number\"");
+
+    TEST_SCHEMA(1, "{\"minLength\":2,\"maxLength\":2}", "\"\\u00e9\\u4e2d\"");
+    TEST_SCHEMA(1, "{\"maxLength\":1}", "\"\\ud834\\udd1e\"");
+    TEST_SCHEMA(0, "{\"minLength\":2}", "\"a\"");
+    TEST_SCHEMA(0, "{\"maxLength\":2}", "\"abc\"");
+
+    TEST_SCHEMA(1, "{\"minItems\":1,\"maxItems\":2}", "[1,2]");
+    TEST_SCHEMA(0, "{\"minItems\":1}", "[]");
+    TEST_SCHEMA(0, "{\"maxItems\":2}", "[1,2,3]");
+    TEST_SCHEMA(1, "{\"items\":{\"type\":\"number\"}}", "[1,2,3]");
+    TEST_SCHEMA(0, "{\"items\":{\"type\":\"number\"}}", "[1,\"2\",3]");
+    TEST_SCHEMA(1, "{\"items\":false}", "[]");
+    TEST_SCHEMA(0, "{\"items\":false}", "[0]");
+    TEST_SCHEMA(1, "{\"items\":{\"items\":{\"items\":{\"type\":\"null\"}}}}", "[[[null]],[[],[null,null]]]");
+    TEST_SCHEMA(0, "{\"items\":{\"items\":{\"items\":{\"type\":\"null\"}}}}", "[[[null]],[[],[null,0]]]");
+
+    TEST_SCHEMA(1, person, "{\"name\":\"Ann\",\"age\":30}");
+    TEST_SCHEMA(1, person, "{\"age\":0,\"name\":\"Bo\",\"tags\":[\"a\",[1]]}");
+    TEST_SCHEMA(0, person, "{\"name\":\"Ann\"}");
+    TEST_SCHEMA(0, person, "{\"name\":\"\",\"age\":1}");
+    TEST_SCHEMA(0, person, "{\"name\":\"Ann\",\"age\":150}");
+    TEST_SCHEMA(0, person, "{\"name\":\"Ann\",\"age\":30.5}");
+    TEST_SCHEMA(0, person, "{\"name\":\"Ann\",\"age\":30,\"tags\":[\"c\"]}");
+    TEST_SCHEMA(0, person, "{\"name\":\"Ann\",\"age\":30,\"tags\":[\"a\",\"a\",\"a\"]}");
+    TEST_SCHEMA(0, person, "{\"name\":\"Ann\",\"age\":30,\"extra\":{}}");
+    TEST_SCHEMA(1, "{\"additionalProperties\":{\"type\":\"number\"},\"properties\":{\"s\":{\"type\":\"string\"}}}", "{\"s\":\"x\",\"n\":1}");
+    TEST_SCHEMA(0, "{\"additionalProperties\":{\"type\":\"number\"},\"properties\":{\"s\":{\"type\":\"string\"}}}", "{\"s\":\"x\",\"n\":\"1\"}");
+    TEST_SCHEMA(1, "{\"required\":[\"a\"]}", "[]");
+
+    TEST_SCHEMA_INVALID("1");
+    TEST_SCHEMA_INVALID("{\"type\":\"float\"}");
+    TEST_SCHEMA_INVALID("{\"type\":[]}");
+    TEST_SCHEMA_INVALID("{\"minimum\":\"1\"}");
+    TEST_SCHEMA_INVALID("{\"minLength\":-1}");
+    TEST_SCHEMA_INVALID("{\"maxItems\":1.5}");
+    TEST_SCHEMA_INVALID("{\"required\":[1]}");
+    TEST_SCHEMA_INVALID("{\"items\":[{}]}");
+    TEST_SCHEMA_INVALID("{\"properties\":{\"a\":{\"pattern\":\"^a\"}}}");
+    TEST_SCHEMA_INVALID("{\"items\":{\"items\":{\"$ref\":\"#\"}}}");
+
+    /* 边解析边校验：在第一个不满足的值处停下，之后的文本即使不合法也不再解析 */
+    lept_init(&sv);
+    lept_init(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&sv, person));
+    s = lept_schema_compile(&sv);
+    memset(&opt, 0, sizeof(opt));
+    opt.schema = s;
+    r = lept_parse_ex(&v, "{\"name\":\"Ann\",\"age\":-1,\"tags\":[", &opt);
+    EXPECT_EQ_INT(LEPT_PARSE_SCHEMA_MISMATCH, r.code);
+    EXPECT_EQ_SIZE_T(20, r.offset);
+    r = lept_parse_ex(&v, "{\"name\":\"Ann\",\"tags\":{\"x\":", &opt);
+    EXPECT_EQ_INT(LEPT_PARSE_SCHEMA_MISMATCH, r.code);
+    EXPECT_EQ_SIZE_T(21, r.offset);
+    r = lept_parse_ex(&v, "{\"name\":\"Ann\",\"age\":1,\"tags\":[]}", &opt);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, r.code);
+    lept_free(&v);
+    /* required 在对象结束时检查，出错位置为对象的开头 */
+    r = lept_parse_ex(&v, "  {\"name\":\"Ann\"}", &opt);
+    EXPECT_EQ_INT(LEPT_PARSE_SCHEMA_MISMATCH, r.code);
+    EXPECT_EQ_SIZE_T(2, r.offset);
+    /* 语法错误优先于之后才会检查到的模式错误 */
+    EXPECT_EQ_INT(LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, lept_parse_opt(&v, "{\"name\":\"Ann\"", &opt));
+    lept_schema_free(s);
+    lept_free(&sv);
+
+    /* 投影丢弃的值无法校验：无论文档是否满足模式，都拒绝同时使用 */
+    paths[0] = lept_pointer_compile("/a", 2);
+    opt.paths = paths;
+    opt.npaths = 1;
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&sv, "{\"type\":\"object\",\"required\":[\"a\",\"b\"]}"));
+    opt.schema = s = lept_schema_compile(&sv);
+    EXPECT_EQ_INT(LEPT_PARSE_INVALID_OPTIONS, lept_parse_opt(&v, "{\"a\":1,\"b\":2}", &opt));
+    EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+    lept_schema_free(s);
+    lept_free(&sv);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&sv, "{\"properties\":{\"b\":{\"type\":\"string\"}}}"));
+    opt.schema = s = lept_schema_compile(&sv);
+    EXPECT_EQ_INT(LEPT_PARSE_INVALID_OPTIONS, lept_parse_opt(&v, "{\"a\":1,\"b\":2}", &opt));
+    opt.npaths = 0;
+    EXPECT_EQ_INT(LEPT_PARSE_SCHEMA_MISMATCH, lept_parse_opt(&v, "{\"a\":1,\"b\":2}", &opt));
+    lept_schema_free(s);
+    lept_free(&sv);
+    lept_pointer_free((lept_pointer*)paths[0]);
+}
+
+typedef struct {
+    double x, y;
+} bind_point;
+
+typedef struct {
+    int64_t id;
+    char* name;
+    int active;
+    bind_point origin;
+    bind_point* path;
+    size_t npath;
+    char** tags;
+    size_t ntags;
+} bind_shape;
+
+static const lept_field bind_point_fields[] = {
+    LEPT_FIELD(bind_point, x, LEPT_BIND_DOUBLE),
+    LEPT_FIELD(bind_point, y, LEPT_BIND_DOUBLE)
+};
+static const lept_struct_desc bind_point_desc = { sizeof(bind_point), bind_point_fields, 2 };
+
+static const lept_field bind_shape_fields[] = {
+    LEPT_FIELD(bind_shape, id, LEPT_BIND_INT),
+    LEPT_FIELD(bind_shape, name, LEPT_BIND_STRING),
+    LEPT_FIELD(bind_shape, active, LEPT_BIND_BOOL),
+    LEPT_FIELD_STRUCT(bind_shape, origin, &bind_point_desc),
+    LEPT_FIELD_ARRAY(bind_shape, path, npath, LEPT_BIND_STRUCT, &bind_point_desc),
+    LEPT_FIELD_ARRAY(bind_shape, tags, ntags, LEPT_BIND_STRING, NULL)
+};
+static const lept_struct_desc bind_shape_desc = { sizeof(bind_shape), bind_shape_fields, 6 };
+
+/* 自引用的描述表 */
+typedef struct bind_node {
+    struct bind_node* children;
+    size_t nchildren;
+} bind_node;
+
+static const lept_struct_desc bind_node_desc;
+static const lept_field bind_node_fields[] = {
+    LEPT_FIELD_ARRAY(bind_node, children, nchildren, LEPT_BIND_STRUCT, &bind_node_desc)
+};
+static const lept_struct_desc bind_node_desc = { sizeof(bind_node), bind_node_fields, 1 };
+
+#define TEST_BIND_ERROR(error, json)\
+    do {\
+        bind_shape sh;\
+        EXPECT_EQ_INT(error, lept_parse_bind(&sh, &bind_shape_desc, json));\
+        EXPECT_TRUE(sh.name == NULL && sh.path == NULL && sh.npath == 0 && sh.tags == NULL);\
+    } while(0)
+
+#define TEST_BIND_ROUNDTRIP(json)\
+    do {\
+        bind_shape sh;\
+        char* out;\
+        size_t length;\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_bind(&sh, &bind_shape_desc, json));\
+        out = lept_stringify_bind(&sh, &bind_shape_desc, &length);\
+        EXPECT_EQ_STRING(json, out, length);\
+        free(out);\
+        lept_bind_free(&sh, &bind_shape_desc);\
+    } while(0)
+
+static void test_bind() {
+    bind_shape sh;
+    bind_node node;
+    char* json;
+    size_t i;
+
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_bind(&sh, &bind_shape_desc,
+        " { \"name\" : \"tri\\u0061\", \"id\":-42, \"unknown\":[{\"id\":1},\"}\"], \"active\":true,"
+        "\"origin\":{\"y\":2.5,\"x\":-1},\"path\":[{\"x\":1},{\"y\":2},{}],\"tags\":[\"a\",null,\"\"] } "));
+    EXPECT_TRUE(sh.id == -42);
+    EXPECT_EQ_STRING("tria", sh.name, strlen(sh.name));
+    EXPECT_EQ_INT(1, sh.active);
+    EXPECT_EQ_DOUBLE(-1.0, sh.origin.x);
+    EXPECT_EQ_DOUBLE(2.5, sh.origin.y);
+    EXPECT_EQ_SIZE_T(3, sh.npath);
+    EXPECT_EQ_DOUBLE(1.0, sh.path[0].x);
+    EXPECT_EQ_DOUBLE(0.0, sh.path[0].y);
+    EXPECT_EQ_DOUBLE(2.0, sh.path[1].y);
+    EXPECT_EQ_DOUBLE(0.0, sh.path[2].x);
+    EXPECT_EQ_SIZE_T(3, sh.ntags);
+    EXPECT_EQ_STRING("a", sh.tags[0], strlen(sh.tags[0]));
+    EXPECT_TRUE(sh.tags[1] == NULL);
+    EXPECT_EQ_STRING("", sh.tags[2], strlen(sh.tags[2]));
+    lept_bind_free(&sh, &bind_shape_desc);
+    EXPECT_TRUE(sh.name == NULL && sh.path == NULL && sh.npath == 0 && sh.tags == NULL && sh.ntags == 0);
+
+    /* 缺少的成员为0，重复的键以最后一个为准 */
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_bind(&sh, &bind_shape_desc,
+        "{\"name\":\"a\",\"tags\":[\"x\"],\"name\":\"b\",\"tags\":null,\"path\":[]}"));
+    EXPECT_TRUE(sh.id == 0 && sh.active == 0 && sh.npath == 0 && sh.path == NULL && sh.ntags == 0);
+    EXPECT_EQ_STRING("b", sh.name, 1);
+    lept_bind_free(&sh, &bind_shape_desc);
+    /* 重复的嵌套结构体整个以后一个为准，前一个的成员不残留 */
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_bind(&sh, &bind_shape_desc,
+        "{\"origin\":{\"x\":1,\"y\":2},\"origin\":{\"x\":3}}"));
+    EXPECT_EQ_DOUBLE(3.0, sh.origin.x);
+    EXPECT_EQ_DOUBLE(0.0, sh.origin.y);
+    lept_bind_free(&sh, &bind_shape_desc);
+
+    TEST_BIND_ROUNDTRIP("{\"id\":0,\"name\":null,\"active\":false,\"origin\":{\"x\":0,\"y\":0},\"path\":[],\"tags\":[]}");
+    TEST_BIND_ROUNDTRIP("{\"id\":9007199254740992,\"name\":\"\\\"\\n\\u0001\",\"active\":true,"
+        "\"origin\":{\"x\":1.5,\"y\":-2},\"path\":[{\"x\":1,\"y\":2},{\"x\":3,\"y\":4}],\"tags\":[\"a\",null]}");
+
+    TEST_BIND_ERROR(LEPT_PARSE_EXPECT_VALUE, "");
+    TEST_BIND_ERROR(LEPT_PARSE_BIND_MISMATCH, "[]");
+    TEST_BIND_ERROR(LEPT_PARSE_BIND_MISMATCH, "{\"name\":1}");
+    TEST_BIND_ERROR(LEPT_PARSE_BIND_MISMATCH, "{\"name\":\"a\",\"id\":1.5}");
+    TEST_BIND_ERROR(LEPT_PARSE_BIND_MISMATCH, "{\"name\":\"a\",\"id\":1e300}");
+    TEST_BIND_ERROR(LEPT_PARSE_BIND_MISMATCH, "{\"active\":1}");
+    TEST_BIND_ERROR(LEPT_PARSE_BIND_MISMATCH, "{\"origin\":[1,2]}");
+    TEST_BIND_ERROR(LEPT_PARSE_BIND_MISMATCH, "{\"origin\":{\"x\":\"1\"}}");
+    TEST_BIND_ERROR(LEPT_PARSE_BIND_MISMATCH, "{\"path\":{}}");
+    TEST_BIND_ERROR(LEPT_PARSE_BIND_MISMATCH, "{\"tags\":[\"a\",[]]}");
+    TEST_BIND_ERROR(LEPT_PARSE_BIND_MISMATCH, "{\"tags\":[\"a\",\"b\",\"c\",\"d\",\"e\",false]}");
+    TEST_BIND_ERROR(LEPT_PARSE_MISS_KEY, "{\"name\":\"a\",}");
+    TEST_BIND_ERROR(LEPT_PARSE_MISS_COLON, "{\"name\" \"a\"}");
+    TEST_BIND_ERROR(LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET, "{\"name\":\"a\"");
+    TEST_BIND_ERROR(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, "{\"name\":\"a\",\"path\":[{}");
+    TEST_BIND_ERROR(LEPT_PARSE_MISS_QUOTATION_MARK, "{\"name\":\"a");
+    TEST_BIND_ERROR(LEPT_PARSE_INVALID_VALUE, "{\"id\":tru}");
+    TEST_BIND_ERROR(LEPT_PARSE_ROOT_NOT_SINGULAR, "{\"name\":\"a\"} x");
+
+    /* 自引用描述表的嵌套深度受 LEPT_PARSE_MAX_DEPTH 限制 */
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_bind(&node, &bind_node_desc, "{\"children\":[{},{\"children\":[{}]}]}"));
+    EXPECT_EQ_SIZE_T(2, node.nchildren);
+    EXPECT_EQ_SIZE_T(1, node.children[1].nchildren);
+    lept_bind_free(&node, &bind_node_desc);
+    json = (char*)malloc(2000 * 13 + 1);
+    for (i = 0; i < 2000; i++)
+        memcpy(json + i * 13, "{\"children\":[", 13);
+    json[2000 * 13] = '\0';
+    EXPECT_EQ_INT(LEPT_PARSE_NESTING_TOO_DEEP, lept_parse_bind(&node, &bind_node_desc, json));
+    EXPECT_TRUE(node.children == NULL);
+    free(json);
+}
+
+static void test_doc() {
+    lept_value v, v2;
+    lept_doc* d, *d2;
+    const lept_value* root;
+    size_t i, n;
+    char key[16];
+
+    lept_init(&v);
+    lept_init(&v2);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, "{\"a\":[1,{\"b\":\"c\"}],\"d\":{}}"));
+    lept_copy(&v2, &v);
+    d = lept_doc_freeze(&v);
+    EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+    root = lept_doc_root(d);
+    EXPECT_TRUE(lept_is_equal(root, &v2));
+    EXPECT_TRUE(lept_hash(root) == lept_hash(&v2));
+
+    /* 每个引用各自释放，最后一个释放时文档才被释放 */
+    d2 = lept_doc_retain(d);
+    EXPECT_TRUE(d2 == d);
+    lept_doc_release(d);
+    EXPECT_TRUE(lept_is_equal(lept_doc_root(d2), &v2));
+    lept_doc_release(d2);
+    lept_doc_release(NULL);
+    lept_free(&v2);
+
+    /* 冻结时已建好键索引 */
+    lept_set_object(&v, 0);
+    for (i = 0; i < 50; i++) {
+        n = (size_t)sprintf(key, "k%d", (int)i);
+        lept_set_object(lept_set_object_value(&v, key, n), 0);
+        lept_set_number(lept_set_object_value(lept_find_object_value(&v, key, n), "x", 1), (double)i);
+    }
+    d = lept_doc_freeze(&v);
+    root = lept_doc_root(d);
+    EXPECT_EQ_SIZE_T(42, lept_find_object_index(root, "k42", 3));
+    EXPECT_EQ_DOUBLE(42.0, lept_get_number(lept_get_object_value_const(lept_get_object_value_const(root, 42), 0)));
+    EXPECT_EQ_SIZE_T(LEPT_KEY_NOT_EXIST, lept_find_object_index(root, "k50", 3));
+    lept_doc_release(d);
+
+    /* const 的访问函数不分离共享的存储，也不改变冻结时缓存的哈希 */
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, "[[1,2],{\"a\":true}]"));
+    d = lept_doc_freeze(&v);
+    root = lept_doc_root(d);
+    n = (size_t)lept_hash(root);
+    EXPECT_EQ_DOUBLE(2.0, lept_get_number(lept_get_array_element_const(lept_get_array_element_const(root, 0), 1)));
+    EXPECT_EQ_INT(LEPT_TRUE, lept_get_type(lept_get_object_value_const(lept_get_array_element_const(root, 1), 0)));
+    EXPECT_TRUE(n == (size_t)lept_hash(root));
+    lept_doc_release(d);
+}
+
+#ifndef _WIN32
+#define DOC_THREADS 4
+
+typedef struct {
+    lept_doc* d;
+    const char* json;
+    uint64_t hash;
+    int fail;
+} doc_reader;
+
+/* 各线程只经 const 的接口读取同一个冻结的文档；结果在主线程中检查，用 -fsanitize=thread 可检查有无共享写入 */
+static void* doc_read(void* arg) {
+    doc_reader* r = (doc_reader*)arg;
+    const lept_value* root = lept_doc_root(r->d);
+    char key[16];
+    char* s;
+    size_t i, n, index;
+    for (i = 0; i < 200; i++) {
+        n = (size_t)sprintf(key, "k%d", (int)(i % 60));
+        index = lept_find_object_index(root, key, n);
+        if ((i % 60 < 50) != (index != LEPT_KEY_NOT_EXIST))
+            r->fail++;
+        else if (index != LEPT_KEY_NOT_EXIST
+            && lept_get_number(lept_get_array_element_const(lept_get_object_value_const(root, index), 1)) != (double)(i % 60))
+            r->fail++;
+        if (lept_hash(root) != r->hash || !lept_is_equal(root, root))
+            r->fail++;
+        s = lept_stringify(root, &n);
+        if (strcmp(s, r->json) != 0)
+            r->fail++;
+        free(s);
+    }
+    lept_doc_release(r->d);
+    return NULL;
+}
+
+static void test_doc_threads() {
+    lept_value v;
+    lept_doc* d;
+    doc_reader r[DOC_THREADS];
+    pthread_t t[DOC_THREADS];
+    char key[16];
+    char* json;
+    size_t i, n;
+
+    lept_init(&v);
+    lept_set_object(&v, 0);
+    for (i = 0; i < 50; i++) {
+        lept_value* e;
+        n = (size_t)sprintf(key, "k%d", (int)i);
+        e = lept_set_object_value(&v, key, n);
+        lept_set_array(e, 2);
+        lept_set_string(lept_pushback_array_element(e), key, n);
+        lept_set_number(lept_pushback_array_element(e), (double)i);
+    }
+    json = lept_stringify(&v, NULL);
+    d = lept_doc_freeze(&v);
+    for (i = 0; i < DOC_THREADS; i++) {
+        r[i].d = lept_doc_retain(d);
+        r[i].json = json;
+        r[i].hash = lept_hash(lept_doc_root(d));
+        r[i].fail = 0;
+    }
+    for (i = 0; i < DOC_THREADS; i++)
+        EXPECT_EQ_INT(0, pthread_create(&t[i], NULL, doc_read, &r[i]));
+    lept_doc_release(d);
+    for (i = 0; i < DOC_THREADS; i++) {
+        pthread_join(t[i], NULL);
+        EXPECT_EQ_INT(0, r[i].fail);
+    }
+    free(json);
+}
+#endif
+
+static void test_key_pool() {
+    lept_value v1, v2;
+    lept_key_pool* p = lept_key_pool_new();
+    const char* id, *json = "[{\"id\":1,\"name\":\"a\"},{\"name\":\"b\",\"id\":2}]";
+    char* s;
+    char key[80];
+
+    lept_init(&v1);
+    lept_init(&v2);
+    EXPECT_TRUE(lept_set_thread_key_pool(p) == NULL);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v1, json));
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v2, json));
+    lept_remove_object_value(lept_get_array_element(&v2, 0), 0);
+    lept_set_number(lept_set_object_value(lept_get_array_element(&v2, 0), "id", 2), 3.0);
+
+    /* 同一个键在各个文档中只有一份 */
+    id = lept_key_pool_get(p, "id", 2);
+    EXPECT_TRUE(id == lept_get_object_key(lept_get_array_element(&v1, 0), 0));
+    EXPECT_TRUE(id == lept_get_object_key(lept_get_array_element(&v1, 1), 1));
+    EXPECT_TRUE(id == lept_get_object_key(lept_get_array_element(&v2, 0), 1));
+    EXPECT_TRUE(lept_is_equal(lept_get_array_element(&v1, 1), lept_get_array_element(&v2, 1)));
+    EXPECT_EQ_SIZE_T(1, lept_find_object_index(lept_get_array_element(&v1, 1), id, 2));
+
+    /* 太长的键不收录 */
+    memset(key, 'k', sizeof(key));
+    EXPECT_TRUE(lept_key_pool_get(p, key, sizeof(key)) == NULL);
+
+    /* 释放键池后文档仍然完整，新的键照常分配 */
+    lept_key_pool_free(p);
+    EXPECT_TRUE(lept_set_thread_key_pool(NULL) == NULL);
+    EXPECT_EQ_STRING("id", lept_get_object_key(lept_get_array_element(&v1, 1), 1), 2);
+    lept_set_null(lept_set_object_value(lept_get_array_element(&v1, 0), "id2", 3));
+    s = lept_stringify(&v1, NULL);
+    EXPECT_EQ_STRING("[{\"id\":1,\"name\":\"a\",\"id2\":null},{\"name\":\"b\",\"id\":2}]", s, strlen(s));
+    free(s);
+    lept_free(&v1);
+    lept_free(&v2);
+}
+
+static void test_shape() {
+    lept_value v;
+    const lept_value* r0, *r1, *r2;
+    const char* json = "[{\"id\":1,\"n\\\"m\":\"a\",\"pos\":{\"x\":1,\"y\":2}},"
+        "{\"id\":2,\"n\\\"m\":\"b\",\"pos\":{\"x\":3,\"y\":4}},{\"n\\\"m\":\"c\",\"id\":3}]";
+    char* s, *p;
+    size_t i, hint = 0, n = 1000;
+    double sum = 0.0;
+
+    /* 数组中键相同的相邻对象（及对应位置上的子对象）共享键 */
+    lept_init(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));
+    r0 = lept_get_array_element(&v, 0);
+    r1 = lept_get_array_element(&v, 1);
+    r2 = lept_get_array_element(&v, 2);
+    EXPECT_TRUE(lept_get_object_key(r0, 0) == lept_get_object_key(r1, 0));
+    EXPECT_TRUE(lept_get_object_key(r0, 1) == lept_get_object_key(r1, 1));
+    EXPECT_TRUE(lept_get_object_key(&r0->u.o.m[2].v, 1) == lept_get_object_key(&r1->u.o.m[2].v, 1));
+    EXPECT_TRUE(lept_get_object_key(r1, 1) != lept_get_object_key(r2, 0));
+    EXPECT_EQ_STRING("id", lept_get_object_key(r2, 1), 2);
+
+    /* 按上次的位置查找 */
+    for (i = 0; i < 3; i++)
+        sum += lept_get_number(&lept_get_array_element(&v, i)->u.o.m[lept_find_object_index_hint(lept_get_array_element(&v, i), "id", 2, &hint)].v);
+    EXPECT_EQ_DOUBLE(6.0, sum);
+    EXPECT_EQ_SIZE_T(1, hint);
+    EXPECT_EQ_SIZE_T(LEPT_KEY_NOT_EXIST, lept_find_object_index_hint(r0, "z", 1, &hint));
+    EXPECT_EQ_SIZE_T(1, hint);
+
+    /* 共享的键只转义一次，输出不变 */
+    s = lept_stringify(&v, NULL);
+    EXPECT_TRUE(strcmp(json, s) == 0);
+    free(s);
+
+    /* 输出缓冲区扩容后复制的仍是正确的内容 */
+    p = s = (char*)malloc(n * 16 + 3);
+    *p++ = '[';
+    for (i = 0; i < n; i++)
+        p += sprintf(p, "%s{\"a\":%d,\"b\":[]}", i > 0 ? "," : "", (int)(i % 10));
+    *p++ = ']';
+    *p = '\0';
+    lept_free(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, s));
+    p = lept_stringify(&v, NULL);
+    EXPECT_TRUE(strcmp(s, p) == 0);
+    free(p);
+    free(s);
+    lept_free(&v);
 }
 
 int main() {
@@ -714,10 +2704,29 @@ int main() {
     test_parse();
     test_stringify();
     test_equal();
+    test_hash();
     test_copy();
+    test_copy_deep();
+    test_copy_object();
+    test_copy_shared();
     test_move();
     test_swap();
     test_access();
+    test_patch();
+    test_merge_patch();
+    test_diff();
+    test_cbor();
+    test_msgpack();
+    test_snapshot();
+    test_schema();
+    test_bind();
+    test_doc();
+#ifndef _WIN32
+    test_doc_threads();
+#endif
+    test_key_pool();
+    test_shape();
+    test_stats();
     printf("%d/%d (%3.2f%%) passed\n", test_pass, test_count, test_pass * 100.0 / test_count);
     return main_ret;
 }
\ No newline at end of file
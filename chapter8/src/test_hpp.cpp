@@ -0,0 +1,228 @@
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include "leptjson.hpp"
+
+static int main_ret = 0;
+static int test_count = 0;
+static int test_pass = 0;
+
+#define EXPECT_EQ_BASE(equality, expect, actual, format) \
+    do {\
+        test_count++;\
+        if (equality)\
+            test_pass++;\
+        else {\
+            fprintf(stderr, "%s:%d: expect: " format " actual: " format "\n", __FILE__, __LINE__, expect, actual);\
+            main_ret = 1;\
+        }\
+    } while(0)
+
+#define EXPECT_EQ_INT(expect, actual) EXPECT_EQ_BASE((expect) == (actual), expect, actual, "%d")
+#define EXPECT_EQ_DOUBLE(expect, actual) EXPECT_EQ_BASE((expect) == (actual), expect, actual, "%.17g")
+#define EXPECT_EQ_SIZE_T(expect, actual) EXPECT_EQ_BASE((expect) == (actual), (size_t)expect, (size_t)actual, "%zu")
+#define EXPECT_EQ_VIEW(expect, actual) \
+    EXPECT_EQ_BASE(std::string_view(expect) == (actual), std::string(expect).c_str(), std::string(actual).c_str(), "%s")
+#define EXPECT_TRUE(actual) EXPECT_EQ_BASE((actual) != 0, "true", "false", "%s")
+#define EXPECT_FALSE(actual) EXPECT_EQ_BASE((actual) == 0, "false", "true", "%s")
+
+static_assert(!std::is_copy_constructible_v<lept::value> && !std::is_copy_assignable_v<lept::value>);
+static_assert(std::is_nothrow_move_constructible_v<lept::value> && std::is_nothrow_move_assignable_v<lept::value>);
+
+static void test_value() {
+    lept::value v;
+    EXPECT_TRUE(v.is_null());
+    v = true;
+    EXPECT_TRUE(v.is_bool() && v.get_bool());
+    v = 1.5;
+    EXPECT_EQ_DOUBLE(1.5, v.get_number());
+    v = 3;
+    EXPECT_EQ_DOUBLE(3.0, v.get_number());
+    v = "abc";
+    EXPECT_EQ_VIEW("abc", v.get_string());
+    v = std::string_view("a\0b", 3);
+    EXPECT_EQ_SIZE_T(3, v.get_string().size());
+    v = std::string_view();
+    EXPECT_EQ_SIZE_T(0, v.get_string().size());
+    v = nullptr;
+    EXPECT_TRUE(v.is_null());
+}
+
+static void test_move() {
+    lept::value a, b;
+    const char* s;
+    EXPECT_EQ_INT(LEPT_PARSE_OK, a.parse("[\"hello\",{\"k\":[1]}]"));
+    s = a[0].get_string().data();
+    b = std::move(a);
+    EXPECT_TRUE(a.is_null());
+    /* 移动不复制字符串 */
+    EXPECT_TRUE(b[0].get_string().data() == s);
+    lept::value c(std::move(b));
+    EXPECT_TRUE(b.is_null());
+    EXPECT_TRUE(c[0].get_string().data() == s);
+
+    /* 深拷贝只能显式进行 */
+    lept::value d = c.copy();
+    EXPECT_TRUE(d == c);
+    EXPECT_TRUE(d[0].get_string().data() != s);
+    d[1]["k"][0] = 2;
+    EXPECT_TRUE(d != c);
+    EXPECT_TRUE(d.hash() != c.hash());
+
+    swap(c, d);
+    EXPECT_EQ_DOUBLE(2.0, c[1]["k"][0].get_number());
+    EXPECT_EQ_DOUBLE(1.0, d[1]["k"][0].get_number());
+
+    /* 写时复制：共享存储，修改时各自分离 */
+    lept::value e = d.share();
+    EXPECT_TRUE(e == d);
+    for (lept::value& x : e[1]["k"].elements())
+        x = 3;
+    EXPECT_EQ_DOUBLE(3.0, e[1]["k"][0].get_number());
+    EXPECT_EQ_DOUBLE(1.0, d[1]["k"][0].get_number());
+    EXPECT_TRUE(e[0].get_string().data() != d[0].get_string().data());
+}
+
+static void test_array() {
+    lept::value a = lept::value::array();
+    double sum = 0.0;
+    size_t i = 0;
+    for (int n = 0; n < 10; n++)
+        a.push_back(n);
+    a.push_back(lept::value::array()).push_back("x");
+    EXPECT_EQ_SIZE_T(11, a.size());
+    EXPECT_EQ_VIEW("x", a[10][0].get_string());
+    a.pop_back();
+    for (lept::value& e : a.elements()) {
+        sum += e.get_number();
+        e = e.get_number() * 2;
+    }
+    EXPECT_EQ_DOUBLE(45.0, sum);
+    const lept::value& ca = a;
+    for (const lept::value& e : ca.elements())
+        EXPECT_EQ_DOUBLE(2.0 * i++, e.get_number());
+    EXPECT_EQ_SIZE_T(10, i);
+    EXPECT_EQ_SIZE_T(10, (ca.elements().end() - ca.elements().begin()));
+    EXPECT_EQ_DOUBLE(6.0, ca.elements().begin()[3].get_number());
+
+    /* 经迭代器修改后哈希随之改变 */
+    lept::value b = a.copy();
+    EXPECT_TRUE(a.hash() == b.hash());
+    for (lept::value& e : b.elements())
+        e = 0;
+    EXPECT_TRUE(a.hash() != b.hash());
+    EXPECT_TRUE(a != b);
+}
+
+static void test_object() {
+    lept::value o;
+    std::string keys;
+    double sum = 0.0;
+    EXPECT_EQ_INT(LEPT_PARSE_OK, o.parse("{\"a\":1,\"b\":{\"c\":\"d\"},\"\":3}"));
+    EXPECT_EQ_SIZE_T(3, o.size());
+    EXPECT_EQ_DOUBLE(1.0, o["a"].get_number());
+    EXPECT_EQ_VIEW("d", o["b"]["c"].get_string());
+    EXPECT_EQ_DOUBLE(3.0, o[std::string_view()].get_number());
+    EXPECT_TRUE(o.find("z") == nullptr);
+    EXPECT_TRUE(o.find(std::string("b")) != nullptr);
+
+    /* 可写的 operator[] 加入不存在的键 */
+    o["z"] = false;
+    EXPECT_EQ_SIZE_T(4, o.size());
+    o.insert("a", lept::value("replaced"));
+    EXPECT_EQ_VIEW("replaced", o["a"].get_string());
+    EXPECT_TRUE(o.erase("b"));
+    EXPECT_FALSE(o.erase("b"));
+
+    for (auto [k, v] : o.members()) {
+        keys += k;
+        keys += ',';
+        if (v.is_number())
+            sum += v.get_number();
+    }
+    EXPECT_EQ_VIEW("a,,z,", keys);
+    EXPECT_EQ_DOUBLE(3.0, sum);
+
+    const lept::value& co = o;
+    EXPECT_EQ_VIEW("replaced", co["a"].get_string());
+    for (lept::const_member m : co.members())
+        if (m.key == "z")
+            EXPECT_FALSE(m.val.get_bool());
+
+    EXPECT_EQ_VIEW("{\"a\":\"replaced\",\"\":3,\"z\":false}", o.stringify());
+}
+
+using namespace lept::literals;
+
+/* 哈希在编译期算出，与C接口的结果相同 */
+static_assert("user_id"_k.hash() == lept::key_hash("user_id"));
+static_assert(""_k.hash() == 14695981039346656037ULL);
+static_assert("a\0b"_k.str().size() == 3);
+
+static void test_key() {
+    constexpr lept::key id = "id"_k;
+    lept::value o = lept::value::object();
+    EXPECT_TRUE(id.hash() == lept_key_hash("id", 2));
+    EXPECT_TRUE("a\0b"_k.hash() == lept_key_hash("a\0b", 3));
+
+    /* 成员少时线性查找，成员多时经键索引查找，结果应相同 */
+    for (int i = 0; i < 40; i++) {
+        char k[8];
+        o[std::string_view(k, (size_t)snprintf(k, sizeof(k), "k%d", i))] = i;
+        EXPECT_TRUE(o.find(id) == nullptr);
+    }
+    o[id] = "x";
+    EXPECT_EQ_VIEW("x", o[id].get_string());
+    EXPECT_EQ_DOUBLE(7.0, o["k7"_k].get_number());
+    EXPECT_EQ_DOUBLE(39.0, o["k39"_k].get_number());
+    const lept::value& co = o;
+    EXPECT_EQ_DOUBLE(0.0, co["k0"_k].get_number());
+    EXPECT_TRUE(co.find("k40"_k) == nullptr);
+    EXPECT_TRUE(o.erase("k0"));
+    EXPECT_TRUE(co.find("k0"_k) == nullptr);
+    EXPECT_EQ_DOUBLE(1.0, co["k1"_k].get_number());
+    EXPECT_EQ_SIZE_T(40, o.size());
+}
+
+static void test_doc() {
+    lept::value v;
+    EXPECT_EQ_INT(LEPT_PARSE_OK, v.parse("{\"a\":[1,2],\"b\":\"c\"}"));
+    lept::doc d(std::move(v));
+    EXPECT_TRUE(v.is_null());
+    lept::doc d2 = d;
+    EXPECT_TRUE(&d2.root() == &d.root());
+    d = lept::doc();
+    EXPECT_FALSE(static_cast<bool>(d));
+    EXPECT_EQ_VIEW("c", d2->find("b"_k)->get_string());
+    EXPECT_EQ_DOUBLE(2.0, (*d2)["a"][1].get_number());
+    lept::doc d3(std::move(d2));
+    EXPECT_FALSE(static_cast<bool>(d2));
+    EXPECT_EQ_SIZE_T(2, d3->size());
+}
+
+static void test_wrap() {
+    lept_value v;
+    lept_init(&v);
+    EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, "{\"x\":[true]}"));
+    lept::value& w = lept::value::wrap(v);
+    EXPECT_TRUE(w["x"][0].get_bool());
+    w["x"].push_back(nullptr);
+    EXPECT_EQ_SIZE_T(2, lept_get_array_size(lept_find_object_value(&v, "x", 1)));
+    EXPECT_TRUE(w.get() == &v);
+    lept_free(&v);
+}
+
+int main() {
+    test_value();
+    test_move();
+    test_array();
+    test_object();
+    test_key();
+    test_doc();
+    test_wrap();
+    printf("%d/%d (%3.2f%%) passed\n", test_pass, test_count, test_pass * 100.0 / test_count);
+    return main_ret;
+}